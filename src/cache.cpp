@@ -143,6 +143,76 @@ struct sort_symlinkiterlist{
     }
 };
 
+//
+// For directory listing cache out 
+//
+typedef std::vector<dirlist_cache_t::iterator>   dirlistiterlist_t;
+
+struct sort_dirlistiterlist{
+    // ascending order
+    bool operator()(const dirlist_cache_t::iterator& src1, const dirlist_cache_t::iterator& src2) const
+    {
+        return (CompareStatCacheTime(src1->second->cache_date, src2->second->cache_date) < 0);  // use the same as Stats
+    }
+};
+
+//
+// Split the path to the parent directory path(terminated by "/") and
+// the child name for the directory listing cache.
+// The path which has "_$folder$" is not target, because it is possible
+// that the name is normalized in the listing.
+//
+static bool split_dirlist_key(const std::string& key, std::string& dir, std::string& name)
+{
+    std::string strpath = key;
+    if(!strpath.empty() && '/' == *strpath.rbegin()){
+        strpath.erase(strpath.length() - 1);
+    }
+    if(strpath.empty() || std::string::npos != strpath.find("_$folder$")){
+        return false;
+    }
+    std::string::size_type pos = strpath.find_last_of('/');
+    if(std::string::npos == pos || pos + 1 == strpath.length()){
+        return false;
+    }
+    dir  = strpath.substr(0, pos + 1);
+    name = strpath.substr(pos + 1);
+    return true;
+}
+
+//
+// For access permission cache out
+//
+typedef std::vector<access_cache_t::iterator>   accessiterlist_t;
+
+struct sort_accessiterlist{
+    // ascending order
+    bool operator()(const access_cache_t::iterator& src1, const access_cache_t::iterator& src2) const
+    {
+        return (CompareStatCacheTime(src1->second->cache_date, src2->second->cache_date) < 0);  // use the same as Stats
+    }
+};
+
+//
+// Make the directory path(not terminated by "/") for the access
+// permission cache from the path of the stats.
+//
+static std::string get_access_key(const std::string& path)
+{
+    std::string strdir = path;
+    std::string::size_type pos;
+    if(std::string::npos != (pos = strdir.find("_$folder$")) && pos + strlen("_$folder$") == strdir.length()){
+        strdir.erase(pos);
+    }
+    while(1 < strdir.length() && '/' == *strdir.rbegin()){
+        strdir.erase(strdir.length() - 1);
+    }
+    if(strdir.empty() || strdir == "."){
+        strdir = "/";
+    }
+    return strdir;
+}
+
 //-------------------------------------------------------------------
 // Static
 //-------------------------------------------------------------------
@@ -152,7 +222,7 @@ pthread_mutex_t StatCache::stat_cache_lock;
 //-------------------------------------------------------------------
 // Constructor/Destructor
 //-------------------------------------------------------------------
-StatCache::StatCache() : IsExpireTime(true), IsExpireIntervalType(false), ExpireTime(15 * 60), CacheSize(100000), IsCacheNoObject(false)
+StatCache::StatCache() : IsExpireTime(true), IsExpireIntervalType(false), ExpireTime(15 * 60), CacheSize(100000), IsCacheNoObject(false), NoObjectExpireTime(-1), IsCacheDirList(false), dirlist_generation(0)
 {
     if(this == StatCache::getStatCacheData()){
         stat_cache.clear();
@@ -230,6 +300,20 @@ bool StatCache::SetCacheNoObject(bool flag)
     return old;
 }
 
+time_t StatCache::SetNoObjectExpireTime(time_t expire)
+{
+    time_t old         = NoObjectExpireTime;
+    NoObjectExpireTime = expire;
+    return old;
+}
+
+bool StatCache::SetCacheDirList(bool flag)
+{
+    bool old = IsCacheDirList;
+    IsCacheDirList = flag;
+    return old;
+}
+
 void StatCache::Clear()
 {
     AutoLock lock(&StatCache::stat_cache_lock);
@@ -238,6 +322,18 @@ void StatCache::Clear()
         delete (*iter).second;
     }
     stat_cache.clear();
+
+    for(dirlist_cache_t::iterator iter = dirlist_cache.begin(); iter != dirlist_cache.end(); ++iter){
+        delete iter->second;
+    }
+    dirlist_cache.clear();
+
+    for(access_cache_t::iterator iter = access_cache.begin(); iter != access_cache.end(); ++iter){
+        delete iter->second;
+    }
+    access_cache.clear();
+
+    noobj_cache.Clear();
     S3FS_MALLOCTRIM(0);
 }
 
@@ -261,15 +357,6 @@ bool StatCache::GetStat(const std::string& key, struct stat* pst, headers_t* met
     if(iter != stat_cache.end() && (*iter).second){
         stat_cache_entry* ent = (*iter).second;
         if(0 < ent->notruncate || !IsExpireTime || !IsExpireStatCacheTime(ent->cache_date, ExpireTime)){
-            if(ent->noobjcache){
-                if(!IsCacheNoObject){
-                    // need to delete this cache.
-                    DelStat(strpath, /*lock_already_held=*/ true);
-                }else{
-                    // noobjcache = true means no object.
-                }
-                return false;
-            }
             // hit without checking etag
             std::string stretag;
             if(petag){
@@ -325,43 +412,17 @@ bool StatCache::GetStat(const std::string& key, struct stat* pst, headers_t* met
 
 bool StatCache::IsNoObjectCache(const std::string& key, bool overcheck)
 {
-    bool is_delete_cache = false;
-    std::string strpath = key;
-
     if(!IsCacheNoObject){
         return false;
     }
+    time_t expire = (0 <= NoObjectExpireTime ? NoObjectExpireTime : (IsExpireTime ? ExpireTime : -1));
 
-    AutoLock lock(&StatCache::stat_cache_lock);
-
-    stat_cache_t::iterator iter = stat_cache.end();
-    if(overcheck && '/' != *strpath.rbegin()){
-        strpath += "/";
-        iter     = stat_cache.find(strpath);
-    }
-    if(iter == stat_cache.end()){
-        strpath = key;
-        iter    = stat_cache.find(strpath);
-    }
-
-    if(iter != stat_cache.end() && (*iter).second) {
-        stat_cache_entry* ent = (*iter).second;
-        if(0 < ent->notruncate || !IsExpireTime || !IsExpireStatCacheTime((*iter).second->cache_date, ExpireTime)){
-            if((*iter).second->noobjcache){
-                // noobjcache = true means no object.
-                SetStatCacheTime((*iter).second->cache_date);
-                return true;
-            }
-        }else{
-            // timeout
-            is_delete_cache = true;
+    if(overcheck && '/' != *key.rbegin()){
+        if(noobj_cache.Get(key + "/", expire)){
+            return true;
         }
     }
-
-    if(is_delete_cache){
-        DelStat(strpath, /*lock_already_held=*/ true);
-    }
-    return false;
+    return noobj_cache.Get(key, expire);
 }
 
 bool StatCache::AddStat(const std::string& key, headers_t& meta, bool forcedir, bool no_truncate)
@@ -397,7 +458,6 @@ bool StatCache::AddStat(const std::string& key, headers_t& meta, bool forcedir,
     }
     ent->hit_count  = 0;
     ent->isforce    = forcedir;
-    ent->noobjcache = false;
     ent->notruncate = (no_truncate ? 1L : 0L);
     ent->meta.clear();
     SetStatCacheTime(ent->cache_date);    // Set time.
@@ -434,11 +494,30 @@ bool StatCache::AddStat(const std::string& key, headers_t& meta, bool forcedir,
             DelSymlink(key.c_str(), true);
         }
     }
+
+    // check directory listing cache
+    //
+    // [NOTE]
+    // The no truncate entry is added when the file is created, so the
+    // listing in progress may not have this name.
+    //
+    if(no_truncate){
+        ++dirlist_generation;
+    }
+    AddNameToDirList(key);
+
+    // check no object cache
+    noobj_cache.Del(key);
+
+    // check access permission cache
+    DelAccess(key, /*is_subdir=*/ false, /*lock_already_held=*/ true);
+
     return true;
 }
 
 // [NOTE]
-// Updates only meta data if cached data exists.
+// Updates only meta data if cached data exists, and the stats are
+// rebuilt from the updated meta data.
 // And when these are updated, it also updates the cache time.
 //
 bool StatCache::UpdateMetaStats(const std::string& key, headers_t& meta)
@@ -472,6 +551,15 @@ bool StatCache::UpdateMetaStats(const std::string& key, headers_t& meta)
         }
     }
 
+    // Update stats by the updated meta.
+    struct stat stbuf;
+    if(convert_header_to_stat(key.c_str(), ent->meta, &stbuf, ent->isforce)){
+        ent->stbuf = stbuf;
+    }
+
+    // check access permission cache
+    DelAccess(key, /*is_subdir=*/ false, /*lock_already_held=*/ true);
+
     // Update time.
     SetStatCacheTime(ent->cache_date);
 
@@ -483,49 +571,22 @@ bool StatCache::AddNoObjectCache(const std::string& key)
     if(!IsCacheNoObject){
         return true;    // pretend successful
     }
-    if(CacheSize < 1){
-        return true;
-    }
     S3FS_PRN_INFO3("add no object cache entry[path=%s]", key.c_str());
 
-    bool found;
-    bool do_truncate;
-    {
-        AutoLock lock(&StatCache::stat_cache_lock);
-        found       = stat_cache.end() != stat_cache.find(key);
-        do_truncate = stat_cache.size() > CacheSize;
-    }
-
-    if(found){
-        DelStat(key.c_str());
-    }else{
-        if(do_truncate){
-            if(!TruncateCache()){
-                return false;
-            }
-        }
+    time_t expire = (0 <= NoObjectExpireTime ? NoObjectExpireTime : (IsExpireTime ? ExpireTime : -1));
+    if(!noobj_cache.Add(key, expire)){
+        return false;
     }
 
-    // make new
-    stat_cache_entry* ent = new stat_cache_entry();
-    memset(&(ent->stbuf), 0, sizeof(struct stat));
-    ent->hit_count  = 0;
-    ent->isforce    = false;
-    ent->noobjcache = true;
-    ent->notruncate = 0L;
-    ent->meta.clear();
-    SetStatCacheTime(ent->cache_date);    // Set time.
-
-    // add
+    // check stat cache and symbolic link cache
     AutoLock lock(&StatCache::stat_cache_lock);
 
-    std::pair<stat_cache_t::iterator, bool> pair = stat_cache.insert(std::make_pair(key, ent));
-    if(!pair.second){
-        delete pair.first->second;
-        pair.first->second = ent;
+    stat_cache_t::iterator iter;
+    if(stat_cache.end() != (iter = stat_cache.find(key)) && (!iter->second || 0L == iter->second->notruncate)){
+        // if stat cache has key, thus remove it.
+        delete iter->second;
+        stat_cache.erase(iter);
     }
-
-    // check symbolic link cache
     if(symlink_cache.end() != symlink_cache.find(key)){
         // if symbolic link cache has key, thus remove it.
         DelSymlink(key.c_str(), true);
@@ -640,11 +701,86 @@ bool StatCache::DelStat(const char* key, bool lock_already_held)
             stat_cache.erase(iter);
         }
     }
+
+    // check directory listing cache
+    //
+    // [NOTE]
+    // DelStat is called after the object is changed(created, renamed,
+    // removed, etc), then the name is added to the parent listing
+    // because the object might be created. And the listing of itself
+    // is removed if it is a directory.
+    //
+    ++dirlist_generation;
+    AddNameToDirList(std::string(key));
+
+    // check no object cache
+    //
+    // [NOTE]
+    // DelStat is also called after creating or renaming into the path,
+    // so the no object cache for it must be removed.
+    //
+    noobj_cache.Del(std::string(key));
+    if(0 < strlen(key) && 0 != strcmp(key, "/")){
+        std::string strdir = key;
+        if('/' != *strdir.rbegin()){
+            strdir += "/";
+        }
+        DelDirList(strdir, /*lock_already_held=*/ true);
+    }
+
+    // check access permission cache
+    //
+    // [NOTE]
+    // DelStat is called after the directory is renamed or removed, so
+    // the permissions of the directories under it are also removed.
+    //
+    DelAccess(std::string(key), /*is_subdir=*/ true, /*lock_already_held=*/ true);
     S3FS_MALLOCTRIM(0);
 
     return true;
 }
 
+//
+// Delete all caches of the directory and the objects under it.
+//
+// [NOTE]
+// This is called after all objects under the directory are removed at
+// once, then the stats, symbolic links, listings and access permissions
+// of the subtree are removed in one operation without lookups for each
+// object.
+//
+bool StatCache::DelStatTree(const std::string& dir)
+{
+    std::string strdir = dir;
+    if(strdir.empty() || '/' != *strdir.rbegin()){
+        strdir += "/";
+    }
+    S3FS_PRN_INFO3("delete cache entries under directory[path=%s]", strdir.c_str());
+
+    AutoLock lock(&StatCache::stat_cache_lock);
+
+    for(stat_cache_t::iterator iter = stat_cache.lower_bound(strdir); iter != stat_cache.end() && 0 == iter->first.compare(0, strdir.length(), strdir); ){
+        delete iter->second;
+        stat_cache.erase(iter++);
+    }
+    for(symlink_cache_t::iterator iter = symlink_cache.lower_bound(strdir); iter != symlink_cache.end() && 0 == iter->first.compare(0, strdir.length(), strdir); ){
+        delete iter->second;
+        symlink_cache.erase(iter++);
+    }
+    for(dirlist_cache_t::iterator iter = dirlist_cache.lower_bound(strdir); iter != dirlist_cache.end() && 0 == iter->first.compare(0, strdir.length(), strdir); ){
+        delete iter->second;
+        dirlist_cache.erase(iter++);
+    }
+
+    // the directory itself(and the access permissions under it)
+    strdir.erase(strdir.length() - 1);
+    if(!strdir.empty()){
+        DelStat(strdir.c_str(), /*lock_already_held=*/ true);
+        DelSymlink(strdir.c_str(), /*lock_already_held=*/ true);
+    }
+    return true;
+}
+
 bool StatCache::GetSymlink(const std::string& key, std::string& value)
 {
     bool is_delete_cache = false;
@@ -789,6 +925,575 @@ bool StatCache::DelSymlink(const char* key, bool lock_already_held)
     return true;
 }
 
+unsigned long StatCache::GetDirListGeneration()
+{
+    AutoLock lock(&StatCache::stat_cache_lock);
+
+    return dirlist_generation;
+}
+
+//
+// [NOTE]
+// The generation must be gotten by GetDirListGeneration() before
+// listing the directory. If the stats are changed while listing, the
+// listing is not cached because it may not have the new names.
+//
+bool StatCache::AddDirList(const std::string& dir, const std::list<std::string>& names, unsigned long generation)
+{
+    if(!IsCacheDirList || CacheSize < 1){
+        return true;
+    }
+    std::string strdir = dir;
+    if(strdir.empty() || '/' != *strdir.rbegin()){
+        strdir += "/";
+    }
+    S3FS_PRN_INFO3("add directory listing cache entry[path=%s][names=%zu]", strdir.c_str(), names.size());
+
+    bool do_truncate;
+    {
+        AutoLock lock(&StatCache::stat_cache_lock);
+        do_truncate = dirlist_cache.size() > CacheSize;
+    }
+    if(do_truncate){
+        if(!TruncateDirList()){
+            return false;
+        }
+    }
+
+    // make new
+    dirlist_cache_entry* ent = new dirlist_cache_entry();
+    for(std::list<std::string>::const_iterator iter = names.begin(); iter != names.end(); ++iter){
+        std::string name = *iter;
+        if(!name.empty() && '/' == *name.rbegin()){
+            name.erase(name.length() - 1);
+        }
+        if(!name.empty()){
+            ent->names.insert(name);
+        }
+    }
+    SetStatCacheTime(ent->cache_date);    // Set time(use the same as Stats).
+
+    // add
+    AutoLock lock(&StatCache::stat_cache_lock);
+
+    if(generation != dirlist_generation){
+        S3FS_PRN_DBG("stats were changed while listing, then not add directory listing cache[path=%s]", strdir.c_str());
+        delete ent;
+        return true;
+    }
+
+    std::pair<dirlist_cache_t::iterator, bool> pair = dirlist_cache.insert(std::make_pair(strdir, ent));
+    if(!pair.second){
+        delete pair.first->second;
+        pair.first->second = ent;
+    }
+    return true;
+}
+
+bool StatCache::IsNoObjectInDirList(const std::string& key)
+{
+    if(!IsCacheDirList){
+        return false;
+    }
+    std::string strdir;
+    std::string name;
+    if(!split_dirlist_key(key, strdir, name)){
+        return false;
+    }
+
+    AutoLock lock(&StatCache::stat_cache_lock);
+
+    dirlist_cache_t::iterator iter = dirlist_cache.find(strdir);
+    if(iter == dirlist_cache.end() || !iter->second){
+        return false;
+    }
+    if(IsExpireTime && IsExpireStatCacheTime(iter->second->cache_date, ExpireTime)){   // use the same as Stats
+        // timeout
+        DelDirList(strdir, /*lock_already_held=*/ true);
+        return false;
+    }
+    if(iter->second->names.end() != iter->second->names.find(name)){
+        return false;
+    }
+    S3FS_PRN_DBG("directory listing cache does not have the name[path=%s]", key.c_str());
+    return true;
+}
+
+//
+// [NOTE]
+// Must call this method with stat_cache_lock.
+//
+void StatCache::AddNameToDirList(const std::string& key)
+{
+    std::string strdir;
+    std::string name;
+    if(!split_dirlist_key(key, strdir, name)){
+        return;
+    }
+    dirlist_cache_t::iterator iter = dirlist_cache.find(strdir);
+    if(iter != dirlist_cache.end() && iter->second){
+        iter->second->names.insert(name);
+    }
+}
+
+bool StatCache::TruncateDirList()
+{
+    AutoLock lock(&StatCache::stat_cache_lock);
+
+    if(dirlist_cache.empty()){
+        return true;
+    }
+
+    // 1) erase over expire time
+    if(IsExpireTime){
+        for(dirlist_cache_t::iterator iter = dirlist_cache.begin(); iter != dirlist_cache.end(); ){
+            dirlist_cache_entry* entry = iter->second;
+            if(!entry || IsExpireStatCacheTime(entry->cache_date, ExpireTime)){  // use the same as Stats
+                delete entry;
+                dirlist_cache.erase(iter++);
+            }else{
+                ++iter;
+            }
+        }
+    }
+
+    // 2) check directory listing cache count
+    if(dirlist_cache.size() < CacheSize){
+        return true;
+    }
+
+    // 3) erase from the old cache in order
+    size_t            erase_count= dirlist_cache.size() - CacheSize + 1;
+    dirlistiterlist_t erase_iters;
+    for(dirlist_cache_t::iterator iter = dirlist_cache.begin(); iter != dirlist_cache.end(); ++iter){
+        erase_iters.push_back(iter);
+    }
+    sort(erase_iters.begin(), erase_iters.end(), sort_dirlistiterlist());
+    if(erase_count < erase_iters.size()){
+        erase_iters.resize(erase_count);
+    }
+    for(dirlistiterlist_t::iterator iiter = erase_iters.begin(); iiter != erase_iters.end(); ++iiter){
+        dirlist_cache_t::iterator diter = *iiter;
+
+        S3FS_PRN_DBG("truncate directory listing cache[path=%s]", diter->first.c_str());
+        delete diter->second;
+        dirlist_cache.erase(diter);
+    }
+    S3FS_MALLOCTRIM(0);
+
+    return true;
+}
+
+bool StatCache::DelDirList(const std::string& dir, bool lock_already_held)
+{
+    AutoLock lock(&StatCache::stat_cache_lock, lock_already_held ? AutoLock::ALREADY_LOCKED : AutoLock::NONE);
+
+    dirlist_cache_t::iterator iter;
+    if(dirlist_cache.end() != (iter = dirlist_cache.find(dir))){
+        S3FS_PRN_INFO3("delete directory listing cache entry[path=%s]", dir.c_str());
+        delete iter->second;
+        dirlist_cache.erase(iter);
+    }
+    return true;
+}
+
+bool StatCache::GetAccess(const std::string& dir, uid_t uid, gid_t gid, int mask)
+{
+    if(CacheSize < 1){
+        return false;
+    }
+    std::string strdir = get_access_key(dir);
+
+    AutoLock lock(&StatCache::stat_cache_lock);
+
+    access_cache_t::iterator iter = access_cache.find(strdir);
+    if(iter == access_cache.end() || !iter->second){
+        return false;
+    }
+    if(IsExpireTime && IsExpireStatCacheTime(iter->second->cache_date, ExpireTime)){   // use the same as Stats
+        // timeout
+        DelAccess(strdir, /*is_subdir=*/ false, /*lock_already_held=*/ true);
+        return false;
+    }
+    access_mask_map_t::const_iterator miter = iter->second->masks.find(std::make_pair(uid, gid));
+    if(miter == iter->second->masks.end() || mask != (miter->second & mask)){
+        return false;
+    }
+    S3FS_PRN_DBG("access permission cache hit [path=%s][uid=%u][gid=%u][mask=%d]", strdir.c_str(), (unsigned int)uid, (unsigned int)gid, mask);
+    return true;
+}
+
+//
+// [NOTE]
+// Call this method after the access is allowed by checking the stats.
+//
+bool StatCache::AddAccess(const std::string& dir, uid_t uid, gid_t gid, int mask)
+{
+    if(CacheSize < 1){
+        return true;
+    }
+    std::string strdir = get_access_key(dir);
+    S3FS_PRN_INFO3("add access permission cache entry[path=%s][uid=%u][gid=%u][mask=%d]", strdir.c_str(), (unsigned int)uid, (unsigned int)gid, mask);
+
+    bool do_truncate;
+    {
+        AutoLock lock(&StatCache::stat_cache_lock);
+        do_truncate = (access_cache.end() == access_cache.find(strdir) && access_cache.size() > CacheSize);
+    }
+    if(do_truncate){
+        if(!TruncateAccess()){
+            return false;
+        }
+    }
+
+    AutoLock lock(&StatCache::stat_cache_lock);
+
+    access_cache_t::iterator iter = access_cache.find(strdir);
+    if(iter == access_cache.end()){
+        access_cache_entry* ent = new access_cache_entry();
+        SetStatCacheTime(ent->cache_date);    // Set time(use the same as Stats).
+        iter = access_cache.insert(std::make_pair(strdir, ent)).first;
+    }
+    iter->second->masks[std::make_pair(uid, gid)] |= mask;
+
+    return true;
+}
+
+bool StatCache::TruncateAccess()
+{
+    AutoLock lock(&StatCache::stat_cache_lock);
+
+    if(access_cache.empty()){
+        return true;
+    }
+
+    // 1) erase over expire time
+    if(IsExpireTime){
+        for(access_cache_t::iterator iter = access_cache.begin(); iter != access_cache.end(); ){
+            access_cache_entry* entry = iter->second;
+            if(!entry || IsExpireStatCacheTime(entry->cache_date, ExpireTime)){  // use the same as Stats
+                delete entry;
+                access_cache.erase(iter++);
+            }else{
+                ++iter;
+            }
+        }
+    }
+
+    // 2) check access permission cache count
+    if(access_cache.size() < CacheSize){
+        return true;
+    }
+
+    // 3) erase from the old cache in order
+    size_t           erase_count= access_cache.size() - CacheSize + 1;
+    accessiterlist_t erase_iters;
+    for(access_cache_t::iterator iter = access_cache.begin(); iter != access_cache.end(); ++iter){
+        erase_iters.push_back(iter);
+    }
+    sort(erase_iters.begin(), erase_iters.end(), sort_accessiterlist());
+    if(erase_count < erase_iters.size()){
+        erase_iters.resize(erase_count);
+    }
+    for(accessiterlist_t::iterator iiter = erase_iters.begin(); iiter != erase_iters.end(); ++iiter){
+        access_cache_t::iterator aiter = *iiter;
+
+        S3FS_PRN_DBG("truncate access permission cache[path=%s]", aiter->first.c_str());
+        delete aiter->second;
+        access_cache.erase(aiter);
+    }
+    S3FS_MALLOCTRIM(0);
+
+    return true;
+}
+
+bool StatCache::DelAccess(const std::string& dir, bool is_subdir, bool lock_already_held)
+{
+    std::string strdir = get_access_key(dir);
+
+    AutoLock lock(&StatCache::stat_cache_lock, lock_already_held ? AutoLock::ALREADY_LOCKED : AutoLock::NONE);
+
+    if(access_cache.empty()){
+        return true;
+    }
+    access_cache_t::iterator iter;
+    if(access_cache.end() != (iter = access_cache.find(strdir))){
+        S3FS_PRN_INFO3("delete access permission cache entry[path=%s]", strdir.c_str());
+        delete iter->second;
+        access_cache.erase(iter);
+    }
+    if(is_subdir){
+        // the directories under it
+        std::string subdir = (strdir == "/" ? strdir : strdir + "/");
+        for(iter = access_cache.lower_bound(subdir); iter != access_cache.end() && 0 == iter->first.compare(0, subdir.length(), subdir); ){
+            S3FS_PRN_INFO3("delete access permission cache entry[path=%s]", iter->first.c_str());
+            delete iter->second;
+            access_cache.erase(iter++);
+        }
+    }
+    return true;
+}
+
+//-------------------------------------------------------------------
+// Class NoObjectCache
+//-------------------------------------------------------------------
+const size_t NoObjectCache::DEFAULT_MEMORY_SIZE;
+
+NoObjectCache::NoObjectCache() : count(0), MemorySize(NoObjectCache::DEFAULT_MEMORY_SIZE)
+{
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+#if S3FS_PTHREAD_ERRORCHECK
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_ERRORCHECK);
+#endif
+    int result;
+    if(0 != (result = pthread_mutex_init(&noobj_lock, &attr))){
+        S3FS_PRN_CRIT("failed to init noobj_lock: %d", result);
+        abort();
+    }
+}
+
+NoObjectCache::~NoObjectCache()
+{
+    Clear();
+    int result = pthread_mutex_destroy(&noobj_lock);
+    if(result != 0){
+        S3FS_PRN_CRIT("failed to destroy noobj_lock: %d", result);
+        abort();
+    }
+}
+
+//
+// FNV-1a 64bit hash
+//
+uint64_t NoObjectCache::MakeHash(const std::string& key)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for(std::string::const_iterator iter = key.begin(); iter != key.end(); ++iter){
+        hash ^= static_cast<unsigned char>(*iter);
+        hash *= 1099511628211ULL;
+    }
+    return (0 == hash ? 1 : hash);      // 0 is reserved for empty slot
+}
+
+size_t NoObjectCache::SetMemorySize(size_t size)
+{
+    AutoLock lock(&noobj_lock);
+
+    size_t old = MemorySize;
+    MemorySize = size;
+
+    // the table is made again at next adding.
+    table.clear();
+    count = 0;
+
+    return old;
+}
+
+size_t NoObjectCache::Size()
+{
+    AutoLock lock(&noobj_lock);
+    return count;
+}
+
+//
+// [NOTE]
+// Must call this method with noobj_lock.
+//
+size_t NoObjectCache::Find(uint64_t hash) const
+{
+    if(table.empty()){
+        return static_cast<size_t>(-1);
+    }
+    size_t mask = table.size() - 1;
+    for(size_t pos = static_cast<size_t>(hash) & mask; 0 != table[pos].hash; pos = (pos + 1) & mask){
+        if(hash == table[pos].hash){
+            return pos;
+        }
+    }
+    return static_cast<size_t>(-1);
+}
+
+//
+// [NOTE]
+// Must call this method with noobj_lock, and the table must have a space.
+//
+void NoObjectCache::Insert(uint64_t hash, time_t date)
+{
+    size_t mask = table.size() - 1;
+    size_t pos;
+    for(pos = static_cast<size_t>(hash) & mask; 0 != table[pos].hash; pos = (pos + 1) & mask){
+        if(hash == table[pos].hash){
+            table[pos].date = date;
+            return;
+        }
+    }
+    table[pos].hash = hash;
+    table[pos].date = date;
+    ++count;
+}
+
+//
+// Remove the entry without tombstone(backward shift deletion)
+//
+// [NOTE]
+// Must call this method with noobj_lock.
+//
+void NoObjectCache::Erase(size_t pos)
+{
+    size_t mask = table.size() - 1;
+    size_t hole = pos;
+
+    table[hole].hash = 0;
+    --count;
+    for(size_t next = (hole + 1) & mask; 0 != table[next].hash; next = (next + 1) & mask){
+        size_t home = static_cast<size_t>(table[next].hash) & mask;
+        // the entry can not be moved if its home is in (hole, next].
+        bool in_range = (hole <= next) ? (hole < home && home <= next) : (hole < home || home <= next);
+        if(!in_range){
+            table[hole]      = table[next];
+            table[next].hash = 0;
+            hole             = next;
+        }
+    }
+}
+
+//
+// Remove expired entries, and if the table is still over half, remove
+// older entries.
+//
+// [NOTE]
+// Must call this method with noobj_lock.
+//
+void NoObjectCache::Shrink(time_t expire)
+{
+    struct timespec nowts;
+    SetStatCacheTime(nowts);
+
+    std::vector<noobj_entry> entries;
+    entries.reserve(count);
+    for(noobj_table_t::const_iterator iter = table.begin(); iter != table.end(); ++iter){
+        if(0 != iter->hash && (expire < 0 || nowts.tv_sec <= iter->date + expire)){
+            entries.push_back(*iter);
+        }
+    }
+
+    size_t max_count = table.size() / 2;
+    if(max_count < entries.size()){
+        // newer first
+        std::vector<std::pair<time_t, size_t> > dates;
+        dates.reserve(entries.size());
+        for(size_t pos = 0; pos < entries.size(); ++pos){
+            dates.push_back(std::make_pair(entries[pos].date, pos));
+        }
+        std::sort(dates.begin(), dates.end());
+        std::vector<noobj_entry> newers;
+        newers.reserve(max_count);
+        for(size_t cnt = dates.size() - max_count; cnt < dates.size(); ++cnt){
+            newers.push_back(entries[dates[cnt].second]);
+        }
+        entries.swap(newers);
+    }
+    S3FS_PRN_DBG("shrink no object cache[count=%zu -> %zu]", count, entries.size());
+
+    noobj_entry empty = {0, 0};
+    std::fill(table.begin(), table.end(), empty);
+    count = 0;
+    for(std::vector<noobj_entry>::const_iterator iter = entries.begin(); iter != entries.end(); ++iter){
+        Insert(iter->hash, iter->date);
+    }
+}
+
+bool NoObjectCache::Get(const std::string& key, time_t expire)
+{
+    uint64_t hash = NoObjectCache::MakeHash(key);
+
+    AutoLock lock(&noobj_lock);
+
+    size_t pos = Find(hash);
+    if(static_cast<size_t>(-1) == pos){
+        return false;
+    }
+    if(0 <= expire){
+        struct timespec nowts;
+        SetStatCacheTime(nowts);
+        if(table[pos].date + expire < nowts.tv_sec){
+            // timeout
+            Erase(pos);
+            return false;
+        }
+    }
+    S3FS_PRN_DBG("no object cache hit [path=%s]", key.c_str());
+    return true;
+}
+
+bool NoObjectCache::Add(const std::string& key, time_t expire)
+{
+    uint64_t hash = NoObjectCache::MakeHash(key);
+
+    AutoLock lock(&noobj_lock);
+
+    if(table.empty()){
+        // make table which size is power of 2
+        size_t slots = 16;
+        while(slots * 2 * sizeof(noobj_entry) <= MemorySize){
+            slots *= 2;
+        }
+        if(MemorySize < slots * sizeof(noobj_entry)){
+            // memory size is too small, then this cache is not used.
+            return true;
+        }
+        noobj_entry empty = {0, 0};
+        table.assign(slots, empty);
+        count = 0;
+    }
+
+    // the load factor is kept under 3/4
+    if(table.size() * 3 <= (count + 1) * 4){
+        Shrink(expire);
+    }
+
+    struct timespec nowts;
+    SetStatCacheTime(nowts);
+    Insert(hash, nowts.tv_sec);
+
+    return true;
+}
+
+//
+// Remove both "path" and "path/"
+//
+void NoObjectCache::Del(const std::string& key)
+{
+    if(key.empty()){
+        return;
+    }
+    std::string other = key;
+    if('/' == *other.rbegin()){
+        other.erase(other.length() - 1);
+    }else{
+        other += "/";
+    }
+
+    AutoLock lock(&noobj_lock);
+
+    size_t pos;
+    if(static_cast<size_t>(-1) != (pos = Find(NoObjectCache::MakeHash(key)))){
+        Erase(pos);
+    }
+    if(!other.empty() && static_cast<size_t>(-1) != (pos = Find(NoObjectCache::MakeHash(other)))){
+        Erase(pos);
+    }
+}
+
+void NoObjectCache::Clear()
+{
+    AutoLock lock(&noobj_lock);
+
+    noobj_table_t().swap(table);
+    count = 0;
+}
+
 //-------------------------------------------------------------------
 // Functions
 //-------------------------------------------------------------------
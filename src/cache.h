@@ -21,6 +21,10 @@
 #ifndef S3FS_CACHE_H_
 #define S3FS_CACHE_H_
 
+#include <stdint.h>
+#include <set>
+#include <vector>
+
 #include "metaheader.h"
 
 //-------------------------------------------------------------------
@@ -35,10 +39,9 @@ struct stat_cache_entry {
     struct timespec   cache_date;
     headers_t         meta;
     bool              isforce;
-    bool              noobjcache;  // Flag: cache is no object for no listing.
     unsigned long     notruncate;  // 0<:   not remove automatically at checking truncate
 
-    stat_cache_entry() : hit_count(0), isforce(false), noobjcache(false), notruncate(0L)
+    stat_cache_entry() : hit_count(0), isforce(false), notruncate(0L)
     {
         memset(&stbuf, 0, sizeof(struct stat));
         cache_date.tv_sec  = 0;
@@ -66,6 +69,98 @@ struct symlink_cache_entry {
 
 typedef std::map<std::string, symlink_cache_entry*> symlink_cache_t;
 
+//
+// Struct for directory listing cache
+//
+// This has all child names in the directory which are listed completely.
+// The name which is not in this list does not exist in the directory.
+//
+struct dirlist_cache_entry {
+    std::set<std::string> names;       // child names(without "/")
+    struct timespec       cache_date;  // The function that operates timespec uses the same as Stats
+
+    dirlist_cache_entry()
+    {
+      cache_date.tv_sec  = 0;
+      cache_date.tv_nsec = 0;
+    }
+};
+
+typedef std::map<std::string, dirlist_cache_entry*> dirlist_cache_t; // key=directory path(terminated by "/")
+
+//
+// Struct for access permission cache
+//
+// This has the access masks which are allowed to uid and gid for the
+// directory.
+//
+typedef std::map<std::pair<uid_t, gid_t>, int> access_mask_map_t;
+
+struct access_cache_entry {
+    access_mask_map_t masks;       // allowed mask for uid and gid
+    struct timespec   cache_date;  // The function that operates timespec uses the same as Stats
+
+    access_cache_entry()
+    {
+      cache_date.tv_sec  = 0;
+      cache_date.tv_nsec = 0;
+    }
+};
+
+typedef std::map<std::string, access_cache_entry*> access_cache_t; // key=directory path(not terminated by "/")
+
+//-------------------------------------------------------------------
+// Class NoObjectCache
+//-------------------------------------------------------------------
+// [NOTE] About No object cache
+// This cache is separated from the Stats cache, so that many lookups
+// for the objects which do not exist(ex. searching include paths or
+// import paths) do not push the entries of Stats cache out.
+// The entry has only the 64bit hash value of the path and the cached
+// time, and the table is the open addressing hash table which size is
+// limited by the memory size. When the table is full, the expired and
+// the older entries are removed.
+// The possibility that the existing path is determined as no object
+// by the hash collision is negligible.
+//
+class NoObjectCache
+{
+    private:
+        struct noobj_entry {
+            uint64_t hash;              // 0 means empty slot
+            time_t   date;              // cached time(seconds of monotonic clock)
+        };
+        typedef std::vector<noobj_entry> noobj_table_t;
+
+        pthread_mutex_t        noobj_lock;
+        noobj_table_t          table;
+        size_t                 count;
+        size_t                 MemorySize;
+
+    private:
+        static uint64_t MakeHash(const std::string& key);
+
+        size_t Find(uint64_t hash) const;
+        void Insert(uint64_t hash, time_t date);
+        void Erase(size_t pos);
+        void Shrink(time_t expire);
+
+    public:
+        static const size_t DEFAULT_MEMORY_SIZE = 1024 * 1024;  // 1MB(about 48,000 entries)
+
+        NoObjectCache();
+        ~NoObjectCache();
+
+        size_t GetMemorySize() const { return MemorySize; }
+        size_t SetMemorySize(size_t size);
+        size_t Size();
+
+        bool Get(const std::string& key, time_t expire);
+        bool Add(const std::string& key, time_t expire);
+        void Del(const std::string& key);
+        void Clear();
+};
+
 //-------------------------------------------------------------------
 // Class StatCache
 //-------------------------------------------------------------------
@@ -78,6 +173,28 @@ typedef std::map<std::string, symlink_cache_entry*> symlink_cache_t;
 // cache. This simplifies user configuration, and from a user perspective,
 // the symbolic link cache appears to be included in the Stats cache.
 //
+// [NOTE] About Directory listing cache
+// When readdir lists the directory completely, the child names are
+// kept in the directory listing cache. Then the lookup for the child
+// which is not in the list returns ENOENT without any request.
+// Adding or deleting the stats of a child always adds its name to the
+// list, because it means that the child might be created. Then the
+// name is not determined as no object and it is checked by requests.
+// The listing is not cached if any stats is changed while listing,
+// this is checked by the generation count.
+// The expire time uses the same setting as Stats cache.
+//
+// [NOTE] About Access permission cache
+// The result of checking the access permission of the parent
+// directories is kept for each uid and gid, then the checks for many
+// objects in the same directory(ex. moving all files in a directory)
+// do not walk all ancestors every time.
+// When the stats of the directory are added, updated or deleted, the
+// permission for it is removed. Deleting the stats also removes the
+// permission of the directories under it, because it is called when
+// the directory is renamed or removed.
+// The expire time uses the same setting as Stats cache.
+//
 class StatCache
 {
     private:
@@ -89,7 +206,13 @@ class StatCache
         time_t                 ExpireTime;
         unsigned long          CacheSize;
         bool                   IsCacheNoObject;
+        time_t                 NoObjectExpireTime;      // -1 means same as ExpireTime
+        NoObjectCache          noobj_cache;
         symlink_cache_t        symlink_cache;
+        bool                   IsCacheDirList;
+        dirlist_cache_t        dirlist_cache;
+        unsigned long          dirlist_generation;     // count up when stats is changed
+        access_cache_t         access_cache;
 
     private:
         StatCache();
@@ -101,6 +224,12 @@ class StatCache
         bool TruncateCache();
         // Truncate symbolic link cache
         bool TruncateSymlink();
+        // Truncate directory listing cache
+        bool TruncateDirList();
+        // Add child name into directory listing cache
+        void AddNameToDirList(const std::string& key);
+        // Truncate access permission cache
+        bool TruncateAccess();
 
     public:
         // Reference singleton
@@ -128,6 +257,20 @@ class StatCache
         {
             return IsCacheNoObject;
         }
+        size_t SetNoObjectCacheMemorySize(size_t size)
+        {
+            return noobj_cache.SetMemorySize(size);
+        }
+        time_t SetNoObjectExpireTime(time_t expire);
+        bool SetCacheDirList(bool flag);
+        bool EnableCacheDirList()
+        {
+            return SetCacheDirList(true);
+        }
+        bool GetCacheDirList() const
+        {
+            return IsCacheDirList;
+        }
 
         // Get stat cache
         bool GetStat(const std::string& key, struct stat* pst, headers_t* meta, bool overcheck = true, bool* pisforce = NULL)
@@ -170,11 +313,23 @@ class StatCache
         {
             return DelStat(key.c_str(), lock_already_held);
         }
+        bool DelStatTree(const std::string& dir);
 
         // Cache for symbolic link
         bool GetSymlink(const std::string& key, std::string& value);
         bool AddSymlink(const std::string& key, const std::string& value);
         bool DelSymlink(const char* key, bool lock_already_held = false);
+
+        // Cache for directory listing
+        unsigned long GetDirListGeneration();
+        bool AddDirList(const std::string& dir, const std::list<std::string>& names, unsigned long generation);
+        bool IsNoObjectInDirList(const std::string& key);
+        bool DelDirList(const std::string& dir, bool lock_already_held = false);
+
+        // Cache for access permission of directory
+        bool GetAccess(const std::string& dir, uid_t uid, gid_t gid, int mask);
+        bool AddAccess(const std::string& dir, uid_t uid, gid_t gid, int mask);
+        bool DelAccess(const std::string& dir, bool is_subdir, bool lock_already_held = false);
 };
 
 //-------------------------------------------------------------------
@@ -53,6 +53,27 @@ std::string s3fs_get_content_md5(int fd)
     return Signature;
 }
 
+std::string s3fs_get_content_md5(const unsigned char* data, size_t datalen)
+{
+    unsigned char* md5;
+    char* base64;
+    std::string Signature;
+
+    if(NULL == (md5 = s3fs_md5(data, datalen))){
+        return std::string("");
+    }
+    if(NULL == (base64 = s3fs_base64(md5, get_md5_digest_length()))){
+        delete[] md5;
+        return std::string("");  // ENOMEM
+    }
+    delete[] md5;
+
+    Signature = base64;
+    delete[] base64;
+
+    return Signature;
+}
+
 std::string s3fs_sha256_hex_fd(int fd, off_t start, off_t size)
 {
     size_t digestlen = get_sha256_digest_length();
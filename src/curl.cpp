@@ -25,6 +25,7 @@
 #include <fstream>
 #include <sstream>
 #include <algorithm>
+#include <set>
 
 #include "common.h"
 #include "s3fs.h"
@@ -36,6 +37,7 @@
 #include "s3fs_util.h"
 #include "string_util.h"
 #include "addhead.h"
+#include "s3fs_xml.h"
 
 //-------------------------------------------------------------------
 // Symbols
@@ -81,6 +83,7 @@ static const char SPECIAL_DARWIN_MIME_FILE[]        = "/etc/apache2/mime.types";
 const long       S3fsCurl::S3FSCURL_RESPONSECODE_NOTSET;
 const long       S3fsCurl::S3FSCURL_RESPONSECODE_FATAL_ERROR;
 const int        S3fsCurl::S3FSCURL_PERFORM_RESULT_NOTSET;
+const size_t     S3fsCurl::MAX_DELETE_OBJECTS_COUNT;
 pthread_mutex_t  S3fsCurl::curl_warnings_lock;
 pthread_mutex_t  S3fsCurl::curl_handles_lock;
 S3fsCurl::callback_locks_t S3fsCurl::callback_locks;
@@ -136,6 +139,7 @@ int              S3fsCurl::max_parallel_cnt    = 5;              // default
 int              S3fsCurl::max_multireq        = 20;             // default
 off_t            S3fsCurl::multipart_size      = MULTIPART_SIZE; // default
 off_t            S3fsCurl::multipart_copy_size = 512 * 1024 * 1024;  // default
+int              S3fsCurl::multipart_copy_parts= 0;              // default(same as max_parallel_cnt)
 signature_type_t S3fsCurl::signature_type      = V2_OR_V4;       // default
 bool             S3fsCurl::is_ua               = true;           // default
 bool             S3fsCurl::listobjectsv2       = false;          // default
@@ -1123,6 +1127,46 @@ bool S3fsCurl::SetMultipartCopySize(off_t size)
     return true;
 }
 
+int S3fsCurl::SetMultipartCopyParts(int count)
+{
+    int old = S3fsCurl::multipart_copy_parts;
+    S3fsCurl::multipart_copy_parts = count;
+    return old;
+}
+
+//
+// Plan the part size for copying the object by multipart copy requests.
+//
+// The part size is chosen to make the object into multipart_copy_parts
+// parts, then all parts of an object are copied at the same time by
+// parallel requests. It is rounded up to MB, and it is between 5MB and
+// multipart_copy_size. And it is large enough to make the parts count
+// 10000 or less, but it is not over 5GB.
+//
+off_t S3fsCurl::GetMultipartCopyPartSize(off_t size)
+{
+    static const off_t unit_size     = 1024 * 1024;
+    static const off_t max_part_size = 5LL * 1024 * 1024 * 1024;
+    static const off_t max_part_cnt  = 10 * 1000;
+
+    off_t part_cnt  = static_cast<off_t>(S3fsCurl::GetMultipartCopyParts());
+    off_t part_size = (size + part_cnt - 1) / part_cnt;
+    if(part_size < MIN_MULTIPART_SIZE){
+        part_size = MIN_MULTIPART_SIZE;
+    }
+    if(S3fsCurl::multipart_copy_size < part_size){
+        part_size = S3fsCurl::multipart_copy_size;
+    }
+    if(part_size < (size + max_part_cnt - 1) / max_part_cnt){
+        part_size = (size + max_part_cnt - 1) / max_part_cnt;
+    }
+    part_size = ((part_size + unit_size - 1) / unit_size) * unit_size;
+    if(max_part_size < part_size){
+        part_size = max_part_size;
+    }
+    return part_size;
+}
+
 int S3fsCurl::SetMaxParallelCount(int value)
 {
     int old = S3fsCurl::max_parallel_cnt;
@@ -1137,7 +1181,7 @@ int S3fsCurl::SetMaxMultiRequest(int max)
     return old;
 }
 
-bool S3fsCurl::UploadMultipartPostCallback(S3fsCurl* s3fscurl)
+bool S3fsCurl::UploadMultipartPostCallback(S3fsCurl* s3fscurl, void* param)
 {
     if(!s3fscurl){
         return false;
@@ -1146,7 +1190,7 @@ bool S3fsCurl::UploadMultipartPostCallback(S3fsCurl* s3fscurl)
     return s3fscurl->UploadMultipartPostComplete();
 }
 
-bool S3fsCurl::MixMultipartPostCallback(S3fsCurl* s3fscurl)
+bool S3fsCurl::MixMultipartPostCallback(S3fsCurl* s3fscurl, void* param)
 {
     if(!s3fscurl){
         return false;
@@ -1521,7 +1565,7 @@ S3fsCurl* S3fsCurl::ParallelGetObjectRetryCallback(S3fsCurl* s3fscurl)
     // duplicate request(setup new curl object)
     S3fsCurl* newcurl = new S3fsCurl(s3fscurl->IsUseAhbe());
     
-    if(0 != (result = newcurl->PreGetObjectRequest(s3fscurl->path.c_str(), s3fscurl->partdata.fd, s3fscurl->partdata.startpos, s3fscurl->partdata.size, s3fscurl->b_ssetype, s3fscurl->b_ssevalue))){
+    if(0 != (result = newcurl->PreGetObjectRequest(s3fscurl->path.c_str(), s3fscurl->partdata.fd, s3fscurl->partdata.startpos, s3fscurl->partdata.size, s3fscurl->b_ssetype, s3fscurl->b_ssevalue, s3fscurl->b_etag.c_str()))){
         S3FS_PRN_ERR("failed downloading part setup(%d)", result);
         delete newcurl;
         return NULL;;
@@ -1531,7 +1575,28 @@ S3fsCurl* S3fsCurl::ParallelGetObjectRetryCallback(S3fsCurl* s3fscurl)
     return newcurl;
 }
 
-int S3fsCurl::ParallelGetObjectRequest(const char* tpath, int fd, off_t start, off_t size)
+//
+// [NOTE]
+// The end position(startpos + size) of the part does not change while
+// writing and retrying, and the size is 0 when all data of the part has
+// been written. So the part is identified by the fd and the end position.
+//
+bool S3fsCurl::ParallelGetObjectsCallback(S3fsCurl* s3fscurl, void* param)
+{
+    if(!s3fscurl || !param){
+        return false;
+    }
+    if(0 != s3fscurl->partdata.size){
+        S3FS_PRN_WARN("the part of %s was not downloaded completely(remaining %lld bytes).", s3fscurl->path.c_str(), static_cast<long long int>(s3fscurl->partdata.size));
+        return false;
+    }
+    std::set<std::pair<int, off_t> >* pdone = static_cast<std::set<std::pair<int, off_t> >*>(param);
+    pdone->insert(std::make_pair(s3fscurl->partdata.fd, s3fscurl->partdata.startpos));
+
+    return true;
+}
+
+int S3fsCurl::ParallelGetObjectRequest(const char* tpath, int fd, off_t start, off_t size, const char* etag)
 {
     S3FS_PRN_INFO3("[tpath=%s][fd=%d]", SAFESTRPTR(tpath), fd);
 
@@ -1560,7 +1625,7 @@ int S3fsCurl::ParallelGetObjectRequest(const char* tpath, int fd, off_t start, o
 
             // s3fscurl sub object
             S3fsCurl* s3fscurl_para = new S3fsCurl();
-            if(0 != (result = s3fscurl_para->PreGetObjectRequest(tpath, fd, (start + size - remaining_bytes), chunk, ssetype, ssevalue))){
+            if(0 != (result = s3fscurl_para->PreGetObjectRequest(tpath, fd, (start + size - remaining_bytes), chunk, ssetype, ssevalue, etag))){
                 S3FS_PRN_ERR("failed downloading part setup(%d)", result);
                 delete s3fscurl_para;
                 return result;
@@ -1586,6 +1651,295 @@ int S3fsCurl::ParallelGetObjectRequest(const char* tpath, int fd, off_t start, o
     return result;
 }
 
+//
+// Copy objects by multipart copy requests in parallel.
+//
+// [NOTE]
+// The parts of all objects are requested by one multi request, so the
+// parallel count is the budget for all objects in the list. The part
+// size of each object is planned by GetMultipartCopyPartSize.
+// The result of each object is set in the list, and this returns an
+// error if any object could not be copied.
+//
+int S3fsCurl::ParallelMultipartCopyRequest(multipart_copy_list_t& copylist)
+{
+    S3FS_PRN_INFO3("[count=%zu]", copylist.size());
+
+    struct timespec start_time;
+    clock_gettime(CLOCK_MONOTONIC, &start_time);
+
+    // Initialize S3fsMultiCurl
+    S3fsMultiCurl curlmulti(GetMaxParallelCount());
+    curlmulti.SetSuccessCallback(S3fsCurl::CopyMultipartPostCallback);
+    curlmulti.SetRetryCallback(S3fsCurl::CopyMultipartPostRetryCallback);
+
+    int result = 0;
+    for(multipart_copy_list_t::iterator iter = copylist.begin(); iter != copylist.end(); ++iter){
+        std::string srcresource;
+        std::string srcurl;
+        MakeUrlResource(get_realpath(iter->from.c_str()).c_str(), srcresource, srcurl);
+        iter->meta["x-amz-copy-source"] = srcresource;
+        iter->upload_id.erase();
+        iter->etaglist.clear();
+
+        S3fsCurl s3fscurl(true);
+        if(0 != (iter->result = s3fscurl.PreMultipartPostRequest(iter->to.c_str(), iter->meta, iter->upload_id, true))){
+            S3FS_PRN_ERR("failed to start multipart copy(%s) by %d", iter->to.c_str(), iter->result);
+            result = iter->result;
+            continue;
+        }
+        s3fscurl.DestroyCurlHandle();
+
+        off_t     part_size = S3fsCurl::GetMultipartCopyPartSize(iter->size);
+        headers_t meta      = iter->meta;
+        off_t     bytes_remaining;
+        off_t     chunk;
+        for(bytes_remaining = iter->size, chunk = 0; 0 < bytes_remaining; bytes_remaining -= chunk){
+            chunk = bytes_remaining > part_size ? part_size : bytes_remaining;
+
+            std::ostringstream strrange;
+            strrange << "bytes=" << (iter->size - bytes_remaining) << "-" << (iter->size - bytes_remaining + chunk - 1);
+            meta["x-amz-copy-source-range"] = strrange.str();
+
+            // s3fscurl sub object
+            S3fsCurl* s3fscurl_para = new S3fsCurl(true);
+            s3fscurl_para->b_from   = iter->from;
+            s3fscurl_para->b_meta   = meta;
+            s3fscurl_para->partdata.add_etag_list(&iter->etaglist);
+
+            // initiate upload part for parallel
+            if(0 != (iter->result = s3fscurl_para->CopyMultipartPostSetup(iter->from.c_str(), iter->to.c_str(), static_cast<int>(iter->etaglist.size()), iter->upload_id, meta))){
+                S3FS_PRN_ERR("failed uploading part setup(%d)", iter->result);
+                delete s3fscurl_para;
+                break;
+            }
+
+            // set into parallel object
+            if(!curlmulti.SetS3fsCurlObject(s3fscurl_para)){
+                S3FS_PRN_ERR("Could not make curl object into multi curl(%s).", iter->to.c_str());
+                delete s3fscurl_para;
+                iter->result = -EIO;
+                break;
+            }
+        }
+        if(0 != iter->result){
+            result = iter->result;
+        }
+    }
+
+    // Multi request
+    int multi_result;
+    if(0 != (multi_result = curlmulti.Request())){
+        S3FS_PRN_ERR("error occurred in multi request(errno=%d).", multi_result);
+        result = multi_result;
+    }
+
+    // complete or abort each object
+    size_t done_count = 0;
+    off_t  done_bytes = 0;
+    for(multipart_copy_list_t::iterator iter = copylist.begin(); iter != copylist.end(); ++iter){
+        if(iter->upload_id.empty()){
+            continue;
+        }
+        if(0 == iter->result && 0 != multi_result){
+            iter->result = multi_result;
+        }
+        if(0 == iter->result){
+            S3fsCurl s3fscurl(true);
+            if(0 != (iter->result = s3fscurl.CompleteMultipartPostRequest(iter->to.c_str(), iter->upload_id, iter->etaglist))){
+                S3FS_PRN_ERR("failed to complete multipart copy(%s) by %d", iter->to.c_str(), iter->result);
+                result = iter->result;
+            }
+        }
+        if(0 != iter->result){
+            S3fsCurl s3fscurl_abort(true);
+            int result2 = s3fscurl_abort.AbortMultipartUpload(iter->to.c_str(), iter->upload_id);
+            s3fscurl_abort.DestroyCurlHandle();
+            if(result2 != 0){
+                S3FS_PRN_ERR("error aborting multipart upload(errno=%d).", result2);
+            }
+        }else{
+            ++done_count;
+            done_bytes += iter->size;
+        }
+        iter->meta.erase("x-amz-copy-source");
+    }
+
+    // report throughput
+    struct timespec end_time;
+    clock_gettime(CLOCK_MONOTONIC, &end_time);
+    double elapsed = static_cast<double>(end_time.tv_sec - start_time.tv_sec) + static_cast<double>(end_time.tv_nsec - start_time.tv_nsec) / 1000000000.0;
+    S3FS_PRN_INFO("copied %zu/%zu objects(%lld bytes) by multipart copy in %.3f sec(%.2f MB/s).", done_count, copylist.size(), static_cast<long long int>(done_bytes), elapsed, (0.0 < elapsed ? static_cast<double>(done_bytes) / (1024.0 * 1024.0) / elapsed : 0.0));
+
+    return result;
+}
+
+//
+// Download the ranges of objects by get requests in parallel.
+//
+// [NOTE]
+// The parts of all ranges are requested by one multi request, so the
+// parallel count is the budget for all ranges in the list, and each range
+// is split by the multipart size. The result of each range is set in the
+// list, and this returns an error if any range could not be downloaded.
+//
+int S3fsCurl::ParallelGetObjectsRequest(get_object_list_t& getlist)
+{
+    S3FS_PRN_INFO3("[count=%zu]", getlist.size());
+
+    struct timespec start_time;
+    clock_gettime(CLOCK_MONOTONIC, &start_time);
+
+    // Initialize S3fsMultiCurl
+    std::set<std::pair<int, off_t> > done;
+    S3fsMultiCurl curlmulti(GetMaxParallelCount());
+    curlmulti.SetSuccessCallback(S3fsCurl::ParallelGetObjectsCallback);
+    curlmulti.SetSuccessCallbackParam(static_cast<void*>(&done));
+    curlmulti.SetRetryCallback(S3fsCurl::ParallelGetObjectRetryCallback);
+
+    int result = 0;
+    for(get_object_list_t::iterator iter = getlist.begin(); iter != getlist.end(); ++iter){
+        iter->result = 0;
+
+        sse_type_t  ssetype = sse_type_t::SSE_DISABLE;
+        std::string ssevalue;
+        if(!get_object_sse_type(iter->path.c_str(), ssetype, ssevalue)){
+            S3FS_PRN_WARN("Failed to get SSE type for file(%s).", iter->path.c_str());
+        }
+
+        off_t bytes_remaining;
+        off_t chunk;
+        for(bytes_remaining = iter->size, chunk = 0; 0 < bytes_remaining; bytes_remaining -= chunk){
+            chunk = bytes_remaining > S3fsCurl::multipart_size ? S3fsCurl::multipart_size : bytes_remaining;
+
+            // s3fscurl sub object
+            S3fsCurl* s3fscurl_para = new S3fsCurl();
+            if(0 != (iter->result = s3fscurl_para->PreGetObjectRequest(iter->path.c_str(), iter->fd, (iter->start + iter->size - bytes_remaining), chunk, ssetype, ssevalue, (iter->etag.empty() ? NULL : iter->etag.c_str())))){
+                S3FS_PRN_ERR("failed downloading part setup(%d)", iter->result);
+                delete s3fscurl_para;
+                break;
+            }
+
+            // set into parallel object
+            if(!curlmulti.SetS3fsCurlObject(s3fscurl_para)){
+                S3FS_PRN_ERR("Could not make curl object into multi curl(%s).", iter->path.c_str());
+                delete s3fscurl_para;
+                iter->result = -EIO;
+                break;
+            }
+        }
+        if(0 != iter->result){
+            result = iter->result;
+        }
+    }
+
+    // Multi request
+    int multi_result;
+    if(0 != (multi_result = curlmulti.Request())){
+        S3FS_PRN_ERR("error occurred in multi request(errno=%d).", multi_result);
+        result = multi_result;
+    }
+
+    // check that all parts of each range were downloaded
+    size_t done_count = 0;
+    off_t  done_bytes = 0;
+    for(get_object_list_t::iterator iter = getlist.begin(); iter != getlist.end(); ++iter){
+        if(0 != iter->result){
+            continue;
+        }
+        off_t bytes_remaining;
+        off_t chunk;
+        for(bytes_remaining = iter->size, chunk = 0; 0 < bytes_remaining; bytes_remaining -= chunk){
+            chunk = bytes_remaining > S3fsCurl::multipart_size ? S3fsCurl::multipart_size : bytes_remaining;
+            if(done.end() == done.find(std::make_pair(iter->fd, iter->start + iter->size - bytes_remaining + chunk))){
+                iter->result = (0 != multi_result ? multi_result : -EIO);
+                result       = iter->result;
+                break;
+            }
+        }
+        if(0 == iter->result){
+            ++done_count;
+            done_bytes += iter->size;
+        }
+    }
+
+    // report throughput
+    struct timespec end_time;
+    clock_gettime(CLOCK_MONOTONIC, &end_time);
+    double elapsed = static_cast<double>(end_time.tv_sec - start_time.tv_sec) + static_cast<double>(end_time.tv_nsec - start_time.tv_nsec) / 1000000000.0;
+    S3FS_PRN_INFO("downloaded %zu/%zu ranges(%lld bytes) by get requests in %.3f sec(%.2f MB/s).", done_count, getlist.size(), static_cast<long long int>(done_bytes), elapsed, (0.0 < elapsed ? static_cast<double>(done_bytes) / (1024.0 * 1024.0) / elapsed : 0.0));
+
+    return result;
+}
+
+bool S3fsCurl::DeleteObjectsCallback(S3fsCurl* s3fscurl, void* param)
+{
+    if(!s3fscurl || !param){
+        return false;
+    }
+    std::map<std::string, int>* perrors = static_cast<std::map<std::string, int>*>(param);
+    std::map<std::string, int>  errors;
+    if(0 != s3fscurl->GetDeleteObjectsResult(errors)){
+        // all objects in this request remain as errors
+        return false;
+    }
+    for(std::map<std::string, std::string>::const_iterator iter = s3fscurl->delete_keymap.begin(); iter != s3fscurl->delete_keymap.end(); ++iter){
+        perrors->erase(iter->second);
+    }
+    for(std::map<std::string, int>::const_iterator iter = errors.begin(); iter != errors.end(); ++iter){
+        (*perrors)[iter->first] = iter->second;
+    }
+    return true;
+}
+
+//
+// Delete objects by parallel DeleteObjects requests
+//
+// The paths are divided into bundles of MAX_DELETE_OBJECTS_COUNT, and
+// all bundles are requested at the same time. The paths which could not
+// be deleted are set to errors, and this returns an error if there is
+// any path which could not be deleted.
+//
+int S3fsCurl::ParallelDeleteObjectsRequest(const std::list<std::string>& paths, std::map<std::string, int>& errors)
+{
+    S3FS_PRN_INFO3("[count=%zu]", paths.size());
+
+    errors.clear();
+
+    S3fsMultiCurl curlmulti(GetMaxMultiRequest());
+    curlmulti.SetSuccessCallback(S3fsCurl::DeleteObjectsCallback);
+    curlmulti.SetSuccessCallbackParam(&errors);
+
+    for(std::list<std::string>::const_iterator iter = paths.begin(); iter != paths.end(); ){
+        std::list<std::string> bundle;
+        for(; iter != paths.end() && bundle.size() < S3fsCurl::MAX_DELETE_OBJECTS_COUNT; ++iter){
+            bundle.push_back(*iter);
+            errors[*iter] = -EIO;       // cleared by callback if it is deleted
+        }
+        S3fsCurl* s3fscurl = new S3fsCurl();
+        if(!s3fscurl->PreDeleteObjectsRequest(bundle)){
+            S3FS_PRN_ERR("Could not make curl object for DeleteObjects request.");
+            delete s3fscurl;
+            continue;
+        }
+        if(!curlmulti.SetS3fsCurlObject(s3fscurl)){
+            S3FS_PRN_ERR("Could not make curl object into multi curl.");
+            delete s3fscurl;
+            continue;
+        }
+    }
+
+    int result;
+    if(0 != (result = curlmulti.Request())){
+        S3FS_PRN_ERR("error occurred in multi DeleteObjects request(errno=%d).", result);
+        return result;
+    }
+    if(!errors.empty()){
+        result = errors.begin()->second;
+    }
+    return result;
+}
+
 bool S3fsCurl::UploadMultipartPostSetCurlOpts(S3fsCurl* s3fscurl)
 {
     if(!s3fscurl){
@@ -1667,6 +2021,65 @@ bool S3fsCurl::PreHeadRequestSetCurlOpts(S3fsCurl* s3fscurl)
     return true;
 }
 
+bool S3fsCurl::PutHeadRequestSetCurlOpts(S3fsCurl* s3fscurl)
+{
+    if(!s3fscurl){
+        return false;
+    }
+    if(!s3fscurl->CreateCurlHandle()){
+        return false;
+    }
+
+    curl_easy_setopt(s3fscurl->hCurl, CURLOPT_URL, s3fscurl->url.c_str());
+    curl_easy_setopt(s3fscurl->hCurl, CURLOPT_UPLOAD, true);                // HTTP PUT
+    curl_easy_setopt(s3fscurl->hCurl, CURLOPT_WRITEDATA, (void*)&(s3fscurl->bodydata));
+    curl_easy_setopt(s3fscurl->hCurl, CURLOPT_WRITEFUNCTION, WriteMemoryCallback);
+    curl_easy_setopt(s3fscurl->hCurl, CURLOPT_INFILESIZE, 0);               // Content-Length
+    S3fsCurl::AddUserAgent(s3fscurl->hCurl);                                // put User-Agent
+
+    return true;
+}
+
+bool S3fsCurl::DeleteRequestSetCurlOpts(S3fsCurl* s3fscurl)
+{
+    if(!s3fscurl){
+        return false;
+    }
+    if(!s3fscurl->CreateCurlHandle()){
+        return false;
+    }
+
+    curl_easy_setopt(s3fscurl->hCurl, CURLOPT_URL, s3fscurl->url.c_str());
+    curl_easy_setopt(s3fscurl->hCurl, CURLOPT_CUSTOMREQUEST, "DELETE");
+    S3fsCurl::AddUserAgent(s3fscurl->hCurl);                   // put User-Agent
+
+    return true;
+}
+
+bool S3fsCurl::DeleteObjectsRequestSetCurlOpts(S3fsCurl* s3fscurl)
+{
+    if(!s3fscurl){
+        return false;
+    }
+    if(!s3fscurl->CreateCurlHandle()){
+        return false;
+    }
+
+    curl_easy_setopt(s3fscurl->hCurl, CURLOPT_URL, s3fscurl->url.c_str());
+    curl_easy_setopt(s3fscurl->hCurl, CURLOPT_POST, true);              // POST
+    curl_easy_setopt(s3fscurl->hCurl, CURLOPT_WRITEDATA, (void*)&(s3fscurl->bodydata));
+    curl_easy_setopt(s3fscurl->hCurl, CURLOPT_WRITEFUNCTION, WriteMemoryCallback);
+    curl_easy_setopt(s3fscurl->hCurl, CURLOPT_POSTFIELDSIZE, static_cast<curl_off_t>(s3fscurl->postdata_remaining));
+    curl_easy_setopt(s3fscurl->hCurl, CURLOPT_READDATA, (void*)s3fscurl);
+    curl_easy_setopt(s3fscurl->hCurl, CURLOPT_READFUNCTION, S3fsCurl::ReadCallback);
+    if(S3fsCurl::is_verbose){
+        curl_easy_setopt(s3fscurl->hCurl, CURLOPT_DEBUGFUNCTION, S3fsCurl::CurlDebugBodyOutFunc);     // replace debug function
+    }
+    S3fsCurl::AddUserAgent(s3fscurl->hCurl);                            // put User-Agent
+
+    return true;
+}
+
 bool S3fsCurl::ParseIAMCredentialResponse(const char* response, iamcredmap_t& keyval)
 {
     if(!response){
@@ -2203,6 +2616,7 @@ bool S3fsCurl::RemakeHandle()
             break;
 
         case REQTYPE_COMPLETEMULTIPOST:
+        case REQTYPE_DELETEOBJECTS:
             curl_easy_setopt(hCurl, CURLOPT_URL, url.c_str());
             curl_easy_setopt(hCurl, CURLOPT_POST, true);
             curl_easy_setopt(hCurl, CURLOPT_WRITEDATA, (void*)&bodydata);
@@ -2370,6 +2784,11 @@ int S3fsCurl::RequestPerform(bool dontAddAuthHeaders /*=false*/)
                         result = -ENOENT;
                         break;
 
+                    case 412:
+                        S3FS_PRN_WARN("HTTP response code 412(Precondition Failed: the object was changed), returning ESTALE.");
+                        result = -ESTALE;
+                        break;
+
                     case 416:
                         S3FS_PRN_INFO3("HTTP response code 416 was returned, returning EIO");
                         result = -EIO;
@@ -2645,7 +3064,7 @@ std::string S3fsCurl::CalcSignature(const std::string& method, const std::string
 
 void S3fsCurl::insertV4Headers()
 {
-    std::string server_path = type == REQTYPE_LISTBUCKET ? "/" : path;
+    std::string server_path = (type == REQTYPE_LISTBUCKET || type == REQTYPE_DELETEOBJECTS) ? "/" : path;
     std::string payload_hash;
     switch (type) {
         case REQTYPE_PUT:
@@ -2653,6 +3072,7 @@ void S3fsCurl::insertV4Headers()
             break;
 
         case REQTYPE_COMPLETEMULTIPOST:
+        case REQTYPE_DELETEOBJECTS:
             {
                 size_t          cRequest_len = strlen(reinterpret_cast<const char *>(b_postdata));
                 unsigned char*  sRequest     = NULL;
@@ -2693,7 +3113,7 @@ void S3fsCurl::insertV4Headers()
     }
 
     if(!S3fsCurl::IsPublicBucket()){
-        std::string Signature = CalcSignature(op, realpath, query_string + (type == REQTYPE_PREMULTIPOST || type == REQTYPE_MULTILIST ? "=" : ""), strdate, contentSHA256, date8601);
+        std::string Signature = CalcSignature(op, realpath, query_string + (type == REQTYPE_PREMULTIPOST || type == REQTYPE_MULTILIST || type == REQTYPE_DELETEOBJECTS ? "=" : ""), strdate, contentSHA256, date8601);
         std::string auth = "AWS4-HMAC-SHA256 Credential=" + AWSAccessKeyId + "/" + strdate + "/" + endpoint + "/s3/aws4_request, SignedHeaders=" + get_sorted_header_keys(requestHeaders) + ", Signature=" + Signature;
         requestHeaders = curl_slist_sort_insert(requestHeaders, "Authorization", auth.c_str());
     }
@@ -2703,7 +3123,7 @@ void S3fsCurl::insertV2Headers()
 {
     std::string resource;
     std::string turl;
-    std::string server_path = type == REQTYPE_LISTBUCKET ? "/" : path;
+    std::string server_path = (type == REQTYPE_LISTBUCKET || type == REQTYPE_DELETEOBJECTS) ? "/" : path;
     MakeUrlResource(server_path.c_str(), resource, turl);
     if(!query_string.empty() && type != REQTYPE_CHKBUCKET && type != REQTYPE_LISTBUCKET){
         resource += "?" + query_string;
@@ -2747,15 +3167,12 @@ void S3fsCurl::insertAuthHeaders()
     }
 }
 
-int S3fsCurl::DeleteRequest(const char* tpath)
+bool S3fsCurl::PreDeleteRequest(const char* tpath)
 {
     S3FS_PRN_INFO3("[tpath=%s]", SAFESTRPTR(tpath));
 
     if(!tpath){
-        return -EINVAL;
-    }
-    if(!CreateCurlHandle()){
-        return -EIO;
+        return false;
     }
     std::string resource;
     std::string turl;
@@ -2769,13 +3186,126 @@ int S3fsCurl::DeleteRequest(const char* tpath)
     op = "DELETE";
     type = REQTYPE_DELETE;
 
-    curl_easy_setopt(hCurl, CURLOPT_URL, url.c_str());
-    curl_easy_setopt(hCurl, CURLOPT_CUSTOMREQUEST, "DELETE");
-    S3fsCurl::AddUserAgent(hCurl);        // put User-Agent
+    // set lazy function
+    fpLazySetup = DeleteRequestSetCurlOpts;
+
+    return true;
+}
 
+int S3fsCurl::DeleteRequest(const char* tpath)
+{
+    if(!tpath){
+        return -EINVAL;
+    }
+    if(!PreDeleteRequest(tpath)){
+        return -EIO;
+    }
+    if(!fpLazySetup || !fpLazySetup(this)){
+        S3FS_PRN_ERR("Failed to lazy setup in delete request.");
+        return -EIO;
+    }
     return RequestPerform();
 }
 
+//
+// Delete multiple objects by one DeleteObjects request
+//
+// [NOTE]
+// The count of paths must be MAX_DELETE_OBJECTS_COUNT or less.
+// This request uses quiet mode, so the response has only the keys which
+// could not be deleted, and they are got by GetDeleteObjectsResult().
+//
+bool S3fsCurl::PreDeleteObjectsRequest(const std::list<std::string>& paths)
+{
+    S3FS_PRN_INFO3("[count=%zu]", paths.size());
+
+    if(paths.empty() || S3fsCurl::MAX_DELETE_OBJECTS_COUNT < paths.size()){
+        S3FS_PRN_ERR("Wrong count of objects(%zu) for one request.", paths.size());
+        return false;
+    }
+
+    // make contents
+    delete_keymap.clear();
+    postcontent  = "<Delete>\n";
+    postcontent += "  <Quiet>true</Quiet>\n";
+    for(std::list<std::string>::const_iterator iter = paths.begin(); iter != paths.end(); ++iter){
+        std::string key = get_realpath(iter->c_str());
+        if(!key.empty() && '/' == key[0]){
+            key.erase(0, 1);
+        }
+        delete_keymap[key]  = *iter;
+        postcontent        += "  <Object><Key>" + xmlEncode(key) + "</Key></Object>\n";
+    }
+    postcontent += "</Delete>\n";
+
+    // DeleteObjects requires Content-MD5
+    std::string strMD5 = s3fs_get_content_md5(reinterpret_cast<const unsigned char*>(postcontent.c_str()), postcontent.size());
+    if(strMD5.empty()){
+        S3FS_PRN_ERR("Failed to make MD5 for DeleteObjects request.");
+        return false;
+    }
+
+    // set postdata
+    postdata             = reinterpret_cast<const unsigned char*>(postcontent.c_str());
+    b_postdata           = postdata;
+    postdata_remaining   = postcontent.size(); // without null
+    b_postdata_remaining = postdata_remaining;
+
+    std::string resource;
+    std::string turl;
+    MakeUrlResource("", resource, turl);    // NOTICE: path is "".
+
+    query_string         = "delete";
+    turl                += "?" + query_string;
+    url                  = prepare_url(turl.c_str());
+    path                 = get_realpath("/");
+    requestHeaders       = NULL;
+    bodydata.Clear();
+    responseHeaders.clear();
+
+    requestHeaders = curl_slist_sort_insert(requestHeaders, "Accept", NULL);
+    requestHeaders = curl_slist_sort_insert(requestHeaders, "Content-Type", "application/xml");
+    requestHeaders = curl_slist_sort_insert(requestHeaders, "Content-MD5", strMD5.c_str());
+
+    op = "POST";
+    type = REQTYPE_DELETEOBJECTS;
+
+    // set lazy function
+    fpLazySetup = DeleteObjectsRequestSetCurlOpts;
+
+    return true;
+}
+
+//
+// Get the result of DeleteObjects request from the response body.
+// The objects which could not be deleted are set to errors with their
+// error code, and this returns an error if the body is wrong.
+//
+int S3fsCurl::GetDeleteObjectsResult(std::map<std::string, int>& errors)
+{
+    std::map<std::string, std::string> keyerrors;
+    if(!get_delete_objects_errors_from_xml(bodydata.str(), bodydata.size(), keyerrors)){
+        S3FS_PRN_ERR("DeleteObjects request get 200 status response, but it included error body.");
+        S3FS_PRN_DBG("DeleteObjects request Response Body : %s", (bodydata.str() ? bodydata.str() : "(null)"));
+        return -EIO;
+    }
+    for(std::map<std::string, std::string>::const_iterator iter = keyerrors.begin(); iter != keyerrors.end(); ++iter){
+        std::map<std::string, std::string>::const_iterator kiter = delete_keymap.find(iter->first);
+        std::string errpath = (delete_keymap.end() != kiter ? kiter->second : ("/" + iter->first));
+        int         errcode;
+        if(iter->second == "AccessDenied"){
+            errcode = -EPERM;
+        }else if(iter->second == "NoSuchKey"){
+            errcode = -ENOENT;
+        }else{
+            errcode = -EIO;
+        }
+        S3FS_PRN_WARN("Could not delete object(%s) by DeleteObjects request(%s).", errpath.c_str(), iter->second.c_str());
+        errors[errpath] = errcode;
+    }
+    return 0;
+}
+
 //
 // Get the token that we need to pass along with AWS IMDSv2 API requests
 //
@@ -3086,15 +3616,12 @@ int S3fsCurl::HeadRequest(const char* tpath, headers_t& meta)
     return 0;
 }
 
-int S3fsCurl::PutHeadRequest(const char* tpath, headers_t& meta, bool is_copy)
+bool S3fsCurl::PrePutHeadRequest(const char* tpath, headers_t& meta, bool is_copy)
 {
     S3FS_PRN_INFO3("[tpath=%s]", SAFESTRPTR(tpath));
 
     if(!tpath){
-        return -EINVAL;
-    }
-    if(!CreateCurlHandle()){
-        return -EIO;
+        return false;
     }
     std::string resource;
     std::string turl;
@@ -3106,6 +3633,11 @@ int S3fsCurl::PutHeadRequest(const char* tpath, headers_t& meta, bool is_copy)
     responseHeaders.clear();
     bodydata.Clear();
 
+    // zero byte object(not copy) has empty body
+    if(!is_copy && S3fsCurl::is_content_md5){
+        requestHeaders = curl_slist_sort_insert(requestHeaders, "Content-MD5", empty_md5_base64_hash.c_str());
+    }
+
     std::string contype = S3fsCurl::LookupMimeType(std::string(tpath));
     requestHeaders = curl_slist_sort_insert(requestHeaders, "Content-Type", contype.c_str());
 
@@ -3161,13 +3693,24 @@ int S3fsCurl::PutHeadRequest(const char* tpath, headers_t& meta, bool is_copy)
     op = "PUT";
     type = REQTYPE_PUTHEAD;
 
-    // setopt
-    curl_easy_setopt(hCurl, CURLOPT_URL, url.c_str());
-    curl_easy_setopt(hCurl, CURLOPT_UPLOAD, true);                // HTTP PUT
-    curl_easy_setopt(hCurl, CURLOPT_WRITEDATA, (void*)&bodydata);
-    curl_easy_setopt(hCurl, CURLOPT_WRITEFUNCTION, WriteMemoryCallback);
-    curl_easy_setopt(hCurl, CURLOPT_INFILESIZE, 0);               // Content-Length
-    S3fsCurl::AddUserAgent(hCurl);                                // put User-Agent
+    // set lazy function
+    fpLazySetup = PutHeadRequestSetCurlOpts;
+
+    return true;
+}
+
+int S3fsCurl::PutHeadRequest(const char* tpath, headers_t& meta, bool is_copy)
+{
+    if(!tpath){
+        return -EINVAL;
+    }
+    if(!PrePutHeadRequest(tpath, meta, is_copy)){
+        return -EIO;
+    }
+    if(!fpLazySetup || !fpLazySetup(this)){
+        S3FS_PRN_ERR("Failed to lazy setup in put head request.");
+        return -EIO;
+    }
 
     S3FS_PRN_INFO3("copying... [path=%s]", tpath);
 
@@ -3300,7 +3843,11 @@ int S3fsCurl::PutRequest(const char* tpath, headers_t& meta, int fd)
     return result;
 }
 
-int S3fsCurl::PreGetObjectRequest(const char* tpath, int fd, off_t start, off_t size, sse_type_t ssetype, const std::string& ssevalue)
+//
+// If etag is specified, the request has If-Match header, so that the range
+// of the object which was changed after caching is not mixed in the cache.
+//
+int S3fsCurl::PreGetObjectRequest(const char* tpath, int fd, off_t start, off_t size, sse_type_t ssetype, const std::string& ssevalue, const char* etag)
 {
     S3FS_PRN_INFO3("[tpath=%s][start=%lld][size=%lld]", SAFESTRPTR(tpath), static_cast<long long>(start), static_cast<long long>(size));
 
@@ -3324,6 +3871,9 @@ int S3fsCurl::PreGetObjectRequest(const char* tpath, int fd, off_t start, off_t
         range       += str(start + size - 1);
         requestHeaders = curl_slist_sort_insert(requestHeaders, "Range", range.c_str());
     }
+    if(etag && '\0' != etag[0]){
+        requestHeaders = curl_slist_sort_insert(requestHeaders, "If-Match", etag);
+    }
     // SSE
     if(!AddSseRequestHead(ssetype, ssevalue, true, false)){
         S3FS_PRN_WARN("Failed to set SSE header, but continue...");
@@ -3346,11 +3896,12 @@ int S3fsCurl::PreGetObjectRequest(const char* tpath, int fd, off_t start, off_t
     b_ssetype           = ssetype;
     b_ssevalue          = ssevalue;
     b_ssekey_pos        = -1;         // not use this value for get object.
+    b_etag              = SAFESTRPTR(etag);
 
     return 0;
 }
 
-int S3fsCurl::GetObjectRequest(const char* tpath, int fd, off_t start, off_t size)
+int S3fsCurl::GetObjectRequest(const char* tpath, int fd, off_t start, off_t size, const char* etag)
 {
     int result;
 
@@ -3365,7 +3916,7 @@ int S3fsCurl::GetObjectRequest(const char* tpath, int fd, off_t start, off_t siz
         S3FS_PRN_WARN("Failed to get SSE type for file(%s).", SAFESTRPTR(tpath));
     }
 
-    if(0 != (result = PreGetObjectRequest(tpath, fd, start, size, ssetype, ssevalue))){
+    if(0 != (result = PreGetObjectRequest(tpath, fd, start, size, ssetype, ssevalue, etag))){
         return result;
     }
     if(!fpLazySetup || !fpLazySetup(this)){
@@ -3891,7 +4442,7 @@ bool S3fsCurl::UploadMultipartPostComplete()
     return true;
 }
 
-bool S3fsCurl::CopyMultipartPostCallback(S3fsCurl* s3fscurl)
+bool S3fsCurl::CopyMultipartPostCallback(S3fsCurl* s3fscurl, void* param)
 {
     if(!s3fscurl){
         return false;
@@ -3947,8 +4498,9 @@ int S3fsCurl::MultipartHeadRequest(const char* tpath, off_t size, headers_t& met
     curlmulti.SetSuccessCallback(S3fsCurl::CopyMultipartPostCallback);
     curlmulti.SetRetryCallback(S3fsCurl::CopyMultipartPostRetryCallback);
 
+    off_t part_size = GetMultipartCopyPartSize(size);
     for(bytes_remaining = size, chunk = 0; 0 < bytes_remaining; bytes_remaining -= chunk){
-        chunk = bytes_remaining > GetMultipartCopySize() ? GetMultipartCopySize() : bytes_remaining;
+        chunk = bytes_remaining > part_size ? part_size : bytes_remaining;
 
         std::ostringstream strrange;
         strrange << "bytes=" << (size - bytes_remaining) << "-" << (size - bytes_remaining + chunk - 1);
@@ -4031,76 +4583,21 @@ int S3fsCurl::MultipartUploadRequest(const std::string& upload_id, const char* t
 
 int S3fsCurl::MultipartRenameRequest(const char* from, const char* to, headers_t& meta, off_t size)
 {
-    int            result;
-    std::string    upload_id;
-    off_t          chunk;
-    off_t          bytes_remaining;
-    etaglist_t     list;
-
     S3FS_PRN_INFO3("[from=%s][to=%s]", SAFESTRPTR(from), SAFESTRPTR(to));
 
-    std::string srcresource;
-    std::string srcurl;
-    MakeUrlResource(get_realpath(from).c_str(), srcresource, srcurl);
-
-    meta["Content-Type"]      = S3fsCurl::LookupMimeType(std::string(to));
-    meta["x-amz-copy-source"] = srcresource;
-
-    if(0 != (result = PreMultipartPostRequest(to, meta, upload_id, true))){
-        return result;
-    }
-    DestroyCurlHandle();
-
-    // Initialize S3fsMultiCurl
-    S3fsMultiCurl curlmulti(GetMaxParallelCount());
-    curlmulti.SetSuccessCallback(S3fsCurl::CopyMultipartPostCallback);
-    curlmulti.SetRetryCallback(S3fsCurl::CopyMultipartPostRetryCallback);
-
-    for(bytes_remaining = size, chunk = 0; 0 < bytes_remaining; bytes_remaining -= chunk){
-        chunk = bytes_remaining > GetMultipartCopySize() ? GetMultipartCopySize() : bytes_remaining;
-
-        std::ostringstream strrange;
-        strrange << "bytes=" << (size - bytes_remaining) << "-" << (size - bytes_remaining + chunk - 1);
-        meta["x-amz-copy-source-range"] = strrange.str();
-
-        // s3fscurl sub object
-        S3fsCurl* s3fscurl_para = new S3fsCurl(true);
-        s3fscurl_para->b_from   = SAFESTRPTR(from);
-        s3fscurl_para->b_meta   = meta;
-        s3fscurl_para->partdata.add_etag_list(&list);
-
-        // initiate upload part for parallel
-        if(0 != (result = s3fscurl_para->CopyMultipartPostSetup(from, to, static_cast<int>(list.size()), upload_id, meta))){
-            S3FS_PRN_ERR("failed uploading part setup(%d)", result);
-            delete s3fscurl_para;
-            return result;
-        }
-
-        // set into parallel object
-        if(!curlmulti.SetS3fsCurlObject(s3fscurl_para)){
-            S3FS_PRN_ERR("Could not make curl object into multi curl(%s).", to);
-            delete s3fscurl_para;
-            return -EIO;
-        }
+    if(!from || !to){
+        return -EINVAL;
     }
+    meta["Content-Type"] = S3fsCurl::LookupMimeType(std::string(to));
 
-    // Multi request
-    if(0 != (result = curlmulti.Request())){
-        S3FS_PRN_ERR("error occurred in multi request(errno=%d).", result);
+    multipart_copy_list_t copylist;
+    copylist.push_back(multipart_copy_info(from, to, meta, size));
 
-        S3fsCurl s3fscurl_abort(true);
-        int result2 = s3fscurl_abort.AbortMultipartUpload(to, upload_id);
-        s3fscurl_abort.DestroyCurlHandle();
-        if(result2 != 0){
-            S3FS_PRN_ERR("error aborting multipart upload(errno=%d).", result2);
-        }
-        return result;
+    int result = S3fsCurl::ParallelMultipartCopyRequest(copylist);
+    if(0 == result){
+        result = copylist.front().result;
     }
-
-    if(0 != (result = CompleteMultipartPostRequest(to, upload_id, list))){
-        return result;
-    }
-    return 0;
+    return result;
 }
 
 /*
@@ -69,6 +69,41 @@ typedef std::pair<double, double>   progress_t;
 typedef std::map<CURL*, time_t>     curltime_t;
 typedef std::map<CURL*, progress_t> curlprogress_t;
 
+//
+// Structure for copying an object by multipart copy requests
+//
+struct multipart_copy_info
+{
+    std::string from;           // source object path
+    std::string to;             // destination object path
+    headers_t   meta;           // headers for the destination object
+    off_t       size;           // object size
+    int         result;         // result of copying
+    std::string upload_id;      // for internal use
+    etaglist_t  etaglist;       // for internal use
+
+    multipart_copy_info(const std::string& from_path, const std::string& to_path, const headers_t& to_meta, off_t obj_size) : from(from_path), to(to_path), meta(to_meta), size(obj_size), result(-EIO) {}
+};
+
+typedef std::list<multipart_copy_info> multipart_copy_list_t;
+
+//
+// Structure for downloading a range of an object into a file
+//
+struct get_object_info
+{
+    std::string path;           // object path
+    int         fd;             // file descriptor for writing
+    off_t       start;          // start position in the object(and the file)
+    off_t       size;           // size of the range
+    std::string etag;           // ETag for If-Match header(empty means not checking)
+    int         result;         // result of downloading
+
+    get_object_info(const std::string& obj_path, int obj_fd, off_t obj_start, off_t obj_size, const std::string& obj_etag) : path(obj_path), fd(obj_fd), start(obj_start), size(obj_size), etag(obj_etag), result(-EIO) {}
+};
+
+typedef std::list<get_object_info> get_object_list_t;
+
 //----------------------------------------------
 // class S3fsCurl
 //----------------------------------------------
@@ -104,7 +139,8 @@ class S3fsCurl
             REQTYPE_MULTILIST,
             REQTYPE_IAMCRED,
             REQTYPE_ABORTMULTIUPLOAD,
-            REQTYPE_IAMROLE
+            REQTYPE_IAMROLE,
+            REQTYPE_DELETEOBJECTS
         };
 
         // class variables
@@ -162,6 +198,7 @@ class S3fsCurl
         static int              max_multireq;
         static off_t            multipart_size;
         static off_t            multipart_copy_size;
+        static int              multipart_copy_parts;
         static signature_type_t signature_type;
         static bool             is_ua;             // User-Agent
         static bool             listobjectsv2;
@@ -191,9 +228,12 @@ class S3fsCurl
         off_t                b_partdata_size;      // backup for retrying
         size_t               b_ssekey_pos;         // backup for retrying
         std::string          b_ssevalue;           // backup for retrying
+        std::string          b_etag;               // backup for retrying(If-Match for get object request)
         sse_type_t           b_ssetype;            // backup for retrying
         std::string          b_from;               // backup for retrying(for copy request)
         headers_t            b_meta;               // backup for retrying(for copy request)
+        std::string          postcontent;          // post body data(for DeleteObjects request)
+        std::map<std::string, std::string> delete_keymap;  // object key -> path(for DeleteObjects request)
         std::string          op;                   // the HTTP verb of the request ("PUT", "GET", etc.)
         std::string          query_string;         // request query string
         Semaphore            *sem;
@@ -206,6 +246,7 @@ class S3fsCurl
         static const long S3FSCURL_RESPONSECODE_NOTSET      = -1;
         static const long S3FSCURL_RESPONSECODE_FATAL_ERROR = -2;
         static const int  S3FSCURL_PERFORM_RESULT_NOTSET    = 1;
+        static const size_t MAX_DELETE_OBJECTS_COUNT        = 1000;
 
     public:
         // constructor/destructor
@@ -231,19 +272,24 @@ class S3fsCurl
         static size_t UploadReadCallback(void *ptr, size_t size, size_t nmemb, void *userp);
         static size_t DownloadWriteCallback(void* ptr, size_t size, size_t nmemb, void* userp);
 
-        static bool UploadMultipartPostCallback(S3fsCurl* s3fscurl);
-        static bool CopyMultipartPostCallback(S3fsCurl* s3fscurl);
-        static bool MixMultipartPostCallback(S3fsCurl* s3fscurl);
+        static bool UploadMultipartPostCallback(S3fsCurl* s3fscurl, void* param);
+        static bool CopyMultipartPostCallback(S3fsCurl* s3fscurl, void* param);
+        static bool MixMultipartPostCallback(S3fsCurl* s3fscurl, void* param);
+        static bool DeleteObjectsCallback(S3fsCurl* s3fscurl, void* param);
         static S3fsCurl* UploadMultipartPostRetryCallback(S3fsCurl* s3fscurl);
         static S3fsCurl* CopyMultipartPostRetryCallback(S3fsCurl* s3fscurl);
         static S3fsCurl* MixMultipartPostRetryCallback(S3fsCurl* s3fscurl);
         static S3fsCurl* ParallelGetObjectRetryCallback(S3fsCurl* s3fscurl);
+        static bool ParallelGetObjectsCallback(S3fsCurl* s3fscurl, void* param);
 
         // lazy functions for set curl options
         static bool UploadMultipartPostSetCurlOpts(S3fsCurl* s3fscurl);
         static bool CopyMultipartPostSetCurlOpts(S3fsCurl* s3fscurl);
         static bool PreGetObjectRequestSetCurlOpts(S3fsCurl* s3fscurl);
         static bool PreHeadRequestSetCurlOpts(S3fsCurl* s3fscurl);
+        static bool PutHeadRequestSetCurlOpts(S3fsCurl* s3fscurl);
+        static bool DeleteRequestSetCurlOpts(S3fsCurl* s3fscurl);
+        static bool DeleteObjectsRequestSetCurlOpts(S3fsCurl* s3fscurl);
 
         static bool ParseIAMCredentialResponse(const char* response, iamcredmap_t& keyval);
         static bool SetIAMCredentials(const char* response);
@@ -278,7 +324,6 @@ class S3fsCurl
         bool UploadMultipartPostComplete();
         bool CopyMultipartPostComplete();
         bool MixMultipartPostComplete();
-        int MapPutErrorResponse(int result);
 
     public:
         // class methods
@@ -287,7 +332,10 @@ class S3fsCurl
         static bool DestroyS3fsCurl();
         static int ParallelMultipartUploadRequest(const char* tpath, headers_t& meta, int fd);
         static int ParallelMixMultipartUploadRequest(const char* tpath, headers_t& meta, int fd, const fdpage_list_t& mixuppages);
-        static int ParallelGetObjectRequest(const char* tpath, int fd, off_t start, off_t size);
+        static int ParallelGetObjectRequest(const char* tpath, int fd, off_t start, off_t size, const char* etag = NULL);
+        static int ParallelMultipartCopyRequest(multipart_copy_list_t& copylist);
+        static int ParallelGetObjectsRequest(get_object_list_t& getlist);
+        static int ParallelDeleteObjectsRequest(const std::list<std::string>& paths, std::map<std::string, int>& errors);
         static bool CheckIAMCredentialUpdate();
 
         // class methods(variables)
@@ -356,6 +404,9 @@ class S3fsCurl
         static off_t GetMultipartSize() { return S3fsCurl::multipart_size; }
         static bool SetMultipartCopySize(off_t size);
         static off_t GetMultipartCopySize() { return S3fsCurl::multipart_copy_size; }
+        static int SetMultipartCopyParts(int count);
+        static int GetMultipartCopyParts() { return (0 < S3fsCurl::multipart_copy_parts ? S3fsCurl::multipart_copy_parts : S3fsCurl::max_parallel_cnt); }
+        static off_t GetMultipartCopyPartSize(off_t size);
         static signature_type_t SetSignatureType(signature_type_t signature_type) { signature_type_t bresult = S3fsCurl::signature_type; S3fsCurl::signature_type = signature_type; return bresult; }
         static signature_type_t GetSignatureType() { return S3fsCurl::signature_type; }
         static bool SetUserAgentFlag(bool isset) { bool bresult = S3fsCurl::is_ua; S3fsCurl::is_ua = isset; return bresult; }
@@ -375,16 +426,21 @@ class S3fsCurl
         bool AddSseRequestHead(sse_type_t ssetype, const std::string& ssevalue, bool is_only_c, bool is_copy);
         bool GetResponseCode(long& responseCode, bool from_curl_handle = true);
         int RequestPerform(bool dontAddAuthHeaders=false);
+        int MapPutErrorResponse(int result);
+        bool PreDeleteRequest(const char* tpath);
         int DeleteRequest(const char* tpath);
+        bool PreDeleteObjectsRequest(const std::list<std::string>& paths);
+        int GetDeleteObjectsResult(std::map<std::string, int>& errors);
         bool PreHeadRequest(const char* tpath, const char* bpath = NULL, const char* savedpath = NULL, size_t ssekey_pos = -1);
         bool PreHeadRequest(const std::string& tpath, const std::string& bpath, const std::string& savedpath, size_t ssekey_pos = -1) {
           return PreHeadRequest(tpath.c_str(), bpath.c_str(), savedpath.c_str(), ssekey_pos);
         }
         int HeadRequest(const char* tpath, headers_t& meta);
+        bool PrePutHeadRequest(const char* tpath, headers_t& meta, bool is_copy);
         int PutHeadRequest(const char* tpath, headers_t& meta, bool is_copy);
         int PutRequest(const char* tpath, headers_t& meta, int fd);
-        int PreGetObjectRequest(const char* tpath, int fd, off_t start, off_t size, sse_type_t ssetype, const std::string& ssevalue);
-        int GetObjectRequest(const char* tpath, int fd, off_t start = -1, off_t size = -1);
+        int PreGetObjectRequest(const char* tpath, int fd, off_t start, off_t size, sse_type_t ssetype, const std::string& ssevalue, const char* etag = NULL);
+        int GetObjectRequest(const char* tpath, int fd, off_t start = -1, off_t size = -1, const char* etag = NULL);
         int CheckBucket();
         int ListBucketRequest(const char* tpath, const char* query);
         int PreMultipartPostRequest(const char* tpath, headers_t& meta, std::string& upload_id, bool is_copy);
@@ -31,7 +31,7 @@
 //-------------------------------------------------------------------
 // Class S3fsMultiCurl 
 //-------------------------------------------------------------------
-S3fsMultiCurl::S3fsMultiCurl(int maxParallelism) : maxParallelism(maxParallelism), SuccessCallback(NULL), RetryCallback(NULL)
+S3fsMultiCurl::S3fsMultiCurl(int maxParallelism) : maxParallelism(maxParallelism), SuccessCallback(NULL), RetryCallback(NULL), pSuccessCallbackParam(NULL)
 {
     int result;
     pthread_mutexattr_t attr;
@@ -94,6 +94,13 @@ S3fsMultiRetryCallback S3fsMultiCurl::SetRetryCallback(S3fsMultiRetryCallback fu
     return old;
 }
   
+void* S3fsMultiCurl::SetSuccessCallbackParam(void* param)
+{
+    void* old = pSuccessCallbackParam;
+    pSuccessCallbackParam = param;
+    return old;
+}
+
 bool S3fsMultiCurl::SetS3fsCurlObject(S3fsCurl* s3fscurl)
 {
     if(!s3fscurl){
@@ -197,7 +204,7 @@ int S3fsMultiCurl::MultiRead()
                 isPostpone = true;
             }else if(400 > responseCode){
                 // add into stat cache
-                if(SuccessCallback && !SuccessCallback(s3fscurl)){
+                if(SuccessCallback && !SuccessCallback(s3fscurl, pSuccessCallbackParam)){
                     S3FS_PRN_WARN("error from callback function(%s).", s3fscurl->url.c_str());
                 }
             }else if(400 == responseCode){
@@ -210,6 +217,10 @@ int S3fsMultiCurl::MultiRead()
                 if(s3fscurl->GetOp() != "HEAD"){
                     S3FS_PRN_WARN("failed a request(%ld: %s)", responseCode, s3fscurl->url.c_str());
                 }
+            }else if(412 == responseCode){
+                // precondition failed(the object was changed), do not retry.
+                S3FS_PRN_WARN("failed a request(%ld: %s)", responseCode, s3fscurl->url.c_str());
+                result = -ESTALE;
             }else if(500 == responseCode){
                 // case of all other result, do retry.(11/13/2013)
                 // because it was found that s3fs got 500 error from S3, but could success
@@ -22,13 +22,22 @@
 #include <cstdlib>
 #include <cerrno>
 #include <unistd.h>
+#include <fcntl.h>
 #include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/file.h>
 #include <dirent.h>
+#ifdef __linux__
+#include <sys/ioctl.h>
+#endif
+#include <algorithm>
+#include <set>
 
 #include "common.h"
 #include "s3fs.h"
 #include "fdcache.h"
 #include "fdcache_pseudofd.h"
+#include "fdcache_stat.h"
 #include "s3fs_util.h"
 #include "s3fs_logger.h"
 #include "string_util.h"
@@ -71,6 +80,11 @@
 //
 #define NOCACHE_PATH_PREFIX_FORM    " __S3FS_UNEXISTED_PATH_%lx__ / "      // important space words for simply
 
+//
+// Interval(seconds) of merging the changes of the shared cache directory into the index.
+//
+#define SHARED_CACHE_RESCAN_INTERVAL    60
+
 //------------------------------------------------
 // FdManager class variable
 //------------------------------------------------
@@ -78,14 +92,26 @@ FdManager       FdManager::singleton;
 pthread_mutex_t FdManager::fd_manager_lock;
 pthread_mutex_t FdManager::cache_cleanup_lock;
 pthread_mutex_t FdManager::reserved_diskspace_lock;
+pthread_mutex_t FdManager::cache_evictor_lock;
+pthread_cond_t  FdManager::cache_evictor_cond;
+pthread_t       FdManager::cache_evictor_thread;
+bool            FdManager::is_cache_evictor_run(false);
 bool            FdManager::is_lock_init(false);
 std::string     FdManager::cache_dir;
 bool            FdManager::check_cache_dir_exist(false);
 off_t           FdManager::free_disk_space = 0;
+off_t           FdManager::max_cache_size = 0;
+int             FdManager::cache_high_watermark = 90;
+int             FdManager::cache_low_watermark = 80;
+off_t           FdManager::cache_block_size = 0;
+bool            FdManager::shared_cache(false);
+time_t          FdManager::shared_index_time = 0;
 std::string     FdManager::check_cache_output;
 bool            FdManager::checked_lseek(false);
 bool            FdManager::have_lseek_hole(false);
 std::string     FdManager::tmp_dir = "/tmp";
+CacheFileIndex  FdManager::cache_index;
+MemoryBlockCache FdManager::memory_cache;
 
 //------------------------------------------------
 // FdManager class methods
@@ -123,6 +149,7 @@ bool FdManager::DeleteCacheDirectory()
     if(!delete_files_in_dir(cache_path.c_str(), true)){
         return false;
     }
+    FdManager::cache_index.Clear();
 
     std::string mirror_path = FdManager::cache_dir + "/." + bucket + ".mirror";
     if(!delete_files_in_dir(mirror_path.c_str(), true)){
@@ -146,6 +173,8 @@ int FdManager::DeleteCacheFile(const char* path)
     if(!FdManager::MakeCachePath(path, cache_path, false)){
         return 0;
     }
+    FdManager::cache_index.Remove(path);
+
     int result = 0;
     if(0 != unlink(cache_path.c_str())){
         if(ENOENT == errno){
@@ -170,6 +199,44 @@ int FdManager::DeleteCacheFile(const char* path)
     return result;
 }
 
+//
+// Delete all cache files and cache stat files under the directory.
+//
+// [NOTE]
+// This is called after all objects under the directory are removed at
+// once, and the caller must check that no file under it is opened.
+//
+bool FdManager::DeleteCacheTree(const char* dir)
+{
+    S3FS_PRN_INFO3("[dir=%s]", SAFESTRPTR(dir));
+
+    if(!dir){
+        return false;
+    }
+    if(FdManager::cache_dir.empty()){
+        return true;
+    }
+    bool        result = true;
+    std::string cache_path;
+    std::string stat_path;
+    struct stat st;
+    FdManager::cache_index.RemoveTree(dir);
+    if(FdManager::MakeCachePath(dir, cache_path, false) && 0 == stat(cache_path.c_str(), &st) && S_ISDIR(st.st_mode)){
+        if(!delete_files_in_dir(cache_path.c_str(), true)){
+            S3FS_PRN_ERR("failed to delete cache directory(%s).", cache_path.c_str());
+            result = false;
+        }
+    }
+    stat_path = CacheFileStat::GetCacheFileStatTopDir() + SAFESTRPTR(dir);
+    if(0 == stat(stat_path.c_str(), &st) && S_ISDIR(st.st_mode)){
+        if(!delete_files_in_dir(stat_path.c_str(), true)){
+            S3FS_PRN_ERR("failed to delete cache stat directory(%s).", stat_path.c_str());
+            result = false;
+        }
+    }
+    return result;
+}
+
 bool FdManager::MakeCachePath(const char* path, std::string& cache_path, bool is_create_dir, bool is_mirror_path)
 {
     if(FdManager::cache_dir.empty()){
@@ -254,6 +321,46 @@ off_t FdManager::SetEnsureFreeDiskSpace(off_t size)
     return old;
 }
 
+off_t FdManager::SetMaxCacheSize(off_t size)
+{
+    off_t old = FdManager::max_cache_size;
+    FdManager::max_cache_size = size;
+    return old;
+}
+
+int FdManager::SetCacheHighWatermark(int percent)
+{
+    int old = FdManager::cache_high_watermark;
+    FdManager::cache_high_watermark = percent;
+    return old;
+}
+
+int FdManager::SetCacheLowWatermark(int percent)
+{
+    int old = FdManager::cache_low_watermark;
+    FdManager::cache_low_watermark = percent;
+    return old;
+}
+
+off_t FdManager::SetCacheBlockSize(off_t size)
+{
+    off_t old = FdManager::cache_block_size;
+    FdManager::cache_block_size = size;
+    return old;
+}
+
+bool FdManager::SetSharedCache(bool is_shared)
+{
+    bool old = FdManager::shared_cache;
+    FdManager::shared_cache = is_shared;
+    return old;
+}
+
+off_t FdManager::SetMemoryCacheSize(off_t size)
+{
+    return FdManager::memory_cache.SetMaxSize(size);
+}
+
 off_t FdManager::GetFreeDiskSpace(const char* path)
 {
     struct statvfs vfsbuf;
@@ -377,9 +484,119 @@ FILE* FdManager::MakeTempFile() {
     return fdopen(fd, "rb+");
 }
 
-bool FdManager::HasOpenEntityFd(const char* path)
+//
+// Build the index of cache files by scanning the cache directory once.
+//
+// [NOTE]
+// This is called at mounting. After that, the index is maintained when
+// the cache files are opened, closed, renamed and deleted, so that the
+// cache files can be evicted without scanning the cache directory.
+//
+bool FdManager::BuildCacheFileIndex()
 {
-    AutoLock auto_lock(&FdManager::fd_manager_lock);
+    if(!FdManager::IsCacheDir()){
+        return true;
+    }
+    FdManager::cache_index.Clear();
+    FdManager::shared_index_time = time(NULL);
+    FdManager::BuildCacheFileIndexInternal("");
+
+    S3FS_PRN_INFO("indexed %zu cache files(%lld bytes).", FdManager::cache_index.Count(), static_cast<long long>(FdManager::cache_index.TotalSize()));
+    return true;
+}
+
+void FdManager::BuildCacheFileIndexInternal(const std::string& path)
+{
+    DIR*           dp;
+    struct dirent* dent;
+    std::string    abs_path = cache_dir + "/" + bucket + path;
+
+    if(NULL == (dp = opendir(abs_path.c_str()))){
+        if(ENOENT != errno){
+            S3FS_PRN_ERR("could not open cache dir(%s) - errno(%d)", abs_path.c_str(), errno);
+        }
+        return;
+    }
+
+    for(dent = readdir(dp); dent; dent = readdir(dp)){
+        if(0 == strcmp(dent->d_name, "..") || 0 == strcmp(dent->d_name, ".")){
+            continue;
+        }
+        std::string fullpath = abs_path + "/" + dent->d_name;
+        struct stat st;
+        if(0 != lstat(fullpath.c_str(), &st)){
+            S3FS_PRN_ERR("could not get stats of file(%s) - errno(%d)", fullpath.c_str(), errno);
+            continue;
+        }
+        std::string next_path = path + "/" + dent->d_name;
+        if(S_ISDIR(st.st_mode)){
+            FdManager::BuildCacheFileIndexInternal(next_path);
+        }else if(S_ISREG(st.st_mode)){
+            // [NOTE]
+            // The atime is not updated on some mount options, so the
+            // newer of atime and mtime is used for the last access.
+            FdManager::cache_index.Set(next_path, static_cast<off_t>(st.st_blocks) * 512, std::max(st.st_atime, st.st_mtime), st.st_mtime);
+
+            // restore the content key from the stat file for reusing the cache file
+            std::string content;
+            if(FdEntity::GetCacheFileContentKey(next_path.c_str(), fullpath.c_str(), content)){
+                FdManager::cache_index.SetContent(next_path, content);
+            }
+        }
+    }
+    closedir(dp);
+}
+
+void FdManager::UpdateCacheFileIndex(const char* path)
+{
+    std::string cache_path;
+    if(!FdManager::MakeCachePath(path, cache_path, false) || cache_path.empty()){
+        return;
+    }
+    struct stat st;
+    if(0 != lstat(cache_path.c_str(), &st) || !S_ISREG(st.st_mode)){
+        FdManager::cache_index.Remove(path);
+        return;
+    }
+    FdManager::cache_index.Set(path, static_cast<off_t>(st.st_blocks) * 512, time(NULL), st.st_mtime);
+
+    FdManager::WakeupCacheEvictor();
+}
+
+//
+// If is_no_wait is true, this does not wait for fd_manager_lock and returns
+// true when it can not be locked(the file is treated as opened). This is
+// for the callers which have already locked the other entity.
+//
+//
+// Update the size of the opened cache file in the index after it is loaded,
+// written or evicted, so that max_cache_size is kept while it is opened.
+//
+// [NOTE]
+// This is called while the entity is locked, and it locks only the index
+// and the evictor.
+//
+void FdManager::UpdateCacheFileSize(const char* path, int fd)
+{
+    if(0 >= FdManager::max_cache_size || !path || -1 == fd){
+        return;
+    }
+    struct stat st;
+    if(-1 == fstat(fd, &st)){
+        S3FS_PRN_WARN("could not get stats of cache file(%s) - errno(%d)", path, errno);
+        return;
+    }
+    if(FdManager::cache_index.SetSize(path, static_cast<off_t>(st.st_blocks) * 512)){
+        FdManager::WakeupCacheEvictor();
+    }
+}
+
+bool FdManager::HasOpenEntityFd(const char* path, bool is_no_wait)
+{
+    AutoLock auto_lock(&FdManager::fd_manager_lock, is_no_wait ? AutoLock::NO_WAIT : AutoLock::NONE);
+    if(!auto_lock.isLockAcquired()){
+        return true;
+    }
 
     FdEntity*   ent;
     int         fd = -1;
@@ -389,6 +606,23 @@ bool FdManager::HasOpenEntityFd(const char* path)
     return (0 < ent->GetOpenCount());
 }
 
+bool FdManager::HasOpenEntityFdInDir(const char* dir)
+{
+    std::string strdir = SAFESTRPTR(dir);
+    if(strdir.empty() || '/' != *strdir.rbegin()){
+        strdir += "/";
+    }
+
+    AutoLock auto_lock(&FdManager::fd_manager_lock);
+
+    for(fdent_map_t::iterator iter = FdManager::singleton.fent.begin(); iter != FdManager::singleton.fent.end(); ++iter){
+        if(iter->second && 0 == strncmp(iter->second->GetPath(), strdir.c_str(), strdir.length()) && 0 < iter->second->GetOpenCount()){
+            return true;
+        }
+    }
+    return false;
+}
+
 //------------------------------------------------
 // FdManager methods
 //------------------------------------------------
@@ -413,6 +647,14 @@ FdManager::FdManager()
             S3FS_PRN_CRIT("failed to init reserved_diskspace_lock: %d", result);
             abort();
         }
+        if(0 != (result = pthread_mutex_init(&FdManager::cache_evictor_lock, &attr))){
+            S3FS_PRN_CRIT("failed to init cache_evictor_lock: %d", result);
+            abort();
+        }
+        if(0 != (result = pthread_cond_init(&FdManager::cache_evictor_cond, NULL))){
+            S3FS_PRN_CRIT("failed to init cache_evictor_cond: %d", result);
+            abort();
+        }
         FdManager::is_lock_init = true;
     }else{
         abort();
@@ -443,6 +685,14 @@ FdManager::~FdManager()
                 S3FS_PRN_CRIT("failed to destroy reserved_diskspace_lock: %d", result);
                 abort();
             }
+            if(0 != (result = pthread_cond_destroy(&FdManager::cache_evictor_cond))){
+                S3FS_PRN_CRIT("failed to destroy cache_evictor_cond: %d", result);
+                abort();
+            }
+            if(0 != (result = pthread_mutex_destroy(&FdManager::cache_evictor_lock))){
+                S3FS_PRN_CRIT("failed to destroy cache_evictor_lock: %d", result);
+                abort();
+            }
             FdManager::is_lock_init = false;
         }
     }else{
@@ -460,6 +710,13 @@ FdEntity* FdManager::GetFdEntity(const char* path, int& existfd, bool newfd, boo
     AutoLock auto_lock(&FdManager::fd_manager_lock, lock_already_held ? AutoLock::ALREADY_LOCKED : AutoLock::NONE);
 
     fdent_map_t::iterator iter = fent.find(std::string(path));
+    if(-1 == existfd && FdManager::IsSharedCache()){
+        // the entity which opened the temporary file for writing has priority.
+        fdent_map_t::iterator titer = FindTempEntity(path);
+        if(fent.end() != titer){
+            iter = titer;
+        }
+    }
     if(fent.end() != iter && iter->second){
         if(-1 == existfd){
             if(newfd){
@@ -494,10 +751,8 @@ FdEntity* FdManager::GetFdEntity(const char* path, int& existfd, bool newfd, boo
     // If the cache directory is not specified, s3fs opens a temporary file
     // when the file is opened.
     if(!FdManager::IsCacheDir()){
-        for(iter = fent.begin(); iter != fent.end(); ++iter){
-            if(iter->second && iter->second->IsOpen() && 0 == strcmp(iter->second->GetPath(), path)){
-                return iter->second;
-            }
+        if(fent.end() != (iter = FindTempEntity(path))){
+            return iter->second;
         }
     }
     return NULL;
@@ -511,6 +766,21 @@ FdEntity* FdManager::Open(int& fd, const char* path, headers_t* pmeta, off_t siz
         return NULL;
     }
 
+    // [NOTE]
+    // The cache files in the shared cache directory have only the data of
+    // the objects, so the file which is opened for writing uses a temporary
+    // file.
+    //
+    bool is_shared_write = (FdManager::IsSharedCache() && O_RDONLY != (flags & O_ACCMODE));
+    if(is_shared_write){
+        force_tmpfile = true;
+    }
+
+    // reuse the cache file of the other path which has same content
+    if(is_create && pmeta && !force_tmpfile && FdManager::IsCacheDir()){
+        ReuseCacheContent(path, *pmeta);
+    }
+
     AutoLock auto_lock(&FdManager::fd_manager_lock);
 
     // search in mapping by key(path)
@@ -521,10 +791,17 @@ FdEntity* FdManager::Open(int& fd, const char* path, headers_t* pmeta, off_t siz
         // Then if it could not find a entity in map for the file, s3fs should
         // search a entity in all which opened the temporary file.
         //
-        for(iter = fent.begin(); iter != fent.end(); ++iter){
-            if(iter->second && iter->second->IsOpen() && 0 == strcmp(iter->second->GetPath(), path)){
-                break;      // found opened fd in mapping
-            }
+        iter = FindTempEntity(path);
+
+    }else if(FdManager::IsSharedCache()){
+        // The entity which opened the temporary file for writing has priority
+        // over the entity of the cache file.
+        //
+        fdent_map_t::iterator titer = FindTempEntity(path);
+        if(fent.end() != titer){
+            iter = titer;
+        }else if(is_create && is_shared_write){
+            iter = fent.end();
         }
     }
 
@@ -581,9 +858,180 @@ FdEntity* FdManager::Open(int& fd, const char* path, headers_t* pmeta, off_t siz
     }else{
         return NULL;
     }
+    if(!force_tmpfile && FdManager::IsCacheDir()){
+        FdManager::UpdateCacheFileIndex(path);
+    }
     return ent;
 }
 
+//
+// Copy the cache file, by reflink(FICLONE) if the filesystem supports it.
+//
+bool FdManager::CloneCacheFile(const char* from, const char* to)
+{
+    int srcfd;
+    if(-1 == (srcfd = open(from, O_RDONLY))){
+        S3FS_PRN_ERR("failed to open cache file(%s) by errno(%d).", from, errno);
+        return false;
+    }
+    int dstfd;
+    if(-1 == (dstfd = open(to, O_WRONLY | O_TRUNC))){
+        S3FS_PRN_ERR("failed to open cache file(%s) by errno(%d).", to, errno);
+        close(srcfd);
+        return false;
+    }
+
+    bool result = false;
+#ifdef __linux__
+#ifndef FICLONE
+#define FICLONE     _IOW(0x94, 9, int)
+#endif
+    if(0 == ioctl(dstfd, FICLONE, srcfd)){
+        result = true;
+    }
+#endif
+    if(!result){
+        // copy data without reflink
+        char    buf[64 * 1024];
+        off_t   offset = 0;
+        ssize_t bytes;
+        result = true;
+        while(0 < (bytes = pread(srcfd, buf, sizeof(buf), offset))){
+            for(ssize_t written = 0, wbytes; written < bytes; written += wbytes){
+                if(-1 == (wbytes = pwrite(dstfd, &buf[written], bytes - written, offset + written))){
+                    S3FS_PRN_ERR("failed to write cache file(%s) by errno(%d).", to, errno);
+                    result = false;
+                    break;
+                }
+            }
+            if(!result){
+                break;
+            }
+            offset += bytes;
+        }
+        if(-1 == bytes){
+            S3FS_PRN_ERR("failed to read cache file(%s) by errno(%d).", from, errno);
+            result = false;
+        }
+    }
+    close(srcfd);
+    if(0 != close(dstfd)){
+        result = false;
+    }
+    return result;
+}
+
+//
+// If there is no cache file for path, make it from the cache file of the
+// other path which has same content(ETag and size). This allows the cache
+// to be reused after renaming or copying the object.
+//
+bool FdManager::ReuseCacheContent(const char* path, const headers_t& meta)
+{
+    std::string content = FdEntity::MakeContentKey(meta);
+    std::string from;
+    if(content.empty() || !FdManager::cache_index.FindContent(content, from) || from == path){
+        return false;
+    }
+
+    std::string from_cache_path;
+    std::string cache_path;
+    if(!FdManager::MakeCachePath(from.c_str(), from_cache_path, false) || !FdManager::MakeCachePath(path, cache_path, true)){
+        return false;
+    }
+    struct stat st;
+    if(0 == lstat(cache_path.c_str(), &st)){
+        // already has cache file
+        return false;
+    }
+    {
+        AutoLock auto_lock(&FdManager::fd_manager_lock);
+        if(fent.end() != fent.find(from)){
+            // the opened cache file may be modified
+            return false;
+        }
+    }
+    if(0 != lstat(from_cache_path.c_str(), &st)){
+        FdManager::cache_index.Remove(from);
+        return false;
+    }
+
+    // [NOTE]
+    // If the cache file can not be cloned, it is copied in this open path.
+    // So the disk space for the copy is reserved first, and the reuse is
+    // skipped when it is short(the object is downloaded as usual).
+    //
+    off_t need_size = static_cast<off_t>(st.st_blocks) * 512;
+    if(!FdManager::ReserveDiskSpace(need_size)){
+        S3FS_PRN_INFO("skip reusing cache file(%s) for %s, because there is not enough disk space.", from.c_str(), path);
+        FdManager::WakeupCacheEvictor();
+        return false;
+    }
+
+    // [NOTE]
+    // The content key in the index may be stale, because the other process
+    // may evict blocks of the cache file in the shared cache directory.
+    // So the stat file of the source is checked, and it is kept locked
+    // while cloning so that no blocks are evicted from it.
+    //
+    CacheFileStat from_cfstat;
+    std::string   from_content;
+    if(!FdEntity::GetCacheFileContentKey(from.c_str(), from_cache_path.c_str(), from_cfstat, from_content) || from_content != content){
+        S3FS_PRN_INFO("could not reuse cache file(%s) for %s, because it does not have all data of the object.", from.c_str(), path);
+        FdManager::cache_index.SetContent(from, from_content);
+        FdManager::FreeReservedDiskSpace(need_size);
+        return false;
+    }
+
+    // clone to the temporary file in the same directory
+    std::string tmppath = cache_path + ".XXXXXX";
+    int         tmpfd;
+    if(-1 == (tmpfd = mkstemp(&tmppath[0]))){
+        S3FS_PRN_ERR("failed to make temporary file for cache file(%s) by errno(%d).", cache_path.c_str(), errno);
+        FdManager::FreeReservedDiskSpace(need_size);
+        return false;
+    }
+    close(tmpfd);
+
+    struct stat st2;
+    bool        is_cloned = FdManager::CloneCacheFile(from_cache_path.c_str(), tmppath.c_str());
+    FdManager::FreeReservedDiskSpace(need_size);
+    if(!is_cloned || 0 != lstat(from_cache_path.c_str(), &st2) || st.st_ino != st2.st_ino || st.st_size != st2.st_size || st.st_mtime != st2.st_mtime){
+        S3FS_PRN_INFO("could not reuse cache file(%s) for %s.", from.c_str(), path);
+        unlink(tmppath.c_str());
+        return false;
+    }
+    from_cfstat.Release();
+
+    {
+        AutoLock auto_lock(&FdManager::fd_manager_lock);
+        if(fent.end() != fent.find(std::string(path)) || 0 == lstat(cache_path.c_str(), &st2) || -1 == rename(tmppath.c_str(), cache_path.c_str())){
+            unlink(tmppath.c_str());
+            return false;
+        }
+    }
+    if(0 != lstat(cache_path.c_str(), &st2)){
+        return false;
+    }
+
+    // all pages are loaded(checked with the stat file of the source)
+    CacheFileStat cfstat(path);
+    PageList      pagelist(st.st_size, true, false);
+    std::string   etag = get_etag(meta);
+    if(!pagelist.Serialize(cfstat, true, st2.st_ino, &etag)){
+        S3FS_PRN_ERR("failed to save cache stat file for %s.", path);
+        unlink(cache_path.c_str());
+        return false;
+    }
+    FdManager::cache_index.Set(path, static_cast<off_t>(st2.st_blocks) * 512, time(NULL));
+    FdManager::cache_index.SetContent(path, content);
+    FdManager::WakeupCacheEvictor();
+
+    S3FS_PRN_INFO("reused cache file(%s) for %s.", from.c_str(), path);
+
+    return true;
+}
+
 // [NOTE]
 // This method does not create a new pseudo fd.
 // It just finds existfd and returns the corresponding entity.
@@ -620,6 +1068,8 @@ FdEntity* FdManager::OpenExistFdEntity(const char* path, int& fd, int flags)
 
 void FdManager::Rename(const std::string &from, const std::string &to)
 {
+    FdManager::memory_cache.Rename(from, to);
+
     AutoLock auto_lock(&FdManager::fd_manager_lock);
 
     fdent_map_t::iterator iter = fent.find(from);
@@ -629,34 +1079,115 @@ void FdManager::Rename(const std::string &from, const std::string &to)
         // Then if it could not find a entity in map for the file, s3fs should
         // search a entity in all which opened the temporary file.
         //
-        for(iter = fent.begin(); iter != fent.end(); ++iter){
-            if(iter->second && iter->second->IsOpen() && 0 == strcmp(iter->second->GetPath(), from.c_str())){
-                break;              // found opened fd in mapping
-            }
-        }
+        iter = FindTempEntity(from.c_str());
     }
 
     if(fent.end() != iter){
         // found
-        S3FS_PRN_DBG("[from=%s][to=%s]", from.c_str(), to.c_str());
+        bool is_cache = FdManager::IsCacheDir() && iter->first == from;
+        if(!RenameEntity(iter, to)){
+            return;
+        }
+        if(is_cache){
+            FdManager::cache_index.Rename(from, to);
+        }
+    }
 
-        FdEntity* ent = iter->second;
+    // the entity which opened the temporary file for writing in the shared
+    // cache directory is also renamed.
+    if(FdManager::IsSharedCache() && fent.end() != (iter = FindTempEntity(from.c_str()))){
+        RenameEntity(iter, to);
+    }
+}
 
-        // retrieve old fd entity from map
-        fent.erase(iter);
+//
+// Update the cached ETag of the object from old_etag to new_etag, after the
+// object is copied without changing its data(ex. updating meta).
+// The opened entity updates its own ETag, otherwise the ETag in the cache
+// stat file and the content key in the index are updated.
+//
+void FdManager::UpdateCacheETag(const char* path, const std::string& old_etag, const std::string& new_etag)
+{
+    S3FS_PRN_DBG("[path=%s][old_etag=%s][new_etag=%s]", SAFESTRPTR(path), old_etag.c_str(), new_etag.c_str());
 
-        // rename path and caches in fd entity
-        std::string fentmapkey;
-        if(!ent->RenamePath(to, fentmapkey)){
-            S3FS_PRN_ERR("Failed to rename FdEntity object for %s to %s", from.c_str(), to.c_str());
-            return;
+    if(!path || old_etag.empty() || new_etag.empty() || old_etag == new_etag){
+        return;
+    }
+
+    AutoLock auto_lock(&FdManager::fd_manager_lock);
+
+    bool is_opened = false;
+    for(fdent_map_t::iterator iter = fent.begin(); iter != fent.end(); ++iter){
+        if(iter->second && 0 == strcmp(iter->second->GetPath(), path)){
+            iter->second->UpdateCacheETag(old_etag, new_etag);
+            is_opened = true;
         }
+    }
+    if(is_opened || !FdManager::IsCacheDir()){
+        return;
+    }
 
-        // set new fd entity to map
-        fent[fentmapkey] = ent;
+    // the cache file opened by the other processes keeps its ETag
+    int lockfd = -1;
+    if(FdManager::IsSharedCache() && -1 == (lockfd = FdManager::LockUnusedCacheFile(path))){
+        return;
+    }
+    std::string cache_path;
+    std::string content;
+    if(FdManager::MakeCachePath(path, cache_path, false) && FdEntity::UpdateCacheFileETag(path, cache_path.c_str(), old_etag, new_etag, content)){
+        FdManager::cache_index.SetContent(path, content);
+    }
+    if(-1 != lockfd){
+        close(lockfd);
     }
 }
 
+//
+// Rename the entity, and set it to the map by new key.
+//
+// [NOTE]
+// The caller must have fd_manager_lock.
+//
+bool FdManager::RenameEntity(fdent_map_t::iterator& iter, const std::string& to)
+{
+    FdEntity* ent = iter->second;
+
+    S3FS_PRN_DBG("[from=%s][to=%s]", ent->GetPath(), to.c_str());
+
+    // retrieve old fd entity from map
+    fent.erase(iter);
+
+    // rename path and caches in fd entity
+    std::string from(ent->GetPath());
+    std::string fentmapkey;
+    if(!ent->RenamePath(to, fentmapkey)){
+        S3FS_PRN_ERR("Failed to rename FdEntity object for %s to %s", from.c_str(), to.c_str());
+        return false;
+    }
+
+    // set new fd entity to map
+    fent[fentmapkey] = ent;
+
+    return true;
+}
+
+//
+// Search the opened entity which uses the temporary file for path.
+//
+// [NOTE]
+// The caller must have fd_manager_lock.
+//
+fdent_map_t::iterator FdManager::FindTempEntity(const char* path)
+{
+    fdent_map_t::iterator iter;
+    for(iter = fent.begin(); iter != fent.end(); ++iter){
+        if(iter->first != path && iter->second && iter->second->IsOpen() && 0 == strcmp(iter->second->GetPath(), path)){
+            break;      // found opened fd in mapping
+        }
+    }
+    return iter;
+}
+
 bool FdManager::Close(FdEntity* ent, int fd)
 {
     S3FS_PRN_DBG("[ent->file=%s][pseudo_fd=%d]", ent ? ent->GetPath() : "", fd);
@@ -670,6 +1201,16 @@ bool FdManager::Close(FdEntity* ent, int fd)
         if(iter->second == ent){
             ent->Close(fd);
             if(!ent->IsOpen()){
+                // update the size and the last access of cache file
+                if(FdManager::IsCacheDir()){
+                    FdManager::UpdateCacheFileIndex(ent->GetPath());
+
+                    std::string content;
+                    if(ent->GetCacheContentKey(content)){
+                        FdManager::cache_index.SetContent(ent->GetPath(), content);
+                    }
+                }
+
                 // remove found entity from map.
                 fent.erase(iter++);
 
@@ -707,7 +1248,11 @@ bool FdManager::ChangeEntityToTempPath(FdEntity* ent, const char* path)
     return false;
 }
 
-void FdManager::CleanupCacheDir()
+//
+// Evict the least recently used cache files which are not opened, until
+// the disk has free space for size bytes.
+//
+void FdManager::CleanupCacheDir(off_t size)
 {
     //S3FS_PRN_DBG("cache cleanup requested");
 
@@ -719,7 +1264,7 @@ void FdManager::CleanupCacheDir()
 
     if(auto_lock_no_wait.isLockAcquired()){
         //S3FS_PRN_DBG("cache cleanup started");
-        CleanupCacheDirInternal("");
+        CleanupCacheDirInternal(size);
         //S3FS_PRN_DBG("cache cleanup ended");
     }else{
         // wait for other thread to finish cache cleanup
@@ -727,47 +1272,339 @@ void FdManager::CleanupCacheDir()
     }
 }
 
-void FdManager::CleanupCacheDirInternal(const std::string &path)
+void FdManager::CleanupCacheDirInternal(off_t size)
 {
-    DIR*           dp;
-    struct dirent* dent;
-    std::string    abs_path = cache_dir + "/" + bucket + path;
+    off_t need = size + FdManager::GetEnsureFreeDiskSpace() - FdManager::GetFreeDiskSpace(NULL);
+    if(need <= 0){
+        return;
+    }
+    off_t freed = EvictCacheFiles(need);
 
-    if(NULL == (dp = opendir(abs_path.c_str()))){
-        S3FS_PRN_ERR("could not open cache dir(%s) - errno(%d)", abs_path.c_str(), errno);
+    // evict the cold blocks of the opened cache files, if it is not enough.
+    if(freed < need){
+        EvictOpenCacheBlocks(need - freed);
+    }
+}
+
+//
+// Evict the cold blocks of the opened cache files, until need bytes are
+// freed. Returns the freed bytes.
+//
+// [NOTE]
+// This does nothing if the other thread has fd_manager_lock, because this
+// is called under disk pressure while the entity of the caller is locked.
+// The entities which are locked by the other threads are skipped.
+//
+off_t FdManager::EvictOpenCacheBlocks(off_t need)
+{
+    if(0 >= FdManager::cache_block_size || FdManager::IsSharedCache()){
+        return 0;
+    }
+    AutoLock auto_lock(&FdManager::fd_manager_lock, AutoLock::NO_WAIT);
+    if(!auto_lock.isLockAcquired()){
+        return 0;
+    }
+
+    off_t freed = 0;
+    for(fdent_map_t::iterator iter = fent.begin(); iter != fent.end() && freed < need; ++iter){
+        FdEntity* ent = iter->second;
+        if(!ent || !ent->IsOpen()){
+            continue;
+        }
+        off_t bfreed = ent->EvictColdBlocks(FdManager::cache_block_size, need - freed);
+        if(0 < bfreed){
+            // the cache file does not have all data any more
+            FdManager::cache_index.SetContent(ent->GetPath(), std::string(""));
+            freed += bfreed;
+        }
+    }
+    if(0 < freed){
+        S3FS_PRN_INFO("evicted the cold blocks(%lld bytes) of opened cache files.", static_cast<long long int>(freed));
+    }
+    return freed;
+}
+
+//
+// Evict the least recently used cache files which are not opened, until
+// need bytes are freed. Returns the freed bytes.
+//
+// [NOTE]
+// The caller must have cache_cleanup_lock.
+//
+off_t FdManager::EvictCacheFiles(off_t need)
+{
+    std::set<std::string> excludes;
+    size_t                count = 0;
+    off_t                 freed = 0;
+    while(freed < need){
+        std::string path;
+        off_t       fsize = 0;
+        if(!FdManager::cache_index.GetLeastRecentlyUsed(path, fsize, &excludes)){
+            S3FS_PRN_INFO("there is no cache file which can be cleaned up any more.");
+            break;
+        }
+
+        AutoLock auto_lock(&FdManager::fd_manager_lock, AutoLock::NO_WAIT);
+        if (!auto_lock.isLockAcquired()) {
+            S3FS_PRN_ERR("could not get fd_manager_lock when clean up file(%s)", path.c_str());
+            excludes.insert(path);
+            continue;
+        }
+        if(fent.end() != fent.find(path)){
+            // opened file is not cleaned up
+            excludes.insert(path);
+            continue;
+        }
+
+        // the cache file opened by the other processes is not cleaned up
+        int lockfd = -1;
+        if(FdManager::IsSharedCache() && -1 == (lockfd = FdManager::LockUnusedCacheFile(path.c_str()))){
+            excludes.insert(path);
+            continue;
+        }
+
+        // evict only cold blocks of the large cache file
+        std::string cache_path;
+        bool        is_evicted = false;
+        if(0 < FdManager::cache_block_size && FdManager::cache_block_size < fsize && FdManager::MakeCachePath(path.c_str(), cache_path, false)){
+            bool  is_empty = false;
+            off_t bfreed   = FdEntity::EvictCacheBlocks(path.c_str(), cache_path.c_str(), FdManager::cache_block_size, need - freed, is_empty);
+            if(0 <= bfreed && !is_empty){
+                struct stat st;
+                if(0 == lstat(cache_path.c_str(), &st)){
+                    FdManager::cache_index.SetSize(path, static_cast<off_t>(st.st_blocks) * 512);
+                }
+                // the cache file does not have all data any more
+                FdManager::cache_index.SetContent(path, std::string(""));
+                S3FS_PRN_DBG("cleaned up blocks: %s", path.c_str());
+                excludes.insert(path);
+                freed     += bfreed;
+                is_evicted = true;
+            }
+        }
+        if(!is_evicted){
+            S3FS_PRN_DBG("cleaned up: %s", path.c_str());
+            FdManager::DeleteCacheFile(path.c_str());
+            freed += fsize;
+            ++count;
+        }
+        if(-1 != lockfd){
+            close(lockfd);
+        }
+    }
+    if(0 < count){
+        S3FS_PRN_INFO("cleaned up %zu cache files(%lld bytes).", count, static_cast<long long>(freed));
+    }
+
+    return freed;
+}
+
+//
+// Lock the cache file exclusively, only if the other processes do not open
+// it. Returns the locked file descriptor, and the caller must close it.
+//
+int FdManager::LockUnusedCacheFile(const char* path)
+{
+    std::string cache_path;
+    if(!FdManager::MakeCachePath(path, cache_path, false)){
+        return -1;
+    }
+    return FdManager::cache_index.LockUnusedFile(path, cache_path.c_str());
+}
+
+//
+// Merge the changes of the cache directory into the index periodically,
+// because the other processes which share the cache directory add and
+// remove the cache files.
+//
+// [NOTE]
+// Only the directories which are modified after the last scan are read,
+// and their changes are merged without clearing the index, so that the
+// last access time and the content key of the cache files are kept.
+// The size of the cache file which the other process changes without
+// adding or removing it is updated when it is opened or evicted.
+//
+void FdManager::RescanSharedCacheDir()
+{
+    if(!FdManager::IsSharedCache() || time(NULL) < FdManager::shared_index_time + SHARED_CACHE_RESCAN_INTERVAL){
         return;
     }
+    AutoLock auto_lock(&FdManager::cache_cleanup_lock, AutoLock::NO_WAIT);
+    if(!auto_lock.isLockAcquired()){
+        return;
+    }
+    // the directories modified in the same second as the last scan are read again
+    time_t scan_time = time(NULL);
+    FdManager::RescanSharedCacheDirInternal("", FdManager::shared_index_time);
+    FdManager::shared_index_time = scan_time;
 
-    for(dent = readdir(dp); dent; dent = readdir(dp)){
+    S3FS_PRN_INFO3("indexed %zu cache files(%lld bytes) after rescan.", FdManager::cache_index.Count(), static_cast<long long>(FdManager::cache_index.TotalSize()));
+}
+
+void FdManager::RescanSharedCacheDirInternal(const std::string& path, time_t since)
+{
+    std::string abs_path = cache_dir + "/" + bucket + path;
+    struct stat st;
+    DIR*        dp;
+    if(0 != stat(abs_path.c_str(), &st) || NULL == (dp = opendir(abs_path.c_str()))){
+        if(ENOENT == errno){
+            FdManager::cache_index.RemoveTree(path);
+        }else{
+            S3FS_PRN_ERR("could not open cache dir(%s) - errno(%d)", abs_path.c_str(), errno);
+        }
+        return;
+    }
+    bool is_changed = (since <= st.st_mtime);
+
+    cache_index_map_t     files;
+    std::set<std::string> subdirs;
+    for(struct dirent* dent = readdir(dp); dent; dent = readdir(dp)){
         if(0 == strcmp(dent->d_name, "..") || 0 == strcmp(dent->d_name, ".")){
             continue;
         }
-        std::string fullpath = abs_path;
-        fullpath         += "/";
-        fullpath         += dent->d_name;
-        struct stat st;
-        if(0 != lstat(fullpath.c_str(), &st)){
-            S3FS_PRN_ERR("could not get stats of file(%s) - errno(%d)", fullpath.c_str(), errno);
-            closedir(dp);
-            return;
+        // the files in the directory which is not modified are not needed
+        if(!is_changed && DT_DIR != dent->d_type && DT_UNKNOWN != dent->d_type){
+            continue;
         }
-        std::string next_path = path + "/" + dent->d_name;
-        if(S_ISDIR(st.st_mode)){
-            CleanupCacheDirInternal(next_path);
-        }else{
-            AutoLock auto_lock(&FdManager::fd_manager_lock, AutoLock::NO_WAIT);
-            if (!auto_lock.isLockAcquired()) {
-                S3FS_PRN_ERR("could not get fd_manager_lock when clean up file(%s)", next_path.c_str());
-                continue;
-            }
-            fdent_map_t::iterator iter = fent.find(next_path);
-            if(fent.end() == iter) {
-                S3FS_PRN_DBG("cleaned up: %s", next_path.c_str());
-                FdManager::DeleteCacheFile(next_path.c_str());
+        std::string fullpath = abs_path + "/" + dent->d_name;
+        struct stat fst;
+        if(0 != lstat(fullpath.c_str(), &fst)){
+            continue;   // removed by the other process
+        }
+        if(S_ISDIR(fst.st_mode)){
+            subdirs.insert(dent->d_name);
+        }else if(is_changed && S_ISREG(fst.st_mode)){
+            cache_index_entry& entry = files[dent->d_name];
+            entry = cache_index_entry(static_cast<off_t>(fst.st_blocks) * 512, std::max(fst.st_atime, fst.st_mtime), fst.st_mtime);
+
+            // restore the content key of the cache file which is made or renamed after the last scan
+            if(since <= std::max(fst.st_mtime, fst.st_ctime)){
+                FdEntity::GetCacheFileContentKey((path + "/" + dent->d_name).c_str(), fullpath.c_str(), entry.content);
             }
         }
     }
     closedir(dp);
+
+    if(is_changed){
+        FdManager::cache_index.MergeDirectory(path, files, subdirs);
+    }
+    for(std::set<std::string>::const_iterator iter = subdirs.begin(); iter != subdirs.end(); ++iter){
+        FdManager::RescanSharedCacheDirInternal(path + "/" + *iter, since);
+    }
+}
+
+//
+// Evict the cache files down to the low watermark, when the total size
+// of the cache files is over the high watermark of max_cache_size.
+//
+void FdManager::EvictOverBudget()
+{
+    if(0 >= FdManager::max_cache_size){
+        return;
+    }
+    FdManager::RescanSharedCacheDir();
+
+    off_t high  = FdManager::max_cache_size / 100 * FdManager::cache_high_watermark;
+    off_t low   = FdManager::max_cache_size / 100 * FdManager::cache_low_watermark;
+    off_t total = FdManager::cache_index.TotalSize();
+    if(total <= high){
+        return;
+    }
+
+    // [NOTE]
+    // If the other thread is cleaning up, skip this time.
+    AutoLock auto_lock(&FdManager::cache_cleanup_lock, AutoLock::NO_WAIT);
+    if(!auto_lock.isLockAcquired()){
+        return;
+    }
+    S3FS_PRN_INFO("cache size(%lld) is over the high watermark(%lld), so evict to the low watermark(%lld).", static_cast<long long>(total), static_cast<long long>(high), static_cast<long long>(low));
+    off_t freed = EvictCacheFiles(total - low);
+
+    // evict the cold blocks of the opened cache files, if it is not enough.
+    if(freed < total - low){
+        EvictOpenCacheBlocks(total - low - freed);
+    }
+}
+
+bool FdManager::StartCacheEvictor()
+{
+    if(!FdManager::IsCacheDir() || 0 >= FdManager::max_cache_size){
+        return true;
+    }
+    AutoLock auto_lock(&FdManager::cache_evictor_lock);
+
+    if(FdManager::is_cache_evictor_run){
+        return true;
+    }
+    FdManager::is_cache_evictor_run = true;
+
+    int result;
+    if(0 != (result = pthread_create(&FdManager::cache_evictor_thread, NULL, FdManager::CacheEvictor, NULL))){
+        S3FS_PRN_ERR("Could not create thread for cache evictor by %d", result);
+        FdManager::is_cache_evictor_run = false;
+        return false;
+    }
+    return true;
+}
+
+bool FdManager::StopCacheEvictor()
+{
+    {
+        AutoLock auto_lock(&FdManager::cache_evictor_lock);
+        if(!FdManager::is_cache_evictor_run){
+            return true;
+        }
+        FdManager::is_cache_evictor_run = false;
+        pthread_cond_broadcast(&FdManager::cache_evictor_cond);
+    }
+
+    int result;
+    if(0 != (result = pthread_join(FdManager::cache_evictor_thread, NULL))){
+        S3FS_PRN_ERR("failed pthread_join - rc(%d)", result);
+        return false;
+    }
+    return true;
+}
+
+//
+// Wake up the cache evictor thread if the cache is over the high watermark.
+//
+void FdManager::WakeupCacheEvictor()
+{
+    if(0 >= FdManager::max_cache_size){
+        return;
+    }
+    if(FdManager::cache_index.TotalSize() <= FdManager::max_cache_size / 100 * FdManager::cache_high_watermark){
+        return;
+    }
+    AutoLock auto_lock(&FdManager::cache_evictor_lock);
+    pthread_cond_signal(&FdManager::cache_evictor_cond);
+}
+
+void* FdManager::CacheEvictor(void* arg)
+{
+    S3FS_PRN_INFO3("start cache evictor.");
+
+    while(true){
+        {
+            AutoLock auto_lock(&FdManager::cache_evictor_lock);
+            if(!FdManager::is_cache_evictor_run){
+                break;
+            }
+            // wait 1 second(or wakeup, stop)
+            struct timespec abstime;
+            clock_gettime(CLOCK_REALTIME, &abstime);
+            abstime.tv_sec += 1;
+            pthread_cond_timedwait(&FdManager::cache_evictor_cond, &FdManager::cache_evictor_lock, &abstime);
+            if(!FdManager::is_cache_evictor_run){
+                break;
+            }
+        }
+        FdManager::get()->EvictOverBudget();
+    }
+    S3FS_PRN_INFO3("stop cache evictor.");
+
+    return NULL;
 }
 
 bool FdManager::ReserveDiskSpace(off_t size)
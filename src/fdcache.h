@@ -22,6 +22,8 @@
 #define S3FS_FDCACHE_H_
 
 #include "fdcache_entity.h"
+#include "fdcache_index.h"
+#include "fdcache_memory.h"
 
 //------------------------------------------------
 // class FdManager
@@ -33,20 +35,44 @@ class FdManager
       static pthread_mutex_t fd_manager_lock;
       static pthread_mutex_t cache_cleanup_lock;
       static pthread_mutex_t reserved_diskspace_lock;
+      static pthread_mutex_t cache_evictor_lock;
+      static pthread_cond_t  cache_evictor_cond;
+      static pthread_t       cache_evictor_thread;
+      static bool            is_cache_evictor_run;
       static bool            is_lock_init;
       static std::string     cache_dir;
       static bool            check_cache_dir_exist;
       static off_t           free_disk_space; // limit free disk space
+      static off_t           max_cache_size;  // byte budget for cache files(0 means no limit)
+      static int             cache_high_watermark;    // percent of max_cache_size to start eviction
+      static int             cache_low_watermark;     // percent of max_cache_size to stop eviction
+      static off_t           cache_block_size;        // block size for evicting cold blocks of large cache files(0 means disabled)
+      static bool            shared_cache;            // the cache directory is shared by multiple processes
+      static time_t          shared_index_time;       // last time of scanning the shared cache directory for the index
       static std::string     check_cache_output;
       static bool            checked_lseek;
       static bool            have_lseek_hole;
       static std::string     tmp_dir;
+      static CacheFileIndex  cache_index;     // index of cache files for eviction
+      static MemoryBlockCache memory_cache;   // in-memory block cache shared by all entities
 
       fdent_map_t            fent;
 
   private:
       static off_t GetFreeDiskSpace(const char* path);
-      void CleanupCacheDirInternal(const std::string &path = "");
+      void CleanupCacheDirInternal(off_t size);
+      off_t EvictCacheFiles(off_t need);
+      off_t EvictOpenCacheBlocks(off_t need);
+      static void* CacheEvictor(void* arg);
+      static void BuildCacheFileIndexInternal(const std::string& path);
+      static void UpdateCacheFileIndex(const char* path);
+      static int LockUnusedCacheFile(const char* path);
+      static void RescanSharedCacheDir();
+      static void RescanSharedCacheDirInternal(const std::string& path, time_t since);
+      fdent_map_t::iterator FindTempEntity(const char* path);
+      bool RenameEntity(fdent_map_t::iterator& iter, const std::string& to);
+      static bool CloneCacheFile(const char* from, const char* to);
+      bool ReuseCacheContent(const char* path, const headers_t& meta);
       bool RawCheckAllCache(FILE* fp, const char* cache_stat_top_dir, const char* sub_path, int& total_file_cnt, int& err_file_cnt, int& err_dir_cnt);
       static bool IsDir(const std::string* dir);
 
@@ -59,6 +85,7 @@ class FdManager
 
       static bool DeleteCacheDirectory();
       static int DeleteCacheFile(const char* path);
+      static bool DeleteCacheTree(const char* dir);
       static bool SetCacheDir(const char* dir);
       static bool IsCacheDir() { return !FdManager::cache_dir.empty(); }
       static const char* GetCacheDir() { return FdManager::cache_dir.c_str(); }
@@ -69,7 +96,8 @@ class FdManager
       static bool MakeRandomTempPath(const char* path, std::string& tmppath);
       static bool SetCheckCacheDirExist(bool is_check);
       static bool CheckCacheDirExist();
-      static bool HasOpenEntityFd(const char* path);
+      static bool HasOpenEntityFd(const char* path, bool is_no_wait = false);
+      static bool HasOpenEntityFdInDir(const char* dir);
       static off_t GetEnsureFreeDiskSpace();
       static off_t SetEnsureFreeDiskSpace(off_t size);
       static bool IsSafeDiskSpace(const char* path, off_t size);
@@ -79,6 +107,24 @@ class FdManager
       static bool SetTmpDir(const char* dir);
       static bool CheckTmpDirExist();
       static FILE* MakeTempFile();
+      static bool BuildCacheFileIndex();
+      static off_t SetMaxCacheSize(off_t size);
+      static off_t GetMaxCacheSize() { return FdManager::max_cache_size; }
+      static int SetCacheHighWatermark(int percent);
+      static int GetCacheHighWatermark() { return FdManager::cache_high_watermark; }
+      static int SetCacheLowWatermark(int percent);
+      static int GetCacheLowWatermark() { return FdManager::cache_low_watermark; }
+      static off_t SetCacheBlockSize(off_t size);
+      static off_t GetCacheBlockSize() { return FdManager::cache_block_size; }
+      static bool SetSharedCache(bool is_shared);
+      static bool IsSharedCache() { return FdManager::shared_cache; }
+      static off_t SetMemoryCacheSize(off_t size);
+      static off_t GetMemoryCacheSize() { return FdManager::memory_cache.GetMaxSize(); }
+      static MemoryBlockCache* GetMemoryCache() { return &FdManager::memory_cache; }
+      static bool StartCacheEvictor();
+      static bool StopCacheEvictor();
+      static void WakeupCacheEvictor();
+      static void UpdateCacheFileSize(const char* path, int fd);
 
       // Return FdEntity associated with path, returning NULL on error.  This operation increments the reference count; callers must decrement via Close after use.
       FdEntity* GetFdEntity(const char* path, int& existfd, bool newfd = true, bool lock_already_held = false);
@@ -86,9 +132,11 @@ class FdManager
       FdEntity* GetExistFdEntity(const char* path, int existfd = -1);
       FdEntity* OpenExistFdEntity(const char* path, int& fd, int flags = O_RDONLY);
       void Rename(const std::string &from, const std::string &to);
+      void UpdateCacheETag(const char* path, const std::string& old_etag, const std::string& new_etag);
       bool Close(FdEntity* ent, int fd);
       bool ChangeEntityToTempPath(FdEntity* ent, const char* path);
-      void CleanupCacheDir();
+      void CleanupCacheDir(off_t size = 0);
+      void EvictOverBudget();
 
       bool CheckAllCache();
 };
@@ -23,7 +23,9 @@
 #include <cerrno>
 #include <unistd.h>
 #include <limits.h>
+#include <fcntl.h>
 #include <sys/time.h>
+#include <sys/file.h>
 
 #include "common.h"
 #include "s3fs.h"
@@ -39,6 +41,12 @@
 //------------------------------------------------
 static const int MAX_MULTIPART_CNT         = 10 * 1000; // S3 multipart max count
 
+//------------------------------------------------
+// Global functions in s3fs.cpp
+//------------------------------------------------
+int put_headers(const char* path, headers_t& meta, bool is_copy, bool use_st_size = true, bool update_cache_etag = true);
+int delete_renamed_object(const char* path, const std::string& etag);
+
 //------------------------------------------------
 // FdEntity class variables
 //------------------------------------------------
@@ -90,13 +98,40 @@ ino_t FdEntity::GetInode(int fd)
     return st.st_ino;
 }
 
+//
+// Check whether the cache file has the data of the object.
+// If both ETags of the object and the cached data are known, they are
+// compared. Otherwise the cache file must not be older than the object.
+//
+bool FdEntity::IsCacheFileFresh(int fd, const std::string& etag, const std::string& cached_etag, time_t time)
+{
+    if(!etag.empty() && !cached_etag.empty()){
+        if(etag != cached_etag){
+            S3FS_PRN_DBG("cache file stale by ETag(%s != %s)", cached_etag.c_str(), etag.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    struct stat st;
+    if(0 != fstat(fd, &st)){
+        S3FS_PRN_ERR("could not get stat for physical file descriptor(%d) by errno(%d).", fd, errno);
+        return false;
+    }
+    if(st.st_mtime < time){
+        S3FS_PRN_DBG("cache file stale by mtime(%lld < %lld)", static_cast<long long>(st.st_mtime), static_cast<long long>(time));
+        return false;
+    }
+    return true;
+}
+
 //------------------------------------------------
 // FdEntity methods
 //------------------------------------------------
 FdEntity::FdEntity(const char* tpath, const char* cpath) :
     is_lock_init(false), path(SAFESTRPTR(tpath)),
     physical_fd(-1), pfile(NULL), inode(0), size_orgmeta(0),
-    cachepath(SAFESTRPTR(cpath)), is_meta_pending(false)
+    cachepath(SAFESTRPTR(cpath)), is_meta_pending(false), has_remote_object(true)
 {
     holding_mtime.tv_sec = -1;
     holding_mtime.tv_nsec = 0;
@@ -155,8 +190,7 @@ void FdEntity::Clear()
             //
             ino_t cur_inode = GetInode();
             if(0 != cur_inode && cur_inode == inode){
-                CacheFileStat cfstat(path.c_str());
-                if(!pagelist.Serialize(cfstat, true, inode)){
+                if(!SaveCacheFileStat()){
                     S3FS_PRN_WARN("failed to save cache stat file(%s).", path.c_str());
                 }
             }
@@ -178,6 +212,7 @@ void FdEntity::Clear()
     pagelist.Init(0, false, false);
     path      = "";
     cachepath = "";
+    renamed_objects.clear();
 }
 
 // [NOTE]
@@ -227,8 +262,7 @@ void FdEntity::Close(int fd)
             //
             ino_t cur_inode = GetInode();
             if(0 != cur_inode && cur_inode == inode){
-                CacheFileStat cfstat(path.c_str());
-                if(!pagelist.Serialize(cfstat, true, inode)){
+                if(!SaveCacheFileStat()){
                     S3FS_PRN_WARN("failed to save cache stat file(%s).", path.c_str());
                 }
             }
@@ -404,6 +438,55 @@ bool FdEntity::IsUploading(bool lock_already_held)
 // If the open is successful, returns pseudo fd.
 // If it fails, it returns an error code with a negative value.
 //
+//
+// Save the pagelist to the cache stat file.
+// In the shared cache directory, the pages which the other processes loaded
+// into the same cache file are merged at first under the lock of the cache
+// stat file, so that they are not lost.
+//
+// [NOTE]
+// The caller must have fdent_data_lock.
+//
+bool FdEntity::SaveCacheFileStat()
+{
+    CacheFileStat cfstat(path.c_str());
+    if(FdManager::IsSharedCache()){
+        pagelist.MergeLoadedPages(cfstat, inode, cache_etag);
+    }
+    return pagelist.Serialize(cfstat, true, inode, &cache_etag);
+}
+
+//
+// Lock(or unlock) the range of the cache file while downloading it in the
+// shared cache directory, so that the same range is not downloaded by the
+// multiple processes at the same time.
+//
+// [NOTE]
+// The open file description lock is used if it is supported, because the
+// POSIX record lock is released by closing any descriptor of the file.
+//
+bool FdEntity::LockCacheFileRange(off_t start, off_t size, bool is_lock)
+{
+    struct flock lock;
+    memset(&lock, 0, sizeof(struct flock));
+    lock.l_type   = is_lock ? F_WRLCK : F_UNLCK;
+    lock.l_whence = SEEK_SET;
+    lock.l_start  = start;
+    lock.l_len    = size;
+#ifdef F_OFD_SETLKW
+    int cmd = F_OFD_SETLKW;
+#else
+    int cmd = F_SETLKW;
+#endif
+    while(-1 == fcntl(physical_fd, cmd, &lock)){
+        if(EINTR != errno){
+            S3FS_PRN_ERR("failed to %s range(%lld, %lld) of cache file(%s) by errno(%d).", (is_lock ? "lock" : "unlock"), static_cast<long long>(start), static_cast<long long>(size), cachepath.c_str(), errno);
+            return false;
+        }
+    }
+    return true;
+}
+
 int FdEntity::Open(headers_t* pmeta, off_t size, time_t time, int flags, AutoLock::Type type)
 {
     AutoLock auto_lock(&fdent_lock, type);
@@ -453,25 +536,30 @@ int FdEntity::Open(headers_t* pmeta, off_t size, time_t time, int flags, AutoLoc
         bool  need_save_csf = false;  // need to save(reset) cache stat file
         bool  is_truncate   = false;  // need to truncate
 
+        // the data of cache file will be for this object
+        std::string etag = (pmeta ? get_etag(*pmeta) : std::string(""));
+
         if(!cachepath.empty()){
             // using cache
             struct stat st;
-            if(stat(cachepath.c_str(), &st) == 0){
-                if(st.st_mtime < time){
-                    S3FS_PRN_DBG("cache file stale, removing: %s", cachepath.c_str());
-                    if(unlink(cachepath.c_str()) != 0){
-                        return (0 == errno ? -EIO : -errno);
-                    }
-                }
-            }
 
             // open cache and cache stat file, load page info.
             CacheFileStat cfstat(path.c_str());
+            std::string   cached_etag;
+
+            // [NOTE]
+            // In the shared cache directory, the cache file is locked shared
+            // while it is opened, so that the other processes do not evict it.
+            // This lock is got before the cache stat file is locked.
+            //
+            bool is_shared = FdManager::IsSharedCache();
 
             // try to open cache file
-            if( -1 != (physical_fd = open(cachepath.c_str(), O_RDWR)) &&
-                0 != (inode = FdEntity::GetInode(physical_fd))        &&
-                pagelist.Serialize(cfstat, false, inode)          )
+            if( -1 != (physical_fd = open(cachepath.c_str(), O_RDWR))           &&
+                (!is_shared || 0 == flock(physical_fd, LOCK_SH))                &&
+                0 != (inode = FdEntity::GetInode(physical_fd))                  &&
+                pagelist.Serialize(cfstat, false, inode, &cached_etag)          &&
+                FdEntity::IsCacheFileFresh(physical_fd, etag, cached_etag, time) )
             {
                 // succeed to open cache file and to load stats data
                 memset(&st, 0, sizeof(struct stat));
@@ -503,6 +591,12 @@ int FdEntity::Open(headers_t* pmeta, off_t size, time_t time, int flags, AutoLoc
                     close(physical_fd);
                 }
                 inode = 0;
+                pagelist.Init(0, false, false);
+
+                // the other processes may open the cache file, so make new file instead of truncating it.
+                if(is_shared && -1 == unlink(cachepath.c_str()) && ENOENT != errno){
+                    S3FS_PRN_WARN("failed to remove cache file(%s) by errno(%d), but continue...", cachepath.c_str(), errno);
+                }
 
                 // could not open cache file or could not load stats data, so initialize it.
                 if(-1 == (physical_fd = open(cachepath.c_str(), O_CREAT|O_RDWR|O_TRUNC, 0600))){
@@ -516,6 +610,9 @@ int FdEntity::Open(headers_t* pmeta, off_t size, time_t time, int flags, AutoLoc
                     }
                     return (0 == errno ? -EIO : -errno);
                 }
+                if(is_shared && -1 == flock(physical_fd, LOCK_SH)){
+                    S3FS_PRN_WARN("failed to lock cache file(%s) by errno(%d), but continue...", cachepath.c_str(), errno);
+                }
                 need_save_csf = true;       // need to update page info
                 inode         = FdEntity::GetInode(physical_fd);
                 if(-1 == size){
@@ -542,7 +639,10 @@ int FdEntity::Open(headers_t* pmeta, off_t size, time_t time, int flags, AutoLoc
                 S3FS_PRN_ERR("failed to open mirror file linked cache file(%s).", cachepath.c_str());
                 return (0 == mirrorfd ? -EIO : mirrorfd);
             }
-            // switch fd
+            // switch fd(the mirror file is locked before unlocking the cache file)
+            if(is_shared && -1 == flock(mirrorfd, LOCK_SH)){
+                S3FS_PRN_WARN("failed to lock mirror file(%s) by errno(%d), but continue...", cachepath.c_str(), errno);
+            }
             close(physical_fd);
             physical_fd = mirrorfd;
 
@@ -597,10 +697,11 @@ int FdEntity::Open(headers_t* pmeta, off_t size, time_t time, int flags, AutoLoc
             }
         }
 
+        cache_etag = etag;
+
         // reset cache stat file
         if(need_save_csf){
-            CacheFileStat cfstat(path.c_str());
-            if(!pagelist.Serialize(cfstat, true, inode)){
+            if(!SaveCacheFileStat()){
                 S3FS_PRN_WARN("failed to save cache stat file(%s), but continue...", path.c_str());
             }
         }
@@ -721,6 +822,54 @@ bool FdEntity::RenamePath(const std::string& newpath, std::string& fentmapkey)
     return true;
 }
 
+//
+// Prepare for renaming this entity only in local.
+//
+// [NOTE]
+// The area which is not modified is copied from the object of the path
+// by mix multipart uploading. After the path is renamed in local, the
+// object at the new path does not have the data, thus all area is set
+// the modified flag and the whole file is uploaded at the next flush.
+// This is possible only when all area has been loaded and it is not
+// being uploaded, otherwise this returns an error without changing this
+// entity.
+// If is_remove_old is true, the old object is removed after the whole
+// file is uploaded to the new path, so the data is not lost even if the
+// upload fails.
+//
+int FdEntity::PrepareLocalRename(const char* newpath, bool is_remove_old, const std::string& old_etag)
+{
+    S3FS_PRN_DBG("[path=%s][newpath=%s][physical_fd=%d]", path.c_str(), SAFESTRPTR(newpath), physical_fd);
+
+    AutoLock auto_lock(&fdent_lock);
+    AutoLock auto_data_lock(&fdent_data_lock);
+
+    if(-1 == physical_fd){
+        return -EBADF;
+    }
+    if(IsUploading(true)){
+        return -EBUSY;
+    }
+    if(0 < pagelist.GetTotalUnloadedPageSize()){
+        return -ENODATA;
+    }
+    if(!newpath){
+        return -EINVAL;
+    }
+    if(0 < pagelist.Size()){
+        pagelist.SetPageLoadedStatus(0, pagelist.Size(), PageList::PAGE_LOAD_MODIFIED);
+    }
+    orgmeta["Content-Type"] = S3fsCurl::LookupMimeType(std::string(newpath));
+    is_meta_pending         = true;
+
+    // the object at the new path is overwritten, so it must not be removed.
+    renamed_objects.erase(newpath);
+    if(is_remove_old){
+        renamed_objects[path] = old_etag;
+    }
+    return 0;
+}
+
 bool FdEntity::IsModified() const
 {
     AutoLock auto_data_lock(const_cast<pthread_mutex_t *>(&fdent_data_lock));
@@ -1007,7 +1156,14 @@ int FdEntity::Load(off_t start, off_t size, AutoLock::Type type, bool is_modifie
 
     int result = 0;
 
+    // fill the unloaded area from the memory cache
+    if(IsMemoryCacheUsable()){
+        LoadFromMemoryCache(start, size);
+    }
+
     // check loaded area & load
+    bool          is_shared = (FdManager::IsSharedCache() && !cachepath.empty() && !is_modified_flag);
+    bool          is_loaded = false;
     fdpage_list_t unloaded_list;
     if(0 < pagelist.GetUnloadedPages(unloaded_list, start, size)){
         for(fdpage_list_t::iterator iter = unloaded_list.begin(); iter != unloaded_list.end(); ++iter){
@@ -1022,30 +1178,154 @@ int FdEntity::Load(off_t start, off_t size, AutoLock::Type type, bool is_modifie
                 need_load_size = (iter->next() <= size_orgmeta ? iter->bytes : (size_orgmeta - iter->offset));
             }
 
+            // [NOTE]
+            // In the shared cache directory, the range is locked while downloading,
+            // and the pages loaded by the other processes are merged after getting
+            // the lock. If the range has been loaded, it is not downloaded.
+            //
+            bool is_range_locked = false;
+            if(is_shared && 0 < need_load_size && LockCacheFileRange(iter->offset, iter->bytes, true)){
+                is_range_locked = true;
+
+                CacheFileStat cfstat(path.c_str());
+                pagelist.MergeLoadedPages(cfstat, inode, cache_etag);
+                if(0 == pagelist.GetTotalUnloadedPageSize(iter->offset, iter->bytes)){
+                    LockCacheFileRange(iter->offset, iter->bytes, false);
+                    continue;
+                }
+            }
+
             // download
             if(S3fsCurl::GetMultipartSize() <= need_load_size && !nomultipart){
                 // parallel request
-                result = S3fsCurl::ParallelGetObjectRequest(path.c_str(), physical_fd, iter->offset, need_load_size);
+                result = S3fsCurl::ParallelGetObjectRequest(path.c_str(), physical_fd, iter->offset, need_load_size, cache_etag.c_str());
             }else{
                 // single request
                 if(0 < need_load_size){
                     S3fsCurl s3fscurl;
-                    result = s3fscurl.GetObjectRequest(path.c_str(), physical_fd, iter->offset, need_load_size);
+                    result = s3fscurl.GetObjectRequest(path.c_str(), physical_fd, iter->offset, need_load_size, cache_etag.c_str());
                 }else{
                     result = 0;
                 }
           }
           if(0 != result){
+              if(-ESTALE == result){
+                  S3FS_PRN_ERR("the object(%s) was changed after opening, so could not load it.", path.c_str());
+              }
+              if(is_range_locked){
+                  LockCacheFileRange(iter->offset, iter->bytes, false);
+              }
               break;
           }
           // Set loaded flag
           pagelist.SetPageLoadedStatus(iter->offset, iter->bytes, (is_modified_flag ? PageList::PAGE_LOAD_MODIFIED : PageList::PAGE_LOADED));
+          is_loaded = true;
+
+          // share the loaded pages with the other processes
+          if(is_range_locked){
+              if(!SaveCacheFileStat()){
+                  S3FS_PRN_WARN("failed to save cache stat file(%s), but continue...", path.c_str());
+              }
+              LockCacheFileRange(iter->offset, iter->bytes, false);
+          }
         }
         PageList::FreeList(unloaded_list);
     }
+    if(is_loaded && !cachepath.empty()){
+        FdManager::UpdateCacheFileSize(path.c_str(), physical_fd);
+    }
+    return result;
+}
+
+//
+// Add the unloaded ranges of the object to the list for downloading them
+// by S3fsCurl::ParallelGetObjectsRequest with the other objects.
+//
+bool FdEntity::GetUnloadedObjects(get_object_list_t& getlist)
+{
+    AutoLock auto_lock(&fdent_lock);
+
+    if(-1 == physical_fd){
+        return false;
+    }
+    AutoLock auto_data_lock(&fdent_data_lock);
+
+    fdpage_list_t unloaded_list;
+    if(0 < pagelist.GetUnloadedPages(unloaded_list, 0, 0)){
+        for(fdpage_list_t::iterator iter = unloaded_list.begin(); iter != unloaded_list.end(); ++iter){
+            if(size_orgmeta <= iter->offset){
+                break;
+            }
+            off_t need_load_size = (iter->next() <= size_orgmeta ? iter->bytes : (size_orgmeta - iter->offset));
+            getlist.push_back(get_object_info(path, physical_fd, iter->offset, need_load_size, cache_etag));
+        }
+        PageList::FreeList(unloaded_list);
+    }
+    return true;
+}
+
+//
+// Set the loaded flag for the ranges of the object which were downloaded
+// by S3fsCurl::ParallelGetObjectsRequest.
+//
+bool FdEntity::SetLoadedObjects(const get_object_list_t& getlist)
+{
+    AutoLock auto_lock(&fdent_lock);
+
+    if(-1 == physical_fd){
+        return false;
+    }
+    AutoLock auto_data_lock(&fdent_data_lock);
+
+    bool result = true;
+    for(get_object_list_t::const_iterator iter = getlist.begin(); iter != getlist.end(); ++iter){
+        if(iter->fd != physical_fd || iter->path != path){
+            continue;
+        }
+        if(0 != iter->result){
+            result = false;
+            continue;
+        }
+        pagelist.SetPageLoadedStatus(iter->start, iter->size, PageList::PAGE_LOADED);
+    }
     return result;
 }
 
+//
+// Truncate the file to the size without loading any area.
+// The extended area is set as modified, and the retained area which is
+// not loaded is copied by the copy api when the file is flushed by mix
+// multipart uploading.
+//
+int FdEntity::Truncate(off_t size)
+{
+    AutoLock auto_lock(&fdent_lock);
+
+    S3FS_PRN_DBG("[path=%s][physical_fd=%d][size=%lld]", path.c_str(), physical_fd, static_cast<long long int>(size));
+
+    if(-1 == physical_fd){
+        return -EBADF;
+    }
+    AutoLock auto_data_lock(&fdent_data_lock);
+
+    if(pagelist.Size() == size){
+        return 0;
+    }
+    if(-1 == ftruncate(physical_fd, size)){
+        S3FS_PRN_ERR("failed to truncate temporary file(physical_fd=%d) by errno(%d).", physical_fd, errno);
+        return -errno;
+    }
+    if(!pagelist.Resize(size, false, true)){      // Areas with increased size are modified
+        S3FS_PRN_ERR("failed to truncate temporary file information(physical_fd=%d).", physical_fd);
+        return -EIO;
+    }
+    // the area over the size is not loaded from the object
+    if(size < size_orgmeta){
+        size_orgmeta = size;
+    }
+    return 0;
+}
+
 // [NOTE]
 // At no disk space for caching object.
 // This method is downloading by dividing an object of the specified range
@@ -1158,7 +1438,7 @@ int FdEntity::NoCacheLoadAndPost(PseudoFdInfo* pseudo_obj, off_t start, off_t si
                 // single area get request
                 if(0 < need_load_size){
                     S3fsCurl s3fscurl;
-                    if(0 != (result = s3fscurl.GetObjectRequest(path.c_str(), tmpfd, offset, oneread))){
+                    if(0 != (result = s3fscurl.GetObjectRequest(path.c_str(), tmpfd, offset, oneread, cache_etag.c_str()))){
                         S3FS_PRN_ERR("failed to get object(start=%lld, size=%lld) for file(physical_fd=%d).", static_cast<long long int>(offset), static_cast<long long int>(oneread), tmpfd);
                         break;
                     }
@@ -1365,6 +1645,23 @@ int FdEntity::RowFlush(int fd, const char* tpath, bool force_sync)
         // Normal multipart upload
         result = RowFlushMultipart(pseudo_obj, tpath);
     }
+    if(0 == result && (!tpath || path == tpath)){
+        has_remote_object = true;
+
+        // remove the old objects after the new object has been uploaded
+        for(headers_t::iterator iter = renamed_objects.begin(); iter != renamed_objects.end(); ){
+            int result2;
+            if(0 != (result2 = delete_renamed_object(iter->first.c_str(), iter->second))){
+                S3FS_PRN_WARN("could not remove old object(%s) after renaming to %s: result=%d", iter->first.c_str(), path.c_str(), result2);
+                ++iter;
+            }else{
+                renamed_objects.erase(iter++);
+            }
+        }
+    }
+    // the object is changed, so the ETag in original headers is no longer correct.
+    orgmeta.erase("ETag");
+    cache_etag.erase();
 
     return result;
 }
@@ -1556,8 +1853,27 @@ int FdEntity::RowFlushMixMultipart(PseudoFdInfo* pseudo_obj, const char* tpath)
     if(!pseudo_obj->IsUploading()){
         // Start uploading
 
-        // If there is no loading all of the area, loading all area.
-        off_t restsize = pagelist.GetTotalUnloadedPageSize();
+        // [NOTE]
+        // The mix multipart uploading loads only the area which is needed
+        // to make each part 5MB or more, and the other area which is not
+        // modified is copied by the copy api.
+        // Otherwise, if there is no loading all of the area, loading all area.
+        //
+        fdpage_list_t dlpages;
+        fdpage_list_t mixuppages;
+        off_t         restsize = 0;
+        bool          is_mixupload = (pagelist.Size() >= S3fsCurl::GetMultipartSize() && pagelist.Size() <= MAX_MULTIPART_CNT * S3fsCurl::GetMultipartSize());
+        if(is_mixupload){
+            if(!pagelist.GetPageListsForMultipartUpload(dlpages, mixuppages, S3fsCurl::GetMultipartSize())){
+                S3FS_PRN_ERR("something error occurred during getting download pagelist.");
+                return -1;
+            }
+            for(fdpage_list_t::const_iterator iter = dlpages.begin(); iter != dlpages.end(); ++iter){
+                restsize += iter->bytes;
+            }
+        }else{
+            restsize = pagelist.GetTotalUnloadedPageSize();
+        }
 
         // Check rest size and free disk space
         if(0 < restsize && !ReserveDiskSpace(restsize)){
@@ -1590,17 +1906,11 @@ int FdEntity::RowFlushMixMultipart(PseudoFdInfo* pseudo_obj, const char* tpath)
                 S3FS_PRN_ERR("Part count exceeds %d.  Increase multipart size and try again.", MAX_MULTIPART_CNT);
                 return -EFBIG;
 
-            }else if(pagelist.Size() >= S3fsCurl::GetMultipartSize()){
+            }else if(is_mixupload){
                 // mix multipart uploading
 
                 // This is to ensure that each part is 5MB or more.
-                // If the part is less than 5MB, download it.
-                fdpage_list_t dlpages;
-                fdpage_list_t mixuppages;
-                if(!pagelist.GetPageListsForMultipartUpload(dlpages, mixuppages, S3fsCurl::GetMultipartSize())){
-                    S3FS_PRN_ERR("something error occurred during getting download pagelist.");
-                    return -1;
-                }
+                // If the part is less than 5MB, it is downloaded as dlpages.
 
                 // [TODO] should use parallel downloading
                 //
@@ -1675,22 +1985,107 @@ bool FdEntity::ReserveDiskSpace(off_t size)
         return true;
     }
 
+    // try to evict the least recently used cache files at first.
+    FdManager::get()->CleanupCacheDir(size);
+
+    if(FdManager::ReserveDiskSpace(size)){
+        return true;
+    }
+
     if(!pagelist.IsModified()){
+        // try to evict only the cold blocks of this file.
+        if(0 < EvictColdBlocks(FdManager::GetCacheBlockSize(), size, true) && FdManager::ReserveDiskSpace(size)){
+            return true;
+        }
+
         // try to clear all cache for this fd.
         pagelist.Init(pagelist.Size(), false, false);
         if(-1 == ftruncate(physical_fd, 0) || -1 == ftruncate(physical_fd, pagelist.Size())){
             S3FS_PRN_ERR("failed to truncate temporary file(physical_fd=%d).", physical_fd);
             return false;
         }
+    }
+    return FdManager::ReserveDiskSpace(size);
+}
 
-        if(FdManager::ReserveDiskSpace(size)){
-            return true;
+//
+// The memory cache is used only for the file which has the data of the
+// known object(ETag) and is not modified.
+//
+// [NOTE]
+// The caller must have fdent_data_lock.
+//
+bool FdEntity::IsMemoryCacheUsable() const
+{
+    return (FdManager::GetMemoryCache()->IsEnabled() && !cache_etag.empty() && !pagelist.IsModified());
+}
+
+//
+// Copy the blocks in memory cache to the unloaded area of the file.
+//
+// [NOTE]
+// The caller must have fdent_data_lock.
+//
+void FdEntity::LoadFromMemoryCache(off_t start, off_t size)
+{
+    fdpage_list_t unloaded_list;
+    if(0 == pagelist.GetUnloadedPages(unloaded_list, start, size)){
+        return;
+    }
+
+    MemoryBlockCache* memory_cache = FdManager::GetMemoryCache();
+    off_t             block_size   = MemoryBlockCache::GetBlockSize();
+    std::string       buf(static_cast<size_t>(block_size), '\0');
+    for(fdpage_list_t::const_iterator iter = unloaded_list.begin(); iter != unloaded_list.end(); ++iter){
+        for(off_t block_start = (iter->offset / block_size) * block_size; block_start < iter->next() && block_start < size_orgmeta; block_start += block_size){
+            off_t bytes = std::min(block_size, size_orgmeta - block_start);
+            if(!memory_cache->Read(path, cache_etag, block_start, static_cast<size_t>(bytes), &buf[0])){
+                continue;
+            }
+            // the loaded area in the block has same data
+            ssize_t written;
+            for(off_t total = 0; total < bytes; total += written){
+                if(-1 == (written = pwrite(physical_fd, &buf[total], static_cast<size_t>(bytes - total), block_start + total))){
+                    S3FS_PRN_ERR("pwrite failed. errno(%d)", errno);
+                    PageList::FreeList(unloaded_list);
+                    return;
+                }
+            }
+            pagelist.SetPageLoadedStatus(block_start, bytes, PageList::PAGE_LOADED);
         }
     }
+    PageList::FreeList(unloaded_list);
+}
 
-    FdManager::get()->CleanupCacheDir();
-
-    return FdManager::ReserveDiskSpace(size);
+//
+// Put the blocks which include the read area into memory cache.
+// The parts of the blocks which are out of the read area are read from
+// the file if they are loaded.
+//
+// [NOTE]
+// The caller must have fdent_data_lock.
+//
+void FdEntity::StoreMemoryCache(const char* bytes, off_t start, off_t size)
+{
+    MemoryBlockCache* memory_cache = FdManager::GetMemoryCache();
+    off_t             block_size   = MemoryBlockCache::GetBlockSize();
+    off_t             file_size    = pagelist.Size();
+    std::string       buf;
+    for(off_t block_start = (start / block_size) * block_size; block_start < start + size && block_start < file_size; block_start += block_size){
+        off_t block_bytes = std::min(block_size, file_size - block_start);
+        if(start <= block_start && block_start + block_bytes <= start + size){
+            memory_cache->Write(path, cache_etag, block_start, &bytes[block_start - start], static_cast<size_t>(block_bytes));
+            continue;
+        }
+        if(memory_cache->Has(path, cache_etag, block_start) || !pagelist.IsPageLoaded(block_start, block_bytes)){
+            continue;
+        }
+        buf.resize(static_cast<size_t>(block_bytes));
+        if(block_bytes != pread(physical_fd, &buf[0], static_cast<size_t>(block_bytes), block_start)){
+            continue;
+        }
+        memory_cache->Write(path, cache_etag, block_start, buf.c_str(), static_cast<size_t>(block_bytes));
+    }
 }
 
 ssize_t FdEntity::Read(int fd, char* bytes, off_t start, size_t size, bool force_load)
@@ -1711,6 +2106,15 @@ ssize_t FdEntity::Read(int fd, char* bytes, off_t start, size_t size, bool force
 
     ssize_t rsize;
 
+    // read from the memory cache without disk I/O
+    bool is_memory_cache = (!force_load && IsMemoryCacheUsable());
+    if(is_memory_cache && start < pagelist.Size()){
+        rsize = static_cast<ssize_t>(std::min(static_cast<off_t>(size), pagelist.Size() - start));
+        if(FdManager::GetMemoryCache()->Read(path, cache_etag, start, static_cast<size_t>(rsize), bytes)){
+            return rsize;
+        }
+    }
+
     // check disk space
     if(0 < pagelist.GetTotalUnloadedPageSize(start, size)){
         // load size(for prefetch)
@@ -1753,6 +2157,12 @@ ssize_t FdEntity::Read(int fd, char* bytes, off_t start, size_t size, bool force
         S3FS_PRN_ERR("pread failed. errno(%d)", errno);
         return -errno;
     }
+    if(!cachepath.empty()){
+        pagelist.SetBlockAccessTime(start, rsize, FdManager::GetCacheBlockSize(), time(NULL));
+    }
+    if(is_memory_cache && 0 < rsize){
+        StoreMemoryCache(bytes, start, rsize);
+    }
     return rsize;
 }
 
@@ -1768,11 +2178,16 @@ ssize_t FdEntity::Write(int fd, const char* bytes, off_t start, size_t size)
 
     // check if not enough disk space left BEFORE locking fd
     if(FdManager::IsCacheDir() && !FdManager::IsSafeDiskSpace(NULL, size)){
-        FdManager::get()->CleanupCacheDir();
+        FdManager::get()->CleanupCacheDir(static_cast<off_t>(size));
     }
     AutoLock auto_lock(&fdent_lock);
     AutoLock auto_lock2(&fdent_data_lock);
 
+    // the blocks in memory cache are not for the modified file
+    if(FdManager::GetMemoryCache()->IsEnabled()){
+        FdManager::GetMemoryCache()->Remove(path);
+    }
+
     // check file size
     if(pagelist.Size() < start){
         // grow file size
@@ -1795,6 +2210,10 @@ ssize_t FdEntity::Write(int fd, const char* bytes, off_t start, size_t size)
         // Normal multipart upload
         wsize = WriteMultipart(pseudo_obj, bytes, start, size);
     }
+    if(0 < wsize && !cachepath.empty()){
+        pagelist.SetBlockAccessTime(start, wsize, FdManager::GetCacheBlockSize(), time(NULL));
+        FdManager::UpdateCacheFileSize(path.c_str(), physical_fd);
+    }
 
     return wsize;
 }
@@ -2076,8 +2495,12 @@ bool FdEntity::MergeOrgMeta(headers_t& updatemeta)
     return is_meta_pending;
 }
 
-// global function in s3fs.cpp
-int put_headers(const char* path, headers_t& meta, bool is_copy, bool use_st_size = true);
+void FdEntity::GetOrgMeta(headers_t& meta)
+{
+    AutoLock auto_lock(&fdent_lock);
+    meta = orgmeta;
+}
+
 
 int FdEntity::UploadPendingMeta()
 {
@@ -2090,7 +2513,10 @@ int FdEntity::UploadPendingMeta()
     headers_t updatemeta = orgmeta;
     updatemeta["x-amz-copy-source"]        = urlEncode(service_path + bucket + get_realpath(path.c_str()));
     // put headers, no need to update mtime to avoid dead lock
-    int result = put_headers(path.c_str(), updatemeta, true);
+    // [NOTE]
+    // This entity is locked, and its ETag is cleared after flushing, so
+    // the cached ETag is not updated here.
+    int result = put_headers(path.c_str(), updatemeta, true, true, false);
     if(0 != result){
         S3FS_PRN_ERR("failed to put header after flushing file(%s) by(%d).", path.c_str(), result);
     }
@@ -2170,6 +2596,293 @@ bool FdEntity::PunchHole(off_t start, size_t size)
     return true;
 }
 
+//
+// Evict the cold blocks of the opened cache file, until need bytes are
+// freed. This punches holes in the least recently used blocks, and marks
+// them not loaded, then they are loaded from the object again when reading.
+// Returns the freed bytes.
+//
+// [NOTE]
+// The blocks are evicted only when the file is not modified and the ETag
+// of the object is known, so that the reloaded data is checked by If-Match.
+// In the shared cache directory, the other processes may read the blocks,
+// so this does nothing.
+// If the entity is locked by the other thread, this does nothing too,
+// because this is called under disk pressure from the other entities.
+//
+off_t FdEntity::EvictColdBlocks(off_t block_size, off_t need, bool lock_already_held)
+{
+    S3FS_PRN_DBG("[path=%s][physical_fd=%d][block_size=%lld][need=%lld]", path.c_str(), physical_fd, static_cast<long long int>(block_size), static_cast<long long int>(need));
+
+    AutoLock auto_lock(&fdent_lock, lock_already_held ? AutoLock::ALREADY_LOCKED : AutoLock::NO_WAIT);
+    if(!lock_already_held && !auto_lock.isLockAcquired()){
+        return 0;
+    }
+    AutoLock auto_data_lock(&fdent_data_lock, lock_already_held ? AutoLock::ALREADY_LOCKED : AutoLock::NO_WAIT);
+    if(!lock_already_held && !auto_data_lock.isLockAcquired()){
+        return 0;
+    }
+
+    if(-1 == physical_fd || cachepath.empty() || cache_etag.empty() || pagelist.IsModified() || FdManager::IsSharedCache() || 0 >= block_size || pagelist.Size() <= block_size){
+        return 0;
+    }
+
+    std::list<off_t> blocks;
+    pagelist.GetColdBlocks(block_size, blocks);
+
+    off_t freed = 0;
+    for(std::list<off_t>::const_iterator iter = blocks.begin(); iter != blocks.end() && freed < need; ++iter){
+        off_t length = std::min(block_size, pagelist.Size() - *iter);
+        if(0 != fallocate(physical_fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, *iter, length)){
+            S3FS_PRN_WARN("failed to punch hole to cache file(%s) with errno(%d).", path.c_str(), errno);
+            break;
+        }
+        off_t unloaded = 0;
+        pagelist.UnloadBlock(*iter, block_size, unloaded);
+        freed += unloaded;
+    }
+
+    // the cache stat file must not have the evicted blocks as loaded
+    if(0 < freed){
+        if(!SaveCacheFileStat()){
+            S3FS_PRN_WARN("failed to save cache stat file(%s) after evicting blocks.", path.c_str());
+        }
+        FdManager::UpdateCacheFileSize(path.c_str(), physical_fd);
+        S3FS_PRN_INFO3("evicted blocks(%lld bytes) of opened cache file(%s).", static_cast<long long int>(freed), path.c_str());
+    }
+    return freed;
+}
+
+//
+// Make the key of the object content from ETag and size in headers.
+// Returns empty if there is no ETag.
+//
+std::string FdEntity::MakeContentKey(const headers_t& meta)
+{
+    std::string etag = get_etag(meta);
+    if(etag.empty()){
+        return etag;
+    }
+    return etag + ":" + str(get_size(meta));
+}
+
+//
+// Get the content key of the cache file, only if the cache file has all
+// data of the object and it is not modified.
+//
+bool FdEntity::GetCacheContentKey(std::string& key)
+{
+    AutoLock auto_lock(&fdent_lock);
+    AutoLock auto_data_lock(&fdent_data_lock);
+
+    key.erase();
+    if(cachepath.empty() || !has_remote_object || is_meta_pending){
+        return false;
+    }
+    if(pagelist.IsModified() || pagelist.Size() != get_size(orgmeta) || 0 != pagelist.GetTotalUnloadedPageSize(0, pagelist.Size())){
+        return false;
+    }
+    key = FdEntity::MakeContentKey(orgmeta);
+
+    return !key.empty();
+}
+
+//
+// Make the content key from the pages and ETag of the cache file, only if
+// the cache file has all data of the object and it is not modified.
+//
+static std::string make_cache_file_content_key(const PageList& pagelist, const std::string& etag)
+{
+    if(etag.empty() || pagelist.IsModified() || 0 != pagelist.GetTotalUnloadedPageSize(0, pagelist.Size())){
+        return std::string("");
+    }
+    headers_t meta;
+    meta["ETag"]           = etag;
+    meta["Content-Length"] = str(pagelist.Size());
+    return FdEntity::MakeContentKey(meta);
+}
+
+//
+// Get the content key of the cache file from its stat file, which is used
+// for reusing the cache file after the cache directory is indexed.
+//
+bool FdEntity::GetCacheFileContentKey(const char* path, const char* cache_path, std::string& content)
+{
+    CacheFileStat cfstat;
+    return FdEntity::GetCacheFileContentKey(path, cache_path, cfstat, content);
+}
+
+//
+// Same as above, but cfstat keeps the stat file locked after returning,
+// so that the other processes can not evict blocks of the cache file
+// until the caller releases it.
+//
+bool FdEntity::GetCacheFileContentKey(const char* path, const char* cache_path, CacheFileStat& cfstat, std::string& content)
+{
+    content.erase();
+    if(!path || !cache_path){
+        return false;
+    }
+
+    int fd;
+    if(-1 == (fd = open(cache_path, O_RDONLY))){
+        return false;
+    }
+    ino_t inode = FdEntity::GetInode(fd);
+    close(fd);
+
+    PageList    pagelist;
+    std::string etag;
+    if(0 == inode || !cfstat.SetPath(path, false) || !cfstat.ReadOnlyOpen() || !pagelist.Serialize(cfstat.GetFd(), false, inode, &etag)){
+        return false;
+    }
+    content = make_cache_file_content_key(pagelist, etag);
+
+    return !content.empty();
+}
+
+//
+// Update the ETag of the cached data, after the object is copied without
+// changing its data(ex. updating meta by copy api). The copy may change
+// the ETag(ex. multipart copy), then the cached data must not be treated
+// as stale. This does nothing if the cached data is not of old_etag.
+//
+bool FdEntity::UpdateCacheETag(const std::string& old_etag, const std::string& new_etag)
+{
+    S3FS_PRN_DBG("[path=%s][old_etag=%s][new_etag=%s]", path.c_str(), old_etag.c_str(), new_etag.c_str());
+
+    AutoLock auto_lock(&fdent_lock);
+    AutoLock auto_data_lock(&fdent_data_lock);
+
+    if(old_etag.empty() || new_etag.empty()){
+        return false;
+    }
+    if(get_etag(orgmeta) == old_etag){
+        orgmeta["ETag"] = new_etag;
+    }
+    if(cache_etag != old_etag){
+        return false;
+    }
+    cache_etag = new_etag;
+
+    if(!cachepath.empty() && !SaveCacheFileStat()){
+        S3FS_PRN_WARN("failed to save cache stat file(%s) with new ETag, but continue...", path.c_str());
+    }
+    return true;
+}
+
+//
+// Evict the cold blocks of the cache file which is not opened, until need
+// bytes are freed. This punches holes in the blocks and marks them not
+// loaded in the cache stat file. Returns the freed bytes, or -1 if the
+// blocks could not be evicted, then the caller should delete the cache
+// file. is_empty is set true when no loaded area is left.
+//
+off_t FdEntity::EvictCacheBlocks(const char* path, const char* cache_path, off_t block_size, off_t need, bool& is_empty)
+{
+    S3FS_PRN_DBG("[path=%s][cache_path=%s][block_size=%lld][need=%lld]", SAFESTRPTR(path), SAFESTRPTR(cache_path), static_cast<long long int>(block_size), static_cast<long long int>(need));
+
+    is_empty = false;
+    if(!path || !cache_path || 0 >= block_size){
+        return -1;
+    }
+
+    int fd;
+    if(-1 == (fd = open(cache_path, O_RDWR))){
+        S3FS_PRN_ERR("failed to open cache file(%s) by errno(%d).", cache_path, errno);
+        return -1;
+    }
+    ino_t         inode = FdEntity::GetInode(fd);
+    CacheFileStat cfstat(path);
+    PageList      pagelist;
+    std::string   cached_etag;
+    if(0 == inode || !pagelist.Serialize(cfstat, false, inode, &cached_etag)){
+        S3FS_PRN_WARN("failed to load cache stat file(%s).", path);
+        close(fd);
+        return -1;
+    }
+
+    std::list<off_t> blocks;
+    pagelist.GetColdBlocks(block_size, blocks);
+
+    off_t freed = 0;
+    for(std::list<off_t>::const_iterator iter = blocks.begin(); iter != blocks.end() && freed < need; ++iter){
+        off_t length = std::min(block_size, pagelist.Size() - *iter);
+        if(0 != fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, *iter, length)){
+            S3FS_PRN_WARN("failed to punch hole to cache file(%s) with errno(%d).", cache_path, errno);
+            if(0 == freed){
+                close(fd);
+                return -1;
+            }
+            break;
+        }
+        off_t unloaded = 0;
+        pagelist.UnloadBlock(*iter, block_size, unloaded);
+        freed += unloaded;
+    }
+    is_empty = (!pagelist.IsModified() && pagelist.GetTotalUnloadedPageSize(0, pagelist.Size()) == pagelist.Size());
+
+    if(0 < freed && !pagelist.Serialize(cfstat, true, inode, &cached_etag)){
+        S3FS_PRN_ERR("failed to save cache stat file(%s) after evicting blocks.", path);
+        close(fd);
+        return -1;
+    }
+    close(fd);
+
+    S3FS_PRN_INFO3("evicted blocks(%lld bytes) of cache file(%s).", static_cast<long long int>(freed), path);
+    return freed;
+}
+
+//
+// Update the ETag in the cache stat file of the cache file which is not
+// opened, after the object is copied without changing its data. If the
+// cache file has all data of the object, the content key for new ETag is
+// set to content. Returns false if the ETag is not updated.
+//
+bool FdEntity::UpdateCacheFileETag(const char* path, const char* cache_path, const std::string& old_etag, const std::string& new_etag, std::string& content)
+{
+    S3FS_PRN_DBG("[path=%s][cache_path=%s][old_etag=%s][new_etag=%s]", SAFESTRPTR(path), SAFESTRPTR(cache_path), old_etag.c_str(), new_etag.c_str());
+
+    content.erase();
+    if(!path || !cache_path || old_etag.empty() || new_etag.empty()){
+        return false;
+    }
+
+    int fd;
+    if(-1 == (fd = open(cache_path, O_RDONLY))){
+        if(ENOENT != errno){
+            S3FS_PRN_ERR("failed to open cache file(%s) by errno(%d).", cache_path, errno);
+        }
+        return false;
+    }
+    ino_t         inode = FdEntity::GetInode(fd);
+    CacheFileStat cfstat(path);
+    PageList      pagelist;
+    std::string   cached_etag;
+    if(0 == inode || !pagelist.Serialize(cfstat, false, inode, &cached_etag)){
+        S3FS_PRN_WARN("failed to load cache stat file(%s).", path);
+        close(fd);
+        return false;
+    }
+    if(cached_etag != old_etag){
+        close(fd);
+        return false;
+    }
+
+    std::string etag = new_etag;
+    if(!pagelist.Serialize(cfstat, true, inode, &etag)){
+        S3FS_PRN_ERR("failed to save cache stat file(%s) with new ETag.", path);
+        close(fd);
+        return false;
+    }
+    close(fd);
+
+    content = make_cache_file_content_key(pagelist, new_etag);
+
+    S3FS_PRN_INFO3("updated ETag of cache file(%s) to %s.", path, new_etag.c_str());
+    return true;
+}
+
 /*
 * Local variables:
 * tab-width: 4
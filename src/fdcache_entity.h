@@ -22,6 +22,7 @@
 #define S3FS_FDCACHE_ENTITY_H_
 
 #include "autolock.h"
+#include "curl.h"
 #include "fdcache_page.h"
 #include "fdcache_fdinfo.h"
 #include "metaheader.h"
@@ -49,14 +50,24 @@ class FdEntity
         std::string     cachepath;      // local cache file path
                                         // (if this is empty, does not load/save pagelist.)
         std::string     mirrorpath;     // mirror file path to local cache file path
+        std::string     cache_etag;     // ETag of the object which the data in cache file is for
+                                        // (if this is empty, the object is unknown.)
         bool            is_meta_pending;
+        bool            has_remote_object;  // whether the object of path exists on the server
+        headers_t       renamed_objects;    // old objects(path and ETag) which are removed after uploading, by renaming in local
         struct timespec holding_mtime;  // if mtime is updated while the file is open, it is set time_t value
 
     private:
         static int FillFile(int fd, unsigned char byte, off_t size, off_t start);
         static ino_t GetInode(int fd);
+        static bool IsCacheFileFresh(int fd, const std::string& etag, const std::string& cached_etag, time_t time);
 
         void Clear();
+        bool SaveCacheFileStat();
+        bool LockCacheFileRange(off_t start, off_t size, bool is_lock);
+        bool IsMemoryCacheUsable() const;
+        void LoadFromMemoryCache(off_t start, off_t size);
+        void StoreMemoryCache(const char* bytes, off_t start, off_t size);
         ino_t GetInode();
         int OpenMirrorFile();
         int NoCacheLoadAndPost(PseudoFdInfo* pseudo_obj, off_t start = 0, off_t size = 0);  // size=0 means loading to end
@@ -78,6 +89,11 @@ class FdEntity
     public:
         static bool GetNoMixMultipart() { return mixmultipart; }
         static bool SetNoMixMultipart();
+        static std::string MakeContentKey(const headers_t& meta);
+        static off_t EvictCacheBlocks(const char* path, const char* cache_path, off_t block_size, off_t need, bool& is_empty);
+        static bool GetCacheFileContentKey(const char* path, const char* cache_path, std::string& content);
+        static bool GetCacheFileContentKey(const char* path, const char* cache_path, CacheFileStat& cfstat, std::string& content);
+        static bool UpdateCacheFileETag(const char* path, const char* cache_path, const std::string& old_etag, const std::string& new_etag, std::string& content);
 
         explicit FdEntity(const char* tpath = NULL, const char* cpath = NULL);
         ~FdEntity();
@@ -92,9 +108,13 @@ class FdEntity
         int GetOpenCount(bool lock_already_held = false);
         const char* GetPath() const { return path.c_str(); }
         bool RenamePath(const std::string& newpath, std::string& fentmapkey);
+        int PrepareLocalRename(const char* newpath, bool is_remove_old, const std::string& old_etag);
+        bool HasRemoteObject() const { return has_remote_object; }
+        void SetRemoteObject(bool is_exist) { has_remote_object = is_exist; }
         int GetPhysicalFd() const { return physical_fd; }
         bool IsModified() const;
         bool MergeOrgMeta(headers_t& updatemeta);
+        void GetOrgMeta(headers_t& meta);
 
         bool GetStats(struct stat& st, bool lock_already_held = false);
         int SetCtime(struct timespec time, bool lock_already_held = false);
@@ -115,6 +135,9 @@ class FdEntity
         bool SetContentType(const char* path);
 
         int Load(off_t start, off_t size, AutoLock::Type type, bool is_modified_flag = false);  // size=0 means loading to end
+        bool GetUnloadedObjects(get_object_list_t& getlist);
+        bool SetLoadedObjects(const get_object_list_t& getlist);
+        int Truncate(off_t size);
 
         off_t BytesModified();
         int RowFlush(int fd, const char* tpath, bool force_sync = false);
@@ -125,11 +148,15 @@ class FdEntity
 
         bool ReserveDiskSpace(off_t size);
         bool PunchHole(off_t start = 0, size_t size = 0);
+        off_t EvictColdBlocks(off_t block_size, off_t need, bool lock_already_held = false);
+        bool GetCacheContentKey(std::string& key);
+        bool UpdateCacheETag(const std::string& old_etag, const std::string& new_etag);
 
         // Indicate that a new file's is dirty.  This ensures that both metadata and data are synced during flush.
         void MarkDirtyNewFile() {
             pagelist.SetPageLoadedStatus(0, 1, PageList::PAGE_LOAD_MODIFIED);
-            is_meta_pending = true;
+            is_meta_pending   = true;
+            has_remote_object = false;
         }
 };
 
@@ -0,0 +1,367 @@
+/*
+ * s3fs - FUSE-based file system backed by Amazon S3
+ *
+ * Copyright(C) 2007 Takeshi Nakatani <ggtakec.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+
+#include "common.h"
+#include "s3fs.h"
+#include "fdcache_index.h"
+#include "autolock.h"
+
+//------------------------------------------------
+// CacheFileIndex methods
+//------------------------------------------------
+CacheFileIndex::CacheFileIndex() : is_lock_init(false), total_size(0)
+{
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+#if S3FS_PTHREAD_ERRORCHECK
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_ERRORCHECK);
+#endif
+    int result;
+    if(0 != (result = pthread_mutex_init(&index_lock, &attr))){
+        S3FS_PRN_CRIT("failed to init index_lock: %d", result);
+        abort();
+    }
+    is_lock_init = true;
+}
+
+CacheFileIndex::~CacheFileIndex()
+{
+    if(is_lock_init){
+        int result;
+        if(0 != (result = pthread_mutex_destroy(&index_lock))){
+            S3FS_PRN_CRIT("failed to destroy index_lock: %d", result);
+            abort();
+        }
+        is_lock_init = false;
+    }
+}
+
+void CacheFileIndex::RawRemoveContent(const std::string& path, const std::string& content)
+{
+    if(content.empty()){
+        return;
+    }
+    std::pair<cache_content_map_t::iterator, cache_content_map_t::iterator> range = contents.equal_range(content);
+    for(cache_content_map_t::iterator iter = range.first; iter != range.second; ++iter){
+        if(iter->second == path){
+            contents.erase(iter);
+            break;
+        }
+    }
+}
+
+void CacheFileIndex::RawRemove(cache_index_map_t::iterator& iter)
+{
+    RawRemoveContent(iter->first, iter->second.content);
+    lru_order.erase(std::make_pair(iter->second.atime, iter->first));
+    total_size -= iter->second.size;
+    entries.erase(iter++);
+}
+
+void CacheFileIndex::Clear()
+{
+    AutoLock auto_lock(&index_lock);
+
+    entries.clear();
+    lru_order.clear();
+    contents.clear();
+    total_size = 0;
+}
+
+//
+// Add the cache file, or update its size and last access time.
+// The content key of the cache file is cleared.
+//
+void CacheFileIndex::Set(const std::string& path, off_t size, time_t atime, time_t mtime)
+{
+    AutoLock auto_lock(&index_lock);
+
+    cache_index_map_t::iterator iter = entries.find(path);
+    if(entries.end() != iter){
+        RawRemoveContent(path, iter->second.content);
+        lru_order.erase(std::make_pair(iter->second.atime, path));
+        total_size -= iter->second.size;
+    }
+    entries[path] = cache_index_entry(size, atime, mtime);
+    lru_order.insert(std::make_pair(atime, path));
+    total_size += size;
+}
+
+bool CacheFileIndex::Touch(const std::string& path, time_t atime)
+{
+    AutoLock auto_lock(&index_lock);
+
+    cache_index_map_t::iterator iter = entries.find(path);
+    if(entries.end() == iter){
+        return false;
+    }
+    if(iter->second.atime != atime){
+        lru_order.erase(std::make_pair(iter->second.atime, path));
+        iter->second.atime = atime;
+        lru_order.insert(std::make_pair(atime, path));
+    }
+    return true;
+}
+
+bool CacheFileIndex::SetSize(const std::string& path, off_t size)
+{
+    AutoLock auto_lock(&index_lock);
+
+    cache_index_map_t::iterator iter = entries.find(path);
+    if(entries.end() == iter){
+        return false;
+    }
+    total_size        += size - iter->second.size;
+    iter->second.size  = size;
+    return true;
+}
+
+bool CacheFileIndex::Remove(const std::string& path)
+{
+    AutoLock auto_lock(&index_lock);
+
+    cache_index_map_t::iterator iter = entries.find(path);
+    if(entries.end() == iter){
+        return false;
+    }
+    RawRemove(iter);
+    return true;
+}
+
+//
+// Remove all cache files under the directory, and returns the count.
+//
+size_t CacheFileIndex::RemoveTree(const std::string& dir)
+{
+    std::string prefix = dir;
+    if(prefix.empty() || '/' != *prefix.rbegin()){
+        prefix += "/";
+    }
+
+    AutoLock auto_lock(&index_lock);
+
+    size_t count = 0;
+    for(cache_index_map_t::iterator iter = entries.lower_bound(prefix); iter != entries.end() && 0 == iter->first.compare(0, prefix.length(), prefix); ++count){
+        RawRemove(iter);
+    }
+    return count;
+}
+
+bool CacheFileIndex::Rename(const std::string& from, const std::string& to)
+{
+    AutoLock auto_lock(&index_lock);
+
+    cache_index_map_t::iterator iter = entries.find(from);
+    if(entries.end() == iter){
+        return false;
+    }
+    cache_index_entry entry = iter->second;
+    RawRemove(iter);
+
+    if(entries.end() != (iter = entries.find(to))){
+        RawRemove(iter);
+    }
+    entries[to] = entry;
+    lru_order.insert(std::make_pair(entry.atime, to));
+    if(!entry.content.empty()){
+        contents.insert(std::make_pair(entry.content, to));
+    }
+    total_size += entry.size;
+
+    return true;
+}
+
+//
+// Set the content key(ETag and size) of the cache file which has all data
+// of the object. Empty content clears it.
+//
+bool CacheFileIndex::SetContent(const std::string& path, const std::string& content)
+{
+    AutoLock auto_lock(&index_lock);
+
+    cache_index_map_t::iterator iter = entries.find(path);
+    if(entries.end() == iter){
+        return false;
+    }
+    if(iter->second.content == content){
+        return true;
+    }
+    RawRemoveContent(path, iter->second.content);
+    iter->second.content = content;
+    if(!content.empty()){
+        contents.insert(std::make_pair(content, path));
+    }
+    return true;
+}
+
+bool CacheFileIndex::FindContent(const std::string& content, std::string& path)
+{
+    AutoLock auto_lock(&index_lock);
+
+    cache_content_map_t::const_iterator iter = contents.find(content);
+    if(contents.end() == iter){
+        return false;
+    }
+    path = iter->second;
+    return true;
+}
+
+//
+// Get the least recently used cache file which is not in excludes.
+//
+bool CacheFileIndex::GetLeastRecentlyUsed(std::string& path, off_t& size, const std::set<std::string>* excludes)
+{
+    AutoLock auto_lock(&index_lock);
+
+    for(cache_lru_set_t::const_iterator iter = lru_order.begin(); iter != lru_order.end(); ++iter){
+        if(excludes && excludes->end() != excludes->find(iter->second)){
+            continue;
+        }
+        path = iter->second;
+        size = entries[path].size;
+        return true;
+    }
+    return false;
+}
+
+//
+// Merge the cache files directly under the directory, which are scanned
+// from the cache directory. files has the names of cache files as keys.
+// The cache files which are not in files and the cache files under the
+// subdirectories which are not in subdirs are removed. The cache files
+// in the index keep their last access time, and their size and mtime are
+// updated. If the size or mtime is changed(ex. the other process punched
+// holes in it), the content key is cleared because the cache file may not
+// have all data of the object. The new cache files are added with the
+// content key in files. Returns the count of changed cache files.
+//
+size_t CacheFileIndex::MergeDirectory(const std::string& dir, const cache_index_map_t& files, const std::set<std::string>& subdirs)
+{
+    std::string prefix = dir;
+    if(prefix.empty() || '/' != *prefix.rbegin()){
+        prefix += "/";
+    }
+
+    AutoLock auto_lock(&index_lock);
+
+    size_t count = 0;
+    for(cache_index_map_t::iterator iter = entries.lower_bound(prefix); iter != entries.end() && 0 == iter->first.compare(0, prefix.length(), prefix); ){
+        std::string            name = iter->first.substr(prefix.length());
+        std::string::size_type pos  = name.find('/');
+        if(std::string::npos != pos){
+            // under the subdirectory
+            std::string subdir = name.substr(0, pos);
+            if(subdirs.end() == subdirs.find(subdir)){
+                RawRemove(iter);
+                ++count;
+            }else{
+                // skip the existing subdirectory("<subdir>0" is next to all "<subdir>/...")
+                iter = entries.lower_bound(prefix + subdir + "0");
+            }
+            continue;
+        }
+
+        cache_index_map_t::const_iterator fiter = files.find(name);
+        if(files.end() == fiter){
+            RawRemove(iter);
+            ++count;
+            continue;
+        }
+        if(iter->second.size != fiter->second.size || iter->second.mtime != fiter->second.mtime){
+            RawRemoveContent(iter->first, iter->second.content);
+            iter->second.content.erase();
+            total_size         += fiter->second.size - iter->second.size;
+            iter->second.size   = fiter->second.size;
+            iter->second.mtime  = fiter->second.mtime;
+            ++count;
+        }
+        ++iter;
+    }
+
+    for(cache_index_map_t::const_iterator fiter = files.begin(); fiter != files.end(); ++fiter){
+        std::string path = prefix + fiter->first;
+        if(entries.end() != entries.find(path)){
+            continue;
+        }
+        entries[path] = fiter->second;
+        lru_order.insert(std::make_pair(fiter->second.atime, path));
+        if(!fiter->second.content.empty()){
+            contents.insert(std::make_pair(fiter->second.content, path));
+        }
+        total_size += fiter->second.size;
+        ++count;
+    }
+    return count;
+}
+
+//
+// Lock the cache file exclusively, only if the other processes do not open
+// it. Returns the locked file descriptor, and the caller must close it.
+// If the cache file does not exist, it is removed from the index.
+//
+// [NOTE]
+// In the shared cache directory, the processes have the shared lock of
+// the cache file while it is opened, so that it is not evicted.
+//
+int CacheFileIndex::LockUnusedFile(const std::string& path, const char* cache_path)
+{
+    int fd;
+    if(!cache_path || -1 == (fd = open(cache_path, O_RDONLY))){
+        if(cache_path && ENOENT == errno){
+            Remove(path);
+        }
+        return -1;
+    }
+    if(-1 == flock(fd, LOCK_EX | LOCK_NB)){
+        S3FS_PRN_DBG("cache file(%s) is used by the other process.", path.c_str());
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+size_t CacheFileIndex::Count()
+{
+    AutoLock auto_lock(&index_lock);
+    return entries.size();
+}
+
+off_t CacheFileIndex::TotalSize()
+{
+    AutoLock auto_lock(&index_lock);
+    return total_size;
+}
+
+/*
+* Local variables:
+* tab-width: 4
+* c-basic-offset: 4
+* End:
+* vim600: expandtab sw=4 ts=4 fdm=marker
+* vim<600: expandtab sw=4 ts=4
+*/
@@ -0,0 +1,98 @@
+/*
+ * s3fs - FUSE-based file system backed by Amazon S3
+ *
+ * Copyright(C) 2007 Randy Rizun <rrizun@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#ifndef S3FS_FDCACHE_INDEX_H_
+#define S3FS_FDCACHE_INDEX_H_
+
+#include <map>
+#include <set>
+#include <string>
+
+//------------------------------------------------
+// Typedefs
+//------------------------------------------------
+// Size and last access time of one cache file
+//
+struct cache_index_entry
+{
+    off_t       size;       // disk usage of cache file
+    time_t      atime;      // last access time
+    time_t      mtime;      // last modification time of cache file
+    std::string content;    // content key(ETag and size) if the cache file has all data of the object
+
+    cache_index_entry(off_t fsize = 0, time_t ftime = 0, time_t fmtime = 0) : size(fsize), atime(ftime), mtime(fmtime) {}
+};
+
+typedef std::map<std::string, cache_index_entry>     cache_index_map_t;     // key is the object path
+typedef std::set<std::pair<time_t, std::string> >    cache_lru_set_t;       // ordered by last access time
+typedef std::multimap<std::string, std::string>      cache_content_map_t;   // content key to the object path
+
+//------------------------------------------------
+// Class CacheFileIndex
+//------------------------------------------------
+// In-memory index of the cache files under the cache directory.
+// This is used for evicting the least recently used cache files
+// without scanning the cache directory.
+//
+class CacheFileIndex
+{
+    private:
+        bool               is_lock_init;
+        pthread_mutex_t    index_lock;      // protects the following members
+        cache_index_map_t  entries;
+        cache_lru_set_t    lru_order;
+        cache_content_map_t contents;
+        off_t              total_size;
+
+    private:
+        void RawRemove(cache_index_map_t::iterator& iter);
+        void RawRemoveContent(const std::string& path, const std::string& content);
+
+    public:
+        CacheFileIndex();
+        ~CacheFileIndex();
+
+        void Clear();
+        void Set(const std::string& path, off_t size, time_t atime, time_t mtime = 0);
+        bool Touch(const std::string& path, time_t atime);
+        bool SetSize(const std::string& path, off_t size);
+        bool Remove(const std::string& path);
+        size_t RemoveTree(const std::string& dir);
+        bool Rename(const std::string& from, const std::string& to);
+        bool SetContent(const std::string& path, const std::string& content);
+        bool FindContent(const std::string& content, std::string& path);
+        bool GetLeastRecentlyUsed(std::string& path, off_t& size, const std::set<std::string>* excludes = NULL);
+        size_t MergeDirectory(const std::string& dir, const cache_index_map_t& files, const std::set<std::string>& subdirs);
+        int LockUnusedFile(const std::string& path, const char* cache_path);
+        size_t Count();
+        off_t TotalSize();
+};
+
+#endif // S3FS_FDCACHE_INDEX_H_
+
+/*
+* Local variables:
+* tab-width: 4
+* c-basic-offset: 4
+* End:
+* vim600: expandtab sw=4 ts=4 fdm=marker
+* vim<600: expandtab sw=4 ts=4
+*/
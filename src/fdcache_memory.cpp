@@ -0,0 +1,265 @@
+/*
+ * s3fs - FUSE-based file system backed by Amazon S3
+ *
+ * Copyright(C) 2007 Takeshi Nakatani <ggtakec.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+#include "common.h"
+#include "s3fs.h"
+#include "fdcache_memory.h"
+#include "autolock.h"
+
+//------------------------------------------------
+// Symbols
+//------------------------------------------------
+static const off_t MEMORY_CACHE_BLOCK_SIZE = 128 * 1024;
+
+//------------------------------------------------
+// MemoryBlockCache class methods
+//------------------------------------------------
+off_t MemoryBlockCache::GetBlockSize()
+{
+    return MEMORY_CACHE_BLOCK_SIZE;
+}
+
+//------------------------------------------------
+// MemoryBlockCache methods
+//------------------------------------------------
+MemoryBlockCache::MemoryBlockCache() : is_lock_init(false), max_size(0), total_size(0)
+{
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+#if S3FS_PTHREAD_ERRORCHECK
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_ERRORCHECK);
+#endif
+    int result;
+    if(0 != (result = pthread_mutex_init(&cache_lock, &attr))){
+        S3FS_PRN_CRIT("failed to init cache_lock: %d", result);
+        abort();
+    }
+    is_lock_init = true;
+}
+
+MemoryBlockCache::~MemoryBlockCache()
+{
+    if(is_lock_init){
+        int result;
+        if(0 != (result = pthread_mutex_destroy(&cache_lock))){
+            S3FS_PRN_CRIT("failed to destroy cache_lock: %d", result);
+            abort();
+        }
+        is_lock_init = false;
+    }
+}
+
+void MemoryBlockCache::RawRemoveFile(mem_cache_map_t::iterator& iter)
+{
+    for(mem_block_map_t::iterator biter = iter->second.blocks.begin(); biter != iter->second.blocks.end(); ++biter){
+        lru_order.erase(biter->second.lru_pos);
+        total_size -= static_cast<off_t>(biter->second.data.size());
+    }
+    files.erase(iter++);
+}
+
+//
+// Evict the least recently used blocks until size bytes can be added.
+//
+void MemoryBlockCache::RawEvict(off_t size)
+{
+    while(!lru_order.empty() && max_size < total_size + size){
+        mem_cache_map_t::iterator iter = files.find(lru_order.front().first);
+        if(files.end() == iter){
+            lru_order.pop_front();
+            continue;
+        }
+        mem_block_map_t::iterator biter = iter->second.blocks.find(lru_order.front().second);
+        lru_order.pop_front();
+        if(iter->second.blocks.end() != biter){
+            total_size -= static_cast<off_t>(biter->second.data.size());
+            iter->second.blocks.erase(biter);
+        }
+        if(iter->second.blocks.empty()){
+            files.erase(iter);
+        }
+    }
+}
+
+off_t MemoryBlockCache::SetMaxSize(off_t size)
+{
+    AutoLock auto_lock(&cache_lock);
+
+    off_t old = max_size;
+    max_size  = size;
+    RawEvict(0);
+    return old;
+}
+
+void MemoryBlockCache::Clear()
+{
+    AutoLock auto_lock(&cache_lock);
+
+    files.clear();
+    lru_order.clear();
+    total_size = 0;
+}
+
+//
+// Copy the range of the object to buf, only if all blocks in the range
+// are in memory.
+//
+bool MemoryBlockCache::Read(const std::string& path, const std::string& etag, off_t start, size_t size, char* buf)
+{
+    AutoLock auto_lock(&cache_lock);
+
+    mem_cache_map_t::iterator iter = files.find(path);
+    if(files.end() == iter || iter->second.etag != etag || 0 == size){
+        return false;
+    }
+
+    // check all blocks at first
+    off_t end = start + static_cast<off_t>(size);
+    for(off_t block_start = (start / MEMORY_CACHE_BLOCK_SIZE) * MEMORY_CACHE_BLOCK_SIZE; block_start < end; block_start += MEMORY_CACHE_BLOCK_SIZE){
+        mem_block_map_t::const_iterator biter = iter->second.blocks.find(block_start);
+        if(iter->second.blocks.end() == biter || block_start + static_cast<off_t>(biter->second.data.size()) < std::min(end, block_start + MEMORY_CACHE_BLOCK_SIZE)){
+            return false;
+        }
+    }
+
+    // copy
+    for(off_t block_start = (start / MEMORY_CACHE_BLOCK_SIZE) * MEMORY_CACHE_BLOCK_SIZE; block_start < end; block_start += MEMORY_CACHE_BLOCK_SIZE){
+        mem_cache_block& block = iter->second.blocks[block_start];
+        off_t            copy_start = std::max(start, block_start);
+        off_t            copy_end   = std::min(end, block_start + MEMORY_CACHE_BLOCK_SIZE);
+        memcpy(&buf[copy_start - start], &block.data[copy_start - block_start], static_cast<size_t>(copy_end - copy_start));
+
+        // accessed block moves to the end
+        lru_order.splice(lru_order.end(), lru_order, block.lru_pos);
+    }
+    return true;
+}
+
+bool MemoryBlockCache::Has(const std::string& path, const std::string& etag, off_t block_start)
+{
+    AutoLock auto_lock(&cache_lock);
+
+    mem_cache_map_t::const_iterator iter = files.find(path);
+    if(files.end() == iter || iter->second.etag != etag){
+        return false;
+    }
+    return (iter->second.blocks.end() != iter->second.blocks.find(block_start));
+}
+
+//
+// Put the block of the object. The block must start at the block boundary,
+// and it must be the block size except the last block of the object.
+// Blocks of the other ETag for the path are removed.
+//
+bool MemoryBlockCache::Write(const std::string& path, const std::string& etag, off_t block_start, const char* data, size_t size)
+{
+    AutoLock auto_lock(&cache_lock);
+
+    if(0 != (block_start % MEMORY_CACHE_BLOCK_SIZE) || MEMORY_CACHE_BLOCK_SIZE < static_cast<off_t>(size) || 0 == size || max_size < static_cast<off_t>(size)){
+        return false;
+    }
+
+    mem_cache_map_t::iterator iter = files.find(path);
+    if(files.end() != iter && iter->second.etag != etag){
+        RawRemoveFile(iter);
+    }
+    if(files.end() != (iter = files.find(path))){
+        mem_block_map_t::iterator biter = iter->second.blocks.find(block_start);
+        if(iter->second.blocks.end() != biter){
+            lru_order.erase(biter->second.lru_pos);
+            total_size -= static_cast<off_t>(biter->second.data.size());
+            iter->second.blocks.erase(biter);
+        }
+    }
+    RawEvict(static_cast<off_t>(size));
+
+    mem_cache_file& file = files[path];
+    file.etag = etag;
+
+    mem_cache_block& block = file.blocks[block_start];
+    block.data.assign(data, size);
+    block.lru_pos = lru_order.insert(lru_order.end(), std::make_pair(path, block_start));
+    total_size += static_cast<off_t>(size);
+
+    return true;
+}
+
+bool MemoryBlockCache::Remove(const std::string& path)
+{
+    AutoLock auto_lock(&cache_lock);
+
+    mem_cache_map_t::iterator iter = files.find(path);
+    if(files.end() == iter){
+        return false;
+    }
+    RawRemoveFile(iter);
+    return true;
+}
+
+bool MemoryBlockCache::Rename(const std::string& from, const std::string& to)
+{
+    AutoLock auto_lock(&cache_lock);
+
+    mem_cache_map_t::iterator iter = files.find(to);
+    if(files.end() != iter){
+        RawRemoveFile(iter);
+    }
+    if(files.end() == (iter = files.find(from))){
+        return false;
+    }
+    mem_cache_file& file = files[to];
+    file.etag = iter->second.etag;
+    file.blocks.swap(iter->second.blocks);
+    files.erase(iter);
+
+    for(mem_block_map_t::iterator biter = file.blocks.begin(); biter != file.blocks.end(); ++biter){
+        biter->second.lru_pos->first = to;
+    }
+    return true;
+}
+
+size_t MemoryBlockCache::Count()
+{
+    AutoLock auto_lock(&cache_lock);
+
+    return lru_order.size();
+}
+
+off_t MemoryBlockCache::TotalSize()
+{
+    AutoLock auto_lock(&cache_lock);
+
+    return total_size;
+}
+
+/*
+* Local variables:
+* tab-width: 4
+* c-basic-offset: 4
+* End:
+* vim600: expandtab sw=4 ts=4 fdm=marker
+* vim<600: expandtab sw=4 ts=4
+*/
@@ -0,0 +1,105 @@
+/*
+ * s3fs - FUSE-based file system backed by Amazon S3
+ *
+ * Copyright(C) 2007 Randy Rizun <rrizun@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#ifndef S3FS_FDCACHE_MEMORY_H_
+#define S3FS_FDCACHE_MEMORY_H_
+
+#include <list>
+#include <map>
+#include <string>
+
+//------------------------------------------------
+// Typedefs
+//------------------------------------------------
+typedef std::list<std::pair<std::string, off_t> >    mem_lru_list_t;        // path and block start, the front is the least recently used
+
+// One block of the object data in memory
+//
+struct mem_cache_block
+{
+    std::string              data;
+    mem_lru_list_t::iterator lru_pos;
+};
+
+typedef std::map<off_t, mem_cache_block>             mem_block_map_t;       // key is the block start
+
+// Blocks of one object
+//
+struct mem_cache_file
+{
+    std::string     etag;       // ETag of the object which the blocks are for
+    mem_block_map_t blocks;
+};
+
+typedef std::map<std::string, mem_cache_file>        mem_cache_map_t;       // key is the object path
+
+//------------------------------------------------
+// Class MemoryBlockCache
+//------------------------------------------------
+// Bounded in-memory cache of the object data in fixed size blocks, which
+// is shared by all entities. The blocks are keyed by the object path and
+// ETag, so that blocks of the changed object are never returned.
+// The least recently used blocks are evicted when it is over the size.
+//
+class MemoryBlockCache
+{
+    private:
+        bool               is_lock_init;
+        pthread_mutex_t    cache_lock;      // protects the following members
+        off_t              max_size;        // 0 means disabled
+        off_t              total_size;
+        mem_cache_map_t    files;
+        mem_lru_list_t     lru_order;
+
+    private:
+        void RawRemoveFile(mem_cache_map_t::iterator& iter);
+        void RawEvict(off_t size);
+
+    public:
+        static off_t GetBlockSize();
+
+        MemoryBlockCache();
+        ~MemoryBlockCache();
+
+        off_t SetMaxSize(off_t size);
+        off_t GetMaxSize() const { return max_size; }
+        bool IsEnabled() const { return 0 < max_size; }
+
+        void Clear();
+        bool Read(const std::string& path, const std::string& etag, off_t start, size_t size, char* buf);
+        bool Has(const std::string& path, const std::string& etag, off_t block_start);
+        bool Write(const std::string& path, const std::string& etag, off_t block_start, const char* data, size_t size);
+        bool Remove(const std::string& path);
+        bool Rename(const std::string& from, const std::string& to);
+        size_t Count();
+        off_t TotalSize();
+};
+
+#endif // S3FS_FDCACHE_MEMORY_H_
+
+/*
+* Local variables:
+* tab-width: 4
+* c-basic-offset: 4
+* End:
+* vim600: expandtab sw=4 ts=4 fdm=marker
+* vim<600: expandtab sw=4 ts=4
+*/
@@ -23,6 +23,7 @@
 #include <cerrno>
 #include <unistd.h>
 #include <sstream>
+#include <algorithm>
 
 #include "common.h"
 #include "s3fs.h"
@@ -34,6 +35,76 @@
 //------------------------------------------------
 static const int CHECK_CACHEFILE_PART_SIZE = 1024 * 16;    // Buffer size in PageList::CheckZeroAreaInFile()
 
+//------------------------------------------------
+// Binary cache stat file format
+//------------------------------------------------
+// [NOTE]
+// The cache stat file consists of a fixed size header, base page records
+// and delta records.
+// The base page records are the all pages when the file is written
+// completely. The delta records are appended after them when the pages
+// are saved again, and they are applied to the base pages in order when
+// loading. When the delta records increase, the file is compacted by
+// writing it completely.
+// The cache stat file is local file, so the records are native byte order.
+// The old text format("<inode>:<size>\n<offset>:<bytes>:<loaded>:<modified>\n...")
+// is still loaded, and it is replaced by this format at the next save.
+//
+static const char     CACHE_STAT_MAGIC[4]          = {'S', '3', 'C', 'S'};
+static const uint32_t CACHE_STAT_VERSION           = 1;
+static const size_t   CACHE_STAT_ETAG_LENGTH       = 64;
+static const size_t   CACHE_STAT_MIN_COMPACT_COUNT = 64;   // delta records are allowed up to max(this, base records)
+
+static const uint32_t CACHE_STAT_RECORD_PAGE       = 0;    // set the status of page
+static const uint32_t CACHE_STAT_RECORD_RESIZE     = 1;    // resize pages(bytes is new size)
+static const uint32_t CACHE_STAT_RECORD_BLOCK      = 2;    // last access time of block(bytes is time, 0 means removing)
+
+static const uint32_t CACHE_STAT_FLAG_LOADED       = 0x1;
+static const uint32_t CACHE_STAT_FLAG_MODIFIED     = 0x2;
+
+struct cache_stat_header
+{
+    char     magic[4];
+    uint32_t version;
+    uint64_t inode;
+    int64_t  size;                                  // size of base pages
+    uint32_t base_count;                            // count of base page records
+    uint32_t etag_length;
+    char     etag[CACHE_STAT_ETAG_LENGTH];
+};
+
+struct cache_stat_record
+{
+    int64_t  offset;
+    int64_t  bytes;
+    uint32_t type;
+    uint32_t flags;
+};
+
+static void make_cache_stat_record(cache_stat_record& record, uint32_t type, off_t offset, off_t bytes, bool is_loaded, bool is_modified)
+{
+    memset(&record, 0, sizeof(cache_stat_record));
+    record.offset = static_cast<int64_t>(offset);
+    record.bytes  = static_cast<int64_t>(bytes);
+    record.type   = type;
+    record.flags  = (is_loaded ? CACHE_STAT_FLAG_LOADED : 0) | (is_modified ? CACHE_STAT_FLAG_MODIFIED : 0);
+}
+
+static bool write_all(int fd, const char* pdata, size_t length, off_t offset)
+{
+    for(size_t written = 0; written < length; ){
+        ssize_t result = pwrite(fd, &pdata[written], length - written, offset + written);
+        if(-1 == result){
+            if(EINTR == errno){
+                continue;
+            }
+            return false;
+        }
+        written += static_cast<size_t>(result);
+    }
+    return true;
+}
+
 //------------------------------------------------
 // fdpage_list_t utility
 //------------------------------------------------
@@ -342,12 +413,12 @@ void PageList::FreeList(fdpage_list_t& list)
     list.clear();
 }
 
-PageList::PageList(off_t size, bool is_loaded, bool is_modified)
+PageList::PageList(off_t size, bool is_loaded, bool is_modified) : saved_stat_size(-1), saved_base_count(0), saved_delta_count(0)
 {
     Init(size, is_loaded, is_modified);
 }
 
-PageList::PageList(const PageList& other)
+PageList::PageList(const PageList& other) : saved_stat_size(-1), saved_base_count(0), saved_delta_count(0)
 {
     for(fdpage_list_t::const_iterator iter = other.pages.begin(); iter != other.pages.end(); ++iter){
         pages.push_back(*iter);
@@ -759,31 +830,160 @@ bool PageList::ClearAllModified()
     return Compress();
 }
 
-bool PageList::Serialize(CacheFileStat& file, bool is_output, ino_t inode)
+//
+// Set the last access time of the blocks in the area.
+//
+void PageList::SetBlockAccessTime(off_t start, off_t size, off_t block_size, time_t atime)
+{
+    if(0 >= block_size || 0 >= size){
+        return;
+    }
+    for(off_t block_start = (start / block_size) * block_size; block_start < start + size; block_start += block_size){
+        block_atimes[block_start] = atime;
+    }
+}
+
+//
+// Get the start offsets of blocks which can be unloaded, in order of
+// the last access time. The block which has modified area can not be
+// unloaded, and the block which has no loaded area is not needed.
+//
+size_t PageList::GetColdBlocks(off_t block_size, std::list<off_t>& blocks) const
+{
+    blocks.clear();
+    if(0 >= block_size){
+        return 0;
+    }
+
+    std::multimap<time_t, off_t>  cold_blocks;
+    off_t                         total = Size();
+    fdpage_list_t::const_iterator piter = pages.begin();
+    for(off_t block_start = 0; block_start < total; block_start += block_size){
+        off_t block_next  = std::min(block_start + block_size, total);
+        bool  is_loaded   = false;
+        bool  is_modified = false;
+        for(; piter != pages.end() && piter->next() <= block_start; ++piter);
+        for(fdpage_list_t::const_iterator iter = piter; iter != pages.end(); ++iter){
+            if(block_next <= iter->offset){
+                break;
+            }
+            if(iter->modified){
+                is_modified = true;
+                break;
+            }
+            if(iter->loaded){
+                is_loaded = true;
+            }
+        }
+        if(!is_loaded || is_modified){
+            continue;
+        }
+        block_atime_map_t::const_iterator aiter = block_atimes.find(block_start);
+        cold_blocks.insert(std::make_pair((block_atimes.end() != aiter ? aiter->second : 0), block_start));
+    }
+    for(std::multimap<time_t, off_t>::const_iterator iter = cold_blocks.begin(); iter != cold_blocks.end(); ++iter){
+        blocks.push_back(iter->second);
+    }
+    return blocks.size();
+}
+
+//
+// Mark the block as not loaded, and set the loaded size in it to unloaded_size.
+//
+bool PageList::UnloadBlock(off_t block_start, off_t block_size, off_t& unloaded_size)
+{
+    off_t length  = std::min(block_size, Size() - block_start);
+    unloaded_size = 0;
+    if(length <= 0){
+        return false;
+    }
+    unloaded_size = length - GetTotalUnloadedPageSize(block_start, length);
+    block_atimes.erase(block_start);
+
+    return SetPageLoadedStatus(block_start, length, PageList::PAGE_NOT_LOAD_MODIFIED);
+}
+
+//
+// Merge the loaded pages in the cache stat file, which the other processes
+// saved for the same cache file(inode) and the same object(ETag).
+// Only the areas which are neither loaded nor modified in this list are
+// set loaded, so the modified pages are never changed.
+//
+bool PageList::MergeLoadedPages(CacheFileStat& file, ino_t inode, const std::string& etag)
 {
     if(!file.Open()){
         return false;
     }
+    return MergeLoadedPages(file.GetFd(), inode, etag);
+}
+
+bool PageList::MergeLoadedPages(int fd, ino_t inode, const std::string& etag)
+{
+    PageList    saved;
+    std::string saved_etag;
+    if(etag.empty() || !saved.Serialize(fd, false, inode, &saved_etag) || saved_etag != etag){
+        return false;
+    }
+
+    for(fdpage_list_t::const_iterator siter = saved.pages.begin(); siter != saved.pages.end(); ++siter){
+        if(!siter->loaded || siter->modified){
+            continue;
+        }
+        fdpage_list_t unloaded_list;
+        if(0 == GetUnloadedPages(unloaded_list, siter->offset, siter->bytes)){
+            continue;
+        }
+        for(fdpage_list_t::const_iterator uiter = unloaded_list.begin(); uiter != unloaded_list.end(); ++uiter){
+            SetPageLoadedStatus(uiter->offset, uiter->bytes, PageList::PAGE_LOADED);
+        }
+        PageList::FreeList(unloaded_list);
+    }
+    return true;
+}
+
+void PageList::ResetSavedState()
+{
+    saved_pages.clear();
+    saved_block_atimes.clear();
+    saved_stat_size   = -1;
+    saved_base_count  = 0;
+    saved_delta_count = 0;
+}
+
+void PageList::SetSavedState(off_t stat_size, size_t base_count, size_t delta_count)
+{
+    saved_pages        = pages;
+    saved_block_atimes = block_atimes;
+    saved_stat_size    = stat_size;
+    saved_base_count  = base_count;
+    saved_delta_count = delta_count;
+}
+
+//
+// Serialize the pages to the cache stat file, or load them from it.
+//
+// If petag is specified, it is the ETag to put in the header for output,
+// and it is set the ETag in the header for loading.
+//
+bool PageList::Serialize(CacheFileStat& file, bool is_output, ino_t inode, std::string* petag)
+{
+    if(!file.Open()){
+        return false;
+    }
+    return Serialize(file.GetFd(), is_output, inode, petag);
+}
+
+bool PageList::Serialize(int fd, bool is_output, ino_t inode, std::string* petag)
+{
     if(is_output){
         //
         // put to file
         //
-        std::ostringstream ssall;
-        ssall << inode << ":" << Size();
-
-        for(fdpage_list_t::iterator iter = pages.begin(); iter != pages.end(); ++iter){
-            ssall << "\n" << iter->offset << ":" << iter->bytes << ":" << (iter->loaded ? "1" : "0") << ":" << (iter->modified ? "1" : "0");
-        }
-
-        if(-1 == ftruncate(file.GetFd(), 0)){
-            S3FS_PRN_ERR("failed to truncate file(to 0) for stats(%d)", errno);
-            return false;
-        }
-        std::string strall = ssall.str();
-        if(0 >= pwrite(file.GetFd(), strall.c_str(), strall.length(), 0)){
-            S3FS_PRN_ERR("failed to write stats(%d)", errno);
-            return false;
+        bool is_appended = false;
+        if(AppendBinaryStats(fd, inode, petag, is_appended) && is_appended){
+            return true;
         }
+        return SaveBinaryStats(fd, inode, petag);
 
     }else{
         //
@@ -791,10 +991,12 @@ bool PageList::Serialize(CacheFileStat& file, bool is_output, ino_t inode)
         //
         struct stat st;
         memset(&st, 0, sizeof(struct stat));
-        if(-1 == fstat(file.GetFd(), &st)){
+        if(-1 == fstat(fd, &st)){
             S3FS_PRN_ERR("fstat is failed. errno(%d)", errno);
             return false;
         }
+        ResetSavedState();
+        block_atimes.clear();
         if(0 >= st.st_size){
           // nothing
             Init(0, false, false);
@@ -803,110 +1005,350 @@ bool PageList::Serialize(CacheFileStat& file, bool is_output, ino_t inode)
         char* ptmp = new char[st.st_size + 1];
         ssize_t result;
         // read from file
-        if(0 >= (result = pread(file.GetFd(), ptmp, st.st_size, 0))){
+        if(0 >= (result = pread(fd, ptmp, st.st_size, 0))){
             S3FS_PRN_ERR("failed to read stats(%d)", errno);
             delete[] ptmp;
             return false;
         }
         ptmp[result] = '\0';
-        std::string        oneline;
-        std::istringstream ssall(ptmp);
-    
-        // loaded
-        Clear();
-    
-        // load head line(for size and inode)
-        off_t total;
-        ino_t cache_inode;                  // if this value is 0, it means old format.
-        if(!getline(ssall, oneline, '\n')){
+
+        bool is_loaded;
+        if(static_cast<size_t>(result) >= sizeof(CACHE_STAT_MAGIC) && 0 == memcmp(ptmp, CACHE_STAT_MAGIC, sizeof(CACHE_STAT_MAGIC))){
+            is_loaded = LoadBinaryStats(ptmp, static_cast<size_t>(result), inode, petag);
+        }else{
+            // old text format
+            is_loaded = LoadTextStats(ptmp, inode);
+            if(petag){
+                petag->erase();
+            }
+        }
+        delete[] ptmp;
+
+        return is_loaded;
+    }
+    return true;
+}
+
+bool PageList::LoadTextStats(const char* pdata, ino_t inode)
+{
+    std::string        oneline;
+    std::istringstream ssall(pdata);
+
+    // loaded
+    Clear();
+
+    // load head line(for size and inode)
+    off_t total;
+    ino_t cache_inode;                  // if this value is 0, it means old format.
+    if(!getline(ssall, oneline, '\n')){
+        S3FS_PRN_ERR("failed to parse stats.");
+        return false;
+    }else{
+        std::istringstream sshead(oneline);
+        std::string        strhead1;
+        std::string        strhead2;
+
+        // get first part in head line.
+        if(!getline(sshead, strhead1, ':')){
             S3FS_PRN_ERR("failed to parse stats.");
-            delete[] ptmp;
             return false;
+        }
+        // get second part in head line.
+        if(!getline(sshead, strhead2, ':')){
+            // old head format is "<size>\n"
+            total       = cvt_strtoofft(strhead1.c_str(), /* base= */10);
+            cache_inode = 0;
         }else{
-            std::istringstream sshead(oneline);
-            std::string        strhead1;
-            std::string        strhead2;
-    
-            // get first part in head line.
-            if(!getline(sshead, strhead1, ':')){
-                S3FS_PRN_ERR("failed to parse stats.");
-                delete[] ptmp;
+            // current head format is "<inode>:<size>\n"
+            total       = cvt_strtoofft(strhead2.c_str(), /* base= */10);
+            cache_inode = static_cast<ino_t>(cvt_strtoofft(strhead1.c_str(), /* base= */10));
+            if(0 == cache_inode){
+                S3FS_PRN_ERR("wrong inode number in parsed cache stats.");
                 return false;
             }
-            // get second part in head line.
-            if(!getline(sshead, strhead2, ':')){
-                // old head format is "<size>\n"
-                total       = cvt_strtoofft(strhead1.c_str(), /* base= */10);
-                cache_inode = 0;
+        }
+    }
+    // check inode number
+    if(0 != cache_inode && cache_inode != inode){
+        S3FS_PRN_ERR("differ inode and inode number in parsed cache stats.");
+        return false;
+    }
+
+    // load each part
+    bool is_err = false;
+    while(getline(ssall, oneline, '\n')){
+        std::string        part;
+        std::istringstream ssparts(oneline);
+        // offset
+        if(!getline(ssparts, part, ':')){
+            is_err = true;
+            break;
+        }
+        off_t offset = cvt_strtoofft(part.c_str(), /* base= */10);
+        // size
+        if(!getline(ssparts, part, ':')){
+            is_err = true;
+            break;
+        }
+        off_t size = cvt_strtoofft(part.c_str(), /* base= */10);
+        // loaded
+        if(!getline(ssparts, part, ':')){
+            is_err = true;
+            break;
+        }
+        bool is_loaded = (1 == cvt_strtoofft(part.c_str(), /* base= */10) ? true : false);
+        bool is_modified;
+        if(!getline(ssparts, part, ':')){
+            is_modified = false;        // old version does not have this part.
+        }else{
+            is_modified = (1 == cvt_strtoofft(part.c_str(), /* base= */10) ? true : false);
+        }
+        // add new area
+        PageList::page_status pstatus = 
+          ( is_loaded && is_modified  ? PageList::PAGE_LOAD_MODIFIED : 
+            !is_loaded && is_modified ? PageList::PAGE_MODIFIED      : 
+            is_loaded && !is_modified ? PageList::PAGE_LOADED        : PageList::PAGE_NOT_LOAD_MODIFIED );
+
+        SetPageLoadedStatus(offset, size, pstatus);
+    }
+    if(is_err){
+        S3FS_PRN_ERR("failed to parse stats.");
+        Clear();
+        return false;
+    }
+
+    // check size
+    if(total != Size()){
+        S3FS_PRN_ERR("different size(%lld - %lld).", static_cast<long long int>(total), static_cast<long long int>(Size()));
+        Clear();
+        return false;
+    }
+    return true;
+}
+
+bool PageList::LoadBinaryStats(const char* pdata, size_t length, ino_t inode, std::string* petag)
+{
+    Clear();
+
+    cache_stat_header header;
+    if(length < sizeof(cache_stat_header)){
+        S3FS_PRN_ERR("failed to parse stats(too short header).");
+        return false;
+    }
+    memcpy(&header, pdata, sizeof(cache_stat_header));
+    if(CACHE_STAT_VERSION != header.version){
+        S3FS_PRN_ERR("unknown version(%u) of stats.", header.version);
+        return false;
+    }
+    if(static_cast<uint64_t>(inode) != header.inode){
+        S3FS_PRN_ERR("differ inode and inode number in parsed cache stats.");
+        return false;
+    }
+    if(CACHE_STAT_ETAG_LENGTH < header.etag_length){
+        S3FS_PRN_ERR("wrong ETag length(%u) in stats.", header.etag_length);
+        return false;
+    }
+    size_t records = (length - sizeof(cache_stat_header)) / sizeof(cache_stat_record);
+    if(0 != (length - sizeof(cache_stat_header)) % sizeof(cache_stat_record) || records < header.base_count){
+        S3FS_PRN_ERR("failed to parse stats(wrong length of records).");
+        return false;
+    }
+
+    // apply base records and delta records in order
+    off_t total = static_cast<off_t>(header.size);
+    const char* precord = &pdata[sizeof(cache_stat_header)];
+    for(size_t cnt = 0; cnt < records; ++cnt, precord += sizeof(cache_stat_record)){
+        cache_stat_record record;
+        memcpy(&record, precord, sizeof(cache_stat_record));
+
+        if(CACHE_STAT_RECORD_RESIZE == record.type && header.base_count <= cnt){
+            total = static_cast<off_t>(record.bytes);
+            Resize(total, false, false);
+        }else if(CACHE_STAT_RECORD_BLOCK == record.type){
+            if(0 == record.bytes){
+                block_atimes.erase(static_cast<off_t>(record.offset));
             }else{
-                // current head format is "<inode>:<size>\n"
-                total       = cvt_strtoofft(strhead2.c_str(), /* base= */10);
-                cache_inode = static_cast<ino_t>(cvt_strtoofft(strhead1.c_str(), /* base= */10));
-                if(0 == cache_inode){
-                    S3FS_PRN_ERR("wrong inode number in parsed cache stats.");
-                    delete[] ptmp;
-                    return false;
-                }
+                block_atimes[static_cast<off_t>(record.offset)] = static_cast<time_t>(record.bytes);
             }
-        }
-        // check inode number
-        if(0 != cache_inode && cache_inode != inode){
-            S3FS_PRN_ERR("differ inode and inode number in parsed cache stats.");
-            delete[] ptmp;
+        }else if(CACHE_STAT_RECORD_PAGE == record.type){
+            bool is_loaded   = (0 != (record.flags & CACHE_STAT_FLAG_LOADED));
+            bool is_modified = (0 != (record.flags & CACHE_STAT_FLAG_MODIFIED));
+            PageList::page_status pstatus =
+              ( is_loaded && is_modified  ? PageList::PAGE_LOAD_MODIFIED :
+                !is_loaded && is_modified ? PageList::PAGE_MODIFIED      :
+                is_loaded && !is_modified ? PageList::PAGE_LOADED        : PageList::PAGE_NOT_LOAD_MODIFIED );
+
+            SetPageLoadedStatus(static_cast<off_t>(record.offset), static_cast<off_t>(record.bytes), pstatus);
+        }else{
+            S3FS_PRN_ERR("failed to parse stats(unknown record type %u).", record.type);
+            Clear();
             return false;
         }
-    
-        // load each part
-        bool is_err = false;
-        while(getline(ssall, oneline, '\n')){
-            std::string        part;
-            std::istringstream ssparts(oneline);
-            // offset
-            if(!getline(ssparts, part, ':')){
-                is_err = true;
-                break;
-            }
-            off_t offset = cvt_strtoofft(part.c_str(), /* base= */10);
-            // size
-            if(!getline(ssparts, part, ':')){
-                is_err = true;
-                break;
+    }
+
+    // check size
+    if(total != Size()){
+        S3FS_PRN_ERR("different size(%lld - %lld).", static_cast<long long int>(total), static_cast<long long int>(Size()));
+        Clear();
+        return false;
+    }
+    if(petag){
+        petag->assign(header.etag, header.etag_length);
+    }
+    SetSavedState(static_cast<off_t>(length), header.base_count, records - header.base_count);
+
+    return true;
+}
+
+//
+// Write all pages to the cache stat file as base records.
+//
+bool PageList::SaveBinaryStats(int fd, ino_t inode, const std::string* petag)
+{
+    cache_stat_header header;
+    memset(&header, 0, sizeof(cache_stat_header));
+    memcpy(header.magic, CACHE_STAT_MAGIC, sizeof(CACHE_STAT_MAGIC));
+    header.version    = CACHE_STAT_VERSION;
+    header.inode      = static_cast<uint64_t>(inode);
+    header.size       = static_cast<int64_t>(Size());
+    header.base_count = static_cast<uint32_t>(pages.size() + block_atimes.size());
+    if(petag && petag->length() <= CACHE_STAT_ETAG_LENGTH){
+        header.etag_length = static_cast<uint32_t>(petag->length());
+        memcpy(header.etag, petag->c_str(), petag->length());
+    }
+
+    std::string buffer(reinterpret_cast<const char*>(&header), sizeof(cache_stat_header));
+    for(fdpage_list_t::const_iterator iter = pages.begin(); iter != pages.end(); ++iter){
+        cache_stat_record record;
+        make_cache_stat_record(record, CACHE_STAT_RECORD_PAGE, iter->offset, iter->bytes, iter->loaded, iter->modified);
+        buffer.append(reinterpret_cast<const char*>(&record), sizeof(cache_stat_record));
+    }
+    for(block_atime_map_t::const_iterator iter = block_atimes.begin(); iter != block_atimes.end(); ++iter){
+        cache_stat_record record;
+        make_cache_stat_record(record, CACHE_STAT_RECORD_BLOCK, iter->first, static_cast<off_t>(iter->second), false, false);
+        buffer.append(reinterpret_cast<const char*>(&record), sizeof(cache_stat_record));
+    }
+
+    if(-1 == ftruncate(fd, 0)){
+        S3FS_PRN_ERR("failed to truncate file(to 0) for stats(%d)", errno);
+        ResetSavedState();
+        return false;
+    }
+    if(!write_all(fd, buffer.c_str(), buffer.length(), 0)){
+        S3FS_PRN_ERR("failed to write stats(%d)", errno);
+        ResetSavedState();
+        return false;
+    }
+    SetSavedState(static_cast<off_t>(buffer.length()), pages.size() + block_atimes.size(), 0);
+
+    return true;
+}
+
+//
+// Append the changed pages since the last save as delta records.
+//
+// If the delta records can not be appended(the file is not the state which
+// this object saved or loaded, or it needs compaction), is_appended is
+// false and the caller writes all pages.
+//
+bool PageList::AppendBinaryStats(int fd, ino_t inode, const std::string* petag, bool& is_appended)
+{
+    is_appended = false;
+
+    if(-1 == saved_stat_size){
+        return true;
+    }
+
+    // check the file is the state which this object saved
+    struct stat st;
+    cache_stat_header header;
+    if(-1 == fstat(fd, &st) || st.st_size != saved_stat_size){
+        return true;
+    }
+    if(static_cast<ssize_t>(sizeof(cache_stat_header)) != pread(fd, &header, sizeof(cache_stat_header), 0)){
+        return true;
+    }
+    if(0 != memcmp(header.magic, CACHE_STAT_MAGIC, sizeof(CACHE_STAT_MAGIC)) || CACHE_STAT_VERSION != header.version || static_cast<uint64_t>(inode) != header.inode){
+        return true;
+    }
+
+    // make delta records
+    std::string buffer;
+    size_t      count = 0;
+    {
+        off_t saved_size = 0;
+        if(!saved_pages.empty()){
+            saved_size = saved_pages.back().next();
+        }
+        if(saved_size != Size()){
+            cache_stat_record record;
+            make_cache_stat_record(record, CACHE_STAT_RECORD_RESIZE, 0, Size(), false, false);
+            buffer.append(reinterpret_cast<const char*>(&record), sizeof(cache_stat_record));
+            ++count;
+        }
+        fdpage_list_t::const_iterator siter = saved_pages.begin();
+        for(fdpage_list_t::const_iterator iter = pages.begin(); iter != pages.end(); ++iter){
+            for(; siter != saved_pages.end() && siter->offset < iter->offset; ++siter);
+            if(siter != saved_pages.end() && siter->offset == iter->offset && siter->bytes == iter->bytes && siter->loaded == iter->loaded && siter->modified == iter->modified){
+                continue;
             }
-            off_t size = cvt_strtoofft(part.c_str(), /* base= */10);
-            // loaded
-            if(!getline(ssparts, part, ':')){
-                is_err = true;
-                break;
+            cache_stat_record record;
+            make_cache_stat_record(record, CACHE_STAT_RECORD_PAGE, iter->offset, iter->bytes, iter->loaded, iter->modified);
+            buffer.append(reinterpret_cast<const char*>(&record), sizeof(cache_stat_record));
+            ++count;
+        }
+
+        // changed and removed access time of blocks
+        for(block_atime_map_t::const_iterator iter = block_atimes.begin(); iter != block_atimes.end(); ++iter){
+            block_atime_map_t::const_iterator siter = saved_block_atimes.find(iter->first);
+            if(saved_block_atimes.end() != siter && siter->second == iter->second){
+                continue;
             }
-            bool is_loaded = (1 == cvt_strtoofft(part.c_str(), /* base= */10) ? true : false);
-            bool is_modified;
-            if(!getline(ssparts, part, ':')){
-                is_modified = false;        // old version does not have this part.
-            }else{
-                is_modified = (1 == cvt_strtoofft(part.c_str(), /* base= */10) ? true : false);
+            cache_stat_record record;
+            make_cache_stat_record(record, CACHE_STAT_RECORD_BLOCK, iter->first, static_cast<off_t>(iter->second), false, false);
+            buffer.append(reinterpret_cast<const char*>(&record), sizeof(cache_stat_record));
+            ++count;
+        }
+        for(block_atime_map_t::const_iterator siter = saved_block_atimes.begin(); siter != saved_block_atimes.end(); ++siter){
+            if(block_atimes.end() != block_atimes.find(siter->first)){
+                continue;
             }
-            // add new area
-            PageList::page_status pstatus = 
-              ( is_loaded && is_modified  ? PageList::PAGE_LOAD_MODIFIED : 
-                !is_loaded && is_modified ? PageList::PAGE_MODIFIED      : 
-                is_loaded && !is_modified ? PageList::PAGE_LOADED        : PageList::PAGE_NOT_LOAD_MODIFIED );
+            cache_stat_record record;
+            make_cache_stat_record(record, CACHE_STAT_RECORD_BLOCK, siter->first, 0, false, false);
+            buffer.append(reinterpret_cast<const char*>(&record), sizeof(cache_stat_record));
+            ++count;
+        }
+    }
+    if(std::max(CACHE_STAT_MIN_COMPACT_COUNT, saved_base_count) < saved_delta_count + count){
+        // need compaction
+        return true;
+    }
 
-            SetPageLoadedStatus(offset, size, pstatus);
+    // update ETag in header
+    if(petag && (header.etag_length != petag->length() || 0 != petag->compare(0, std::string::npos, header.etag, header.etag_length))){
+        if(CACHE_STAT_ETAG_LENGTH < petag->length()){
+            return true;
         }
-        delete[] ptmp;
-        if(is_err){
-            S3FS_PRN_ERR("failed to parse stats.");
-            Clear();
+        header.etag_length = static_cast<uint32_t>(petag->length());
+        memset(header.etag, 0, sizeof(header.etag));
+        memcpy(header.etag, petag->c_str(), petag->length());
+        if(!write_all(fd, reinterpret_cast<const char*>(&header), sizeof(cache_stat_header), 0)){
+            S3FS_PRN_ERR("failed to write stats header(%d)", errno);
+            ResetSavedState();
             return false;
         }
-  
-        // check size
-        if(total != Size()){
-            S3FS_PRN_ERR("different size(%lld - %lld).", static_cast<long long int>(total), static_cast<long long int>(Size()));
-            Clear();
+    }
+
+    if(0 < count){
+        if(!write_all(fd, buffer.c_str(), buffer.length(), saved_stat_size)){
+            S3FS_PRN_ERR("failed to append stats(%d)", errno);
+            ResetSavedState();
             return false;
         }
     }
+    SetSavedState(saved_stat_size + static_cast<off_t>(buffer.length()), saved_base_count, saved_delta_count + count);
+    is_appended = true;
+
     return true;
 }
 
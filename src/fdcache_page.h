@@ -62,6 +62,9 @@ struct fdpage
 };
 typedef std::list<struct fdpage> fdpage_list_t;
 
+// last access time of each block(key is the start offset of block)
+typedef std::map<off_t, time_t> block_atime_map_t;
+
 //------------------------------------------------
 // Class PageList
 //------------------------------------------------
@@ -73,7 +76,15 @@ class PageList
     friend class FdEntity;    // only one method access directly pages.
 
     private:
-        fdpage_list_t pages;
+        fdpage_list_t     pages;
+        block_atime_map_t block_atimes;     // last access time of blocks(only for cache_block_size)
+
+        // the state of the binary cache stat file for appending delta records
+        fdpage_list_t     saved_pages;          // pages which the cache stat file has
+        block_atime_map_t saved_block_atimes;   // last access time of blocks which the cache stat file has
+        off_t             saved_stat_size;      // size of the cache stat file(-1 means unknown)
+        size_t            saved_base_count;     // count of base records in the cache stat file
+        size_t            saved_delta_count;    // count of delta records in the cache stat file
 
     public:
         enum page_status{
@@ -92,6 +103,13 @@ class PageList
         bool Compress();
         bool Parse(off_t new_pos);
 
+        void ResetSavedState();
+        void SetSavedState(off_t stat_size, size_t base_count, size_t delta_count);
+        bool LoadTextStats(const char* pdata, ino_t inode);
+        bool LoadBinaryStats(const char* pdata, size_t length, ino_t inode, std::string* petag);
+        bool SaveBinaryStats(int fd, ino_t inode, const std::string* petag);
+        bool AppendBinaryStats(int fd, ino_t inode, const std::string* petag, bool& is_appended);
+
     public:
         static void FreeList(fdpage_list_t& list);
 
@@ -115,7 +133,14 @@ class PageList
         bool IsModified() const;
         bool ClearAllModified();
 
-        bool Serialize(CacheFileStat& file, bool is_output, ino_t inode);
+        void SetBlockAccessTime(off_t start, off_t size, off_t block_size, time_t atime);
+        size_t GetColdBlocks(off_t block_size, std::list<off_t>& blocks) const;
+        bool UnloadBlock(off_t block_start, off_t block_size, off_t& unloaded_size);
+        bool MergeLoadedPages(CacheFileStat& file, ino_t inode, const std::string& etag);
+        bool MergeLoadedPages(int fd, ino_t inode, const std::string& etag);
+
+        bool Serialize(CacheFileStat& file, bool is_output, ino_t inode, std::string* petag = NULL);
+        bool Serialize(int fd, bool is_output, ino_t inode, std::string* petag = NULL);
         void Dump() const;
         bool CompareSparseFile(int fd, size_t file_size, fdpage_list_t& err_area_list, fdpage_list_t& warn_area_list);
 };
@@ -188,6 +188,20 @@ size_t get_md5_digest_length()
 }
 
 #ifdef USE_GNUTLS_NETTLE
+unsigned char* s3fs_md5(const unsigned char* data, size_t datalen)
+{
+    struct md5_ctx ctx_md5;
+    unsigned char* result;
+
+    md5_init(&ctx_md5);
+    md5_update(&ctx_md5, datalen, data);
+
+    result = new unsigned char[get_md5_digest_length()];
+    md5_digest(&ctx_md5, get_md5_digest_length(), result);
+
+    return result;
+}
+
 unsigned char* s3fs_md5_fd(int fd, off_t start, off_t size)
 {
     struct md5_ctx ctx_md5;
@@ -227,6 +241,25 @@ unsigned char* s3fs_md5_fd(int fd, off_t start, off_t size)
 
 #else // USE_GNUTLS_NETTLE
 
+unsigned char* s3fs_md5(const unsigned char* data, size_t datalen)
+{
+    gcry_md_hd_t   ctx_md5;
+    gcry_error_t   err;
+    unsigned char* result;
+
+    if(GPG_ERR_NO_ERROR != (err = gcry_md_open(&ctx_md5, GCRY_MD_MD5, 0))){
+        S3FS_PRN_ERR("MD5 context creation failure: %s/%s", gcry_strsource(err), gcry_strerror(err));
+        return NULL;
+    }
+    gcry_md_write(ctx_md5, data, datalen);
+
+    result = new unsigned char[get_md5_digest_length()];
+    memcpy(result, gcry_md_read(ctx_md5, 0), get_md5_digest_length());
+    gcry_md_close(ctx_md5);
+
+    return result;
+}
+
 unsigned char* s3fs_md5_fd(int fd, off_t start, off_t size)
 {
     gcry_md_hd_t ctx_md5;
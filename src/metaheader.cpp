@@ -115,6 +115,15 @@ off_t get_size(const headers_t& meta)
     return get_size((*iter).second.c_str());
 }
 
+std::string get_etag(const headers_t& meta)
+{
+    headers_t::const_iterator iter = meta.find("ETag");
+    if(meta.end() == iter){
+        return std::string("");
+    }
+    return iter->second;
+}
+
 mode_t get_mode(const char *s, int base)
 {
     return static_cast<mode_t>(cvt_strtoofft(s, base));
@@ -45,6 +45,7 @@ struct timespec get_ctime(const headers_t& meta, bool overcheck = true);
 struct timespec get_atime(const headers_t& meta, bool overcheck = true);
 off_t get_size(const char *s);
 off_t get_size(const headers_t& meta);
+std::string get_etag(const headers_t& meta);
 mode_t get_mode(const char *s, int base = 0);
 mode_t get_mode(const headers_t& meta, const char* path = NULL, bool checkdir = false, bool forcedir = false);
 uid_t get_uid(const char *s);
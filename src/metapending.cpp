@@ -0,0 +1,350 @@
+/*
+ * s3fs - FUSE-based file system backed by Amazon S3
+ *
+ * Copyright(C) 2007 Randy Rizun <rrizun@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cerrno>
+#include <ctime>
+
+#include "common.h"
+#include "s3fs.h"
+#include "metapending.h"
+#include "cache.h"
+#include "autolock.h"
+
+//-------------------------------------------------------------------
+// Global function in s3fs.cpp
+//-------------------------------------------------------------------
+int put_headers(const char* path, headers_t& meta, bool is_copy, bool use_st_size = true, bool update_cache_etag = true);
+
+//-------------------------------------------------------------------
+// Class PendingMeta
+//-------------------------------------------------------------------
+PendingMeta PendingMeta::singleton;
+time_t      PendingMeta::delay = 0;
+
+PendingMeta::PendingMeta() : is_worker_run(false)
+{
+    if(this == PendingMeta::get()){
+        pthread_mutexattr_t attr;
+        pthread_mutexattr_init(&attr);
+#if S3FS_PTHREAD_ERRORCHECK
+        pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_ERRORCHECK);
+#endif
+        int result;
+        if(0 != (result = pthread_mutex_init(&pending_lock, &attr))){
+            S3FS_PRN_CRIT("failed to init pending_lock: %d", result);
+            abort();
+        }
+        if(0 != (result = pthread_cond_init(&worker_cond, NULL))){
+            S3FS_PRN_CRIT("failed to init worker_cond: %d", result);
+            abort();
+        }
+    }else{
+        abort();
+    }
+}
+
+PendingMeta::~PendingMeta()
+{
+    if(this == PendingMeta::get()){
+        int result;
+        if(0 != (result = pthread_cond_destroy(&worker_cond))){
+            S3FS_PRN_CRIT("failed to destroy worker_cond: %d", result);
+            abort();
+        }
+        if(0 != (result = pthread_mutex_destroy(&pending_lock))){
+            S3FS_PRN_CRIT("failed to destroy pending_lock: %d", result);
+            abort();
+        }
+    }else{
+        abort();
+    }
+}
+
+time_t PendingMeta::SetDelay(time_t sec)
+{
+    time_t old = PendingMeta::delay;
+    PendingMeta::delay = sec;
+    return old;
+}
+
+time_t PendingMeta::GetNow()
+{
+    struct timespec ts;
+    if(-1 == clock_gettime(S3FS_CLOCK_MONOTONIC, &ts)){
+        return time(NULL);
+    }
+    return ts.tv_sec;
+}
+
+bool PendingMeta::StartWorker()
+{
+    if(!PendingMeta::IsEnable()){
+        return true;
+    }
+    AutoLock auto_lock(&pending_lock);
+
+    if(is_worker_run){
+        return true;
+    }
+    is_worker_run = true;
+
+    int result;
+    if(0 != (result = pthread_create(&worker_thread, NULL, PendingMeta::Worker, static_cast<void*>(this)))){
+        S3FS_PRN_ERR("Could not create thread for pending meta by %d", result);
+        is_worker_run = false;
+        return false;
+    }
+    return true;
+}
+
+bool PendingMeta::StopWorker()
+{
+    {
+        AutoLock auto_lock(&pending_lock);
+        if(!is_worker_run){
+            return true;
+        }
+        is_worker_run = false;
+        pthread_cond_broadcast(&worker_cond);
+    }
+
+    int result;
+    if(0 != (result = pthread_join(worker_thread, NULL))){
+        S3FS_PRN_ERR("failed pthread_join - rc(%d)", result);
+        return false;
+    }
+
+    // put all pending meta
+    FlushAll();
+
+    return true;
+}
+
+void* PendingMeta::Worker(void* arg)
+{
+    PendingMeta* pThis = static_cast<PendingMeta*>(arg);
+    if(!pThis){
+        return NULL;
+    }
+    S3FS_PRN_INFO3("start pending meta worker.");
+
+    while(true){
+        {
+            AutoLock auto_lock(&pThis->pending_lock);
+            if(!pThis->is_worker_run){
+                break;
+            }
+            // wait 1 second(or stop)
+            struct timespec abstime;
+            clock_gettime(CLOCK_REALTIME, &abstime);
+            abstime.tv_sec += 1;
+            pthread_cond_timedwait(&pThis->worker_cond, &pThis->pending_lock, &abstime);
+            if(!pThis->is_worker_run){
+                break;
+            }
+        }
+        pThis->FlushExpired();
+    }
+    S3FS_PRN_INFO3("stop pending meta worker.");
+
+    return NULL;
+}
+
+//
+// Add(or replace) the pending meta headers for the path.
+//
+// The meta must be all headers of the object which are merged with the
+// updated headers. The stat cache is updated by the meta.
+//
+bool PendingMeta::Add(const char* path, const std::string& strpath, const std::string& nowcache, const headers_t& meta, pid_t pid)
+{
+    if(!path || '\0' == path[0]){
+        return false;
+    }
+    if(!PendingMeta::IsEnable()){
+        return false;
+    }
+
+    // update stat cache without the headers for copying
+    headers_t cachemeta = meta;
+    cachemeta.erase("x-amz-copy-source");
+    cachemeta.erase("x-amz-metadata-directive");
+    if(!StatCache::getStatCacheData()->UpdateMetaStats(nowcache, cachemeta) || !StatCache::getStatCacheData()->HasStat(nowcache)){
+        // the stat cache can not have the pending meta
+        return false;
+    }
+
+    AutoLock auto_lock(&pending_lock);
+
+    pending_meta_map_t::iterator iter = pendings.find(path);
+    if(pendings.end() == iter){
+        pending_meta_entry& entry = pendings[path];
+        entry.strpath  = strpath;
+        entry.nowcache = nowcache;
+        entry.meta     = meta;
+        entry.pid      = pid;
+        entry.date     = PendingMeta::GetNow();
+    }else{
+        iter->second.strpath  = strpath;
+        iter->second.nowcache = nowcache;
+        iter->second.meta     = meta;
+        iter->second.pid      = pid;
+    }
+    S3FS_PRN_INFO3("pending meta for [path=%s][count=%zu]", path, pendings.size());
+
+    return true;
+}
+
+//
+// Discard the pending meta for the path(and the paths under it).
+// This is called when the object is removed.
+//
+bool PendingMeta::Discard(const char* path, bool is_subdir)
+{
+    if(!path || '\0' == path[0]){
+        return false;
+    }
+    AutoLock auto_lock(&pending_lock);
+
+    std::string strpath = path;
+    std::string subdir  = strpath + "/";
+    for(pending_meta_map_t::iterator iter = pendings.begin(); iter != pendings.end(); ){
+        if(iter->first == strpath || (is_subdir && 0 == iter->first.compare(0, subdir.length(), subdir))){
+            S3FS_PRN_INFO3("discard pending meta for [path=%s]", iter->first.c_str());
+            pendings.erase(iter++);
+        }else{
+            ++iter;
+        }
+    }
+    return true;
+}
+
+int PendingMeta::PutMeta(const std::string& path, pending_meta_entry& entry)
+{
+    S3FS_PRN_INFO3("put pending meta for [path=%s]", path.c_str());
+
+    int result;
+    if(0 != (result = put_headers(entry.strpath.c_str(), entry.meta, true))){
+        S3FS_PRN_ERR("failed to put pending meta for [path=%s] by %d", path.c_str(), result);
+    }
+    StatCache::getStatCacheData()->DelStat(entry.nowcache);
+
+    return result;
+}
+
+int PendingMeta::FlushList(pending_meta_map_t& list)
+{
+    int result = 0;
+    for(pending_meta_map_t::iterator iter = list.begin(); iter != list.end(); ++iter){
+        int tmpresult;
+        if(0 != (tmpresult = PutMeta(iter->first, iter->second))){
+            result = tmpresult;
+        }
+    }
+    return result;
+}
+
+//
+// Put the pending meta for the path(and the paths under it).
+//
+int PendingMeta::Flush(const char* path, bool is_subdir)
+{
+    if(!path || '\0' == path[0]){
+        return -EINVAL;
+    }
+    pending_meta_map_t list;
+    {
+        AutoLock auto_lock(&pending_lock);
+        if(pendings.empty()){
+            return 0;
+        }
+        std::string strpath = path;
+        std::string subdir  = strpath + "/";
+        for(pending_meta_map_t::iterator iter = pendings.begin(); iter != pendings.end(); ){
+            if(iter->first == strpath || (is_subdir && 0 == iter->first.compare(0, subdir.length(), subdir))){
+                list[iter->first] = iter->second;
+                pendings.erase(iter++);
+            }else{
+                ++iter;
+            }
+        }
+    }
+    return FlushList(list);
+}
+
+//
+// Put the pending meta if the process is not the process which updated it.
+//
+int PendingMeta::FlushOtherProcess(const char* path, pid_t pid)
+{
+    if(!path || '\0' == path[0]){
+        return -EINVAL;
+    }
+    pending_meta_map_t list;
+    {
+        AutoLock auto_lock(&pending_lock);
+        pending_meta_map_t::iterator iter = pendings.find(path);
+        if(pendings.end() == iter || iter->second.pid == pid){
+            return 0;
+        }
+        list[iter->first] = iter->second;
+        pendings.erase(iter);
+    }
+    return FlushList(list);
+}
+
+int PendingMeta::FlushExpired()
+{
+    pending_meta_map_t list;
+    {
+        AutoLock auto_lock(&pending_lock);
+        time_t now = PendingMeta::GetNow();
+        for(pending_meta_map_t::iterator iter = pendings.begin(); iter != pendings.end(); ){
+            if(iter->second.date + PendingMeta::delay <= now){
+                list[iter->first] = iter->second;
+                pendings.erase(iter++);
+            }else{
+                ++iter;
+            }
+        }
+    }
+    return FlushList(list);
+}
+
+int PendingMeta::FlushAll()
+{
+    pending_meta_map_t list;
+    {
+        AutoLock auto_lock(&pending_lock);
+        list.swap(pendings);
+    }
+    return FlushList(list);
+}
+
+/*
+* Local variables:
+* tab-width: 4
+* c-basic-offset: 4
+* End:
+* vim600: expandtab sw=4 ts=4 fdm=marker
+* vim<600: expandtab sw=4 ts=4
+*/
@@ -0,0 +1,104 @@
+/*
+ * s3fs - FUSE-based file system backed by Amazon S3
+ *
+ * Copyright(C) 2007 Randy Rizun <rrizun@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef S3FS_METAPENDING_H_
+#define S3FS_METAPENDING_H_
+
+#include <pthread.h>
+#include <map>
+#include <string>
+
+#include "metaheader.h"
+
+//----------------------------------------------
+// Structure / Typedef
+//----------------------------------------------
+struct pending_meta_entry
+{
+    std::string strpath;        // object path for putting headers
+    std::string nowcache;       // stat cache key
+    headers_t   meta;           // all headers for putting(with x-amz-copy-source)
+    pid_t       pid;            // process which updated last
+    time_t      date;           // first updated time(monotonic)
+};
+
+typedef std::map<std::string, pending_meta_entry> pending_meta_map_t;
+
+//----------------------------------------------
+// Class PendingMeta
+//----------------------------------------------
+// This class holds the meta headers which are updated by chmod, chown and
+// utimens for the objects which are not opened, and puts them by one
+// request after the delay time.
+// The pending headers are put when the delay time passes, when the path
+// is flushed/released/opened, or when the other process gets attributes.
+// The stat cache has the pending headers until they are put.
+//
+class PendingMeta
+{
+    private:
+        static PendingMeta  singleton;
+        static time_t       delay;          // 0 means disabled
+
+        pthread_mutex_t     pending_lock;
+        pthread_cond_t      worker_cond;
+        pending_meta_map_t  pendings;
+        pthread_t           worker_thread;
+        bool                is_worker_run;
+
+    private:
+        static void* Worker(void* arg);
+        static time_t GetNow();
+
+        int PutMeta(const std::string& path, pending_meta_entry& entry);
+        int FlushList(pending_meta_map_t& list);
+
+    protected:
+        PendingMeta();
+        ~PendingMeta();
+
+    public:
+        // Reference singleton
+        static PendingMeta* get() { return &singleton; }
+
+        static time_t SetDelay(time_t sec);
+        static bool IsEnable() { return (0 < PendingMeta::delay); }
+
+        bool StartWorker();
+        bool StopWorker();
+
+        bool Add(const char* path, const std::string& strpath, const std::string& nowcache, const headers_t& meta, pid_t pid);
+        bool Discard(const char* path, bool is_subdir = false);
+        int Flush(const char* path, bool is_subdir = false);
+        int FlushOtherProcess(const char* path, pid_t pid);
+        int FlushExpired();
+        int FlushAll();
+};
+
+#endif // S3FS_METAPENDING_H_
+
+/*
+* Local variables:
+* tab-width: 4
+* c-basic-offset: 4
+* End:
+* vim600: expandtab sw=4 ts=4 fdm=marker
+* vim<600: expandtab sw=4 ts=4
+*/
@@ -42,7 +42,8 @@ typedef std::list<INCOMP_MPU_INFO>      incomp_mpu_list_t;
 enum utility_incomp_type{
     NO_UTILITY_MODE = 0,      // not utility mode
     INCOMP_TYPE_LIST,         // list of incomplete mpu
-    INCOMP_TYPE_ABORT         // delete incomplete mpu
+    INCOMP_TYPE_ABORT,        // delete incomplete mpu
+    CACHE_TYPE_WARM           // download objects into cache directory
 };
 
 extern utility_incomp_type utility_mode;
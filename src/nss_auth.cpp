@@ -150,6 +150,22 @@ size_t get_md5_digest_length()
     return MD5_LENGTH;
 }
 
+unsigned char* s3fs_md5(const unsigned char* data, size_t datalen)
+{
+    PK11Context*   md5ctx;
+    unsigned char* result;
+    unsigned int   md5outlen;
+
+    md5ctx = PK11_CreateDigestContext(SEC_OID_MD5);
+    PK11_DigestOp(md5ctx, data, datalen);
+
+    result = new unsigned char[get_md5_digest_length()];
+    PK11_DigestFinal(md5ctx, result, &md5outlen, get_md5_digest_length());
+    PK11_DestroyContext(md5ctx, PR_TRUE);
+
+    return result;
+}
+
 unsigned char* s3fs_md5_fd(int fd, off_t start, off_t size)
 {
     PK11Context*   md5ctx;
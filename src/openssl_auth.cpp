@@ -253,6 +253,20 @@ size_t get_md5_digest_length()
     return MD5_DIGEST_LENGTH;
 }
 
+unsigned char* s3fs_md5(const unsigned char* data, size_t datalen)
+{
+    MD5_CTX        md5ctx;
+    unsigned char* result;
+
+    MD5_Init(&md5ctx);
+    MD5_Update(&md5ctx, data, datalen);
+
+    result = new unsigned char[get_md5_digest_length()];
+    MD5_Final(result, &md5ctx);
+
+    return result;
+}
+
 unsigned char* s3fs_md5_fd(int fd, off_t start, off_t size)
 {
     MD5_CTX md5ctx;
@@ -46,6 +46,7 @@
 #include "s3fs_auth.h"
 #include "s3fs_help.h"
 #include "mpu_util.h"
+#include "metapending.h"
 
 //-------------------------------------------------------------------
 // Symbols
@@ -98,6 +99,16 @@ static bool support_compat_dir    = true;// default supports compatibility direc
 static int max_keys_list_object   = 1000;// default is 1000
 static off_t max_dirty_data       = 5LL * 1024LL * 1024LL * 1024LL;
 static bool use_wtf8              = false;
+static bool resolve_by_list       = false;// default resolves the object by HEAD requests
+static const int resolve_list_max_keys = 50;
+static bool prefetch_dir_stat     = false;// default does not prefetch the stats of directory on opendir
+static const size_t rename_parallel_count = 1000;
+static bool nomultidelete         = false;// default deletes multiple objects by DeleteObjects request
+static bool rmtree_xattr          = false;// default does not delete directory tree by setting xattr
+static bool copy_xattr            = false;// default does not copy object on the server side by setting xattr
+static std::list<std::string> warm_cache_paths;                // paths(keys or prefixes) for warming the cache in utility mode
+static const char* rmtree_xattr_name = "user.s3fs.rmtree";
+static const char* copy_xattr_name   = "user.s3fs.copyfrom";
 
 static const std::string allbucket_fields_type;              // special key for mapping(This name is absolutely not used as a bucket name)
 static const std::string keyval_fields_type    = "\t";       // special key for mapping(This name is absolutely not used as a bucket name)
@@ -107,7 +118,8 @@ static const std::string aws_secretkey         = "AWSSecretKey";
 //-------------------------------------------------------------------
 // Global functions : prototype
 //-------------------------------------------------------------------
-int put_headers(const char* path, headers_t& meta, bool is_copy, bool use_st_size = true);       // [NOTE] global function because this is called from FdEntity class
+int put_headers(const char* path, headers_t& meta, bool is_copy, bool use_st_size = true, bool update_cache_etag = true);       // [NOTE] global function because this is called from FdEntity class
+int delete_renamed_object(const char* path, const std::string& etag);                            // [NOTE] global function because this is called from FdEntity class
 
 //-------------------------------------------------------------------
 // Static functions : prototype
@@ -115,24 +127,34 @@ int put_headers(const char* path, headers_t& meta, bool is_copy, bool use_st_siz
 static bool is_special_name_folder_object(const char* path);
 static int chk_dir_object_type(const char* path, std::string& newpath, std::string& nowpath, std::string& nowcache, headers_t* pmeta = NULL, dirtype* pDirType = NULL);
 static int remove_old_type_dir(const std::string& path, dirtype type);
+static int resolve_object_by_list(const char* path, std::string& strpath, headers_t& meta, bool& isforce);
 static int get_object_attribute(const char* path, struct stat* pstbuf, headers_t* pmeta = NULL, bool overcheck = true, bool* pisforce = NULL, bool add_no_truncate_cache = false);
 static int check_object_access(const char* path, int mask, struct stat* pstbuf);
 static int check_object_owner(const char* path, struct stat* pstbuf);
 static int check_parent_object_access(const char* path, int mask);
 static int get_local_fent(AutoFdEntity& autoent, FdEntity **entity, const char* path, int flags = O_RDONLY, bool is_load = false);
-static bool multi_head_callback(S3fsCurl* s3fscurl);
+static bool multi_head_callback(S3fsCurl* s3fscurl, void* param);
 static S3fsCurl* multi_head_retry_callback(S3fsCurl* s3fscurl);
 static int readdir_multi_head(const char* path, const S3ObjList& head, void* buf, fuse_fill_dir_t filler);
 static int list_bucket(const char* path, S3ObjList& head, const char* delimiter, bool check_content_only = false);
 static int directory_empty(const char* path);
 static int rename_large_object(const char* from, const char* to);
 static int create_file_object(const char* path, mode_t mode, uid_t uid, gid_t gid);
+static void make_directory_object_meta(headers_t& meta, mode_t mode, time_t atime, time_t mtime, time_t ctime, uid_t uid, gid_t gid);
+static void add_directory_object_cache(const char* path, const headers_t& meta, bool is_empty);
 static int create_directory_object(const char* path, mode_t mode, time_t atime, time_t mtime, time_t ctime, uid_t uid, gid_t gid);
+static int create_directory_objects(const std::map<std::string, headers_t>& dirs);
+static int delete_objects(const std::list<std::string>& paths, std::map<std::string, int>& errors);
+static int delete_directory_tree(const char* path);
+static int copy_object_by_xattr(const char* to, const char* value, size_t size);
+static void set_rename_object_meta(const char* from, const char* to, headers_t& meta, bool update_ctime);
 static int rename_object(const char* from, const char* to, bool update_ctime);
 static int rename_object_nocopy(const char* from, const char* to, bool update_ctime);
-static int clone_directory_object(const char* from, const char* to, bool update_ctime);
 static int rename_directory(const char* from, const char* to);
 static int remote_mountpath_exists(const char* path);
+static int get_warm_cache_objects(const std::string& path, std::list<std::string>& objects);
+static int warm_cache_objects(const std::list<std::string>& objects, size_t& cached_count);
+static int s3fs_warm_cache();
 static void free_xattrs(xattrs_t& xattrs);
 static bool parse_xattr_keyval(const std::string& xattrpair, std::string& key, PXATTRVAL& pval);
 static size_t parse_xattrs(const std::string& strxattrs, xattrs_t& xattrs);
@@ -177,6 +199,7 @@ static int s3fs_fsync(const char* path, int datasync, struct fuse_file_info* fi)
 static int s3fs_release(const char* path, struct fuse_file_info* fi);
 static int s3fs_opendir(const char* path, struct fuse_file_info* fi);
 static int s3fs_readdir(const char* path, void* buf, fuse_fill_dir_t filler, off_t offset, struct fuse_file_info* fi);
+static int s3fs_releasedir(const char* path, struct fuse_file_info* fi);
 static int s3fs_access(const char* path, int mask);
 static void* s3fs_init(struct fuse_conn_info* conn);
 static void s3fs_destroy(void*);
@@ -339,6 +362,155 @@ static int remove_old_type_dir(const std::string& path, dirtype type)
     return 0;
 }
 
+//
+// Resolve the object for path by one list bucket request.
+//
+// The listing which has the prefix "path" and the delimiter "/" returns
+// "path" and "path_$folder$" as keys and "path/" as a common prefix, thus
+// all directory types can be found by one request. After that, s3fs sends
+// only one HEAD request to the found object for getting its meta headers.
+//
+// [NOTE]
+// If both of "path/" and "path_$folder$" are found, "path_$folder$" is
+// used, because "path/" in the common prefixes does not mean that the
+// "path/" object exists.
+// If the listing is truncated before the names which is needed for
+// resolving, this function gives up and returns -EAGAIN. Then the caller
+// should check the object by HEAD requests as same as before.
+//
+// return:  0        found, strpath is set the found object name and isforce
+//                   is set true when the directory does not have any object.
+//          -EPERM   found, but could not access it.
+//          -ENOENT  not found.
+//          -EAGAIN  could not resolve by the listing.
+//
+static int resolve_object_by_list(const char* path, std::string& strpath, headers_t& meta, bool& isforce)
+{
+    std::string s3_realpath = get_realpath(path);
+    std::string query;
+    S3fsCurl    s3fscurl;
+    xmlDocPtr   doc;
+    int         result;
+
+    S3FS_PRN_INFO3("[path=%s]", path);
+
+    // append parameters to query in alphabetical order
+    query += "delimiter=/&";
+    if(S3fsCurl::IsListObjectsV2()){
+        query += "list-type=2&";
+    }
+    query += "max-keys=" + str(resolve_list_max_keys);
+    query += "&prefix=" + urlEncode(s3_realpath.substr(1));
+
+    if(0 != (result = s3fscurl.ListBucketRequest(path, query.c_str()))){
+        S3FS_PRN_WARN("ListBucketRequest returns with error(%d), then check by head request.", result);
+        return -EAGAIN;
+    }
+    BodyData* body = s3fscurl.GetBodyData();
+    if(NULL == (doc = xmlReadMemory(body->str(), static_cast<int>(body->size()), "", NULL, 0))){
+        S3FS_PRN_ERR("xmlReadMemory returns with error.");
+        return -EAGAIN;
+    }
+    s3obj_list_t keys;
+    s3obj_list_t cprefixes;
+    if(0 != get_raw_objects_from_xml(doc, keys, cprefixes)){
+        S3FS_PRN_ERR("get_raw_objects_from_xml returns with error.");
+        S3FS_XMLFREEDOC(doc);
+        return -EAGAIN;
+    }
+    bool truncated = is_truncated(doc);
+    S3FS_XMLFREEDOC(doc);
+    s3fscurl.DestroyCurlHandle();
+
+    std::string objname    = s3_realpath.substr(1);
+    std::string dirname    = objname + "/";
+    std::string foldername = objname + "_$folder$";
+    std::string lastname;
+    bool        found_obj    = false;
+    bool        found_dir    = false;
+    bool        found_folder = false;
+
+    for(s3obj_list_t::const_iterator iter = keys.begin(); iter != keys.end(); ++iter){
+        if(*iter == objname){
+            found_obj = true;
+        }else if(*iter == dirname){
+            found_dir = true;
+        }else if(*iter == foldername){
+            found_folder = true;
+        }
+        if(lastname < *iter){
+            lastname = *iter;
+        }
+    }
+    for(s3obj_list_t::const_iterator iter = cprefixes.begin(); iter != cprefixes.end(); ++iter){
+        if(*iter == dirname){
+            found_dir = true;
+        }
+        if(lastname < *iter){
+            lastname = *iter;
+        }
+    }
+
+    // The names are listed in order, so the names which are not greater
+    // than the last name are decided even if the listing is truncated.
+    // "path" is always decided because it is the first name in the listing.
+    bool decided_dir    = !truncated || dirname <= lastname;
+    bool decided_folder = !truncated || foldername <= lastname;
+
+    if(found_obj){
+        strpath = path;
+        result  = s3fscurl.HeadRequest(strpath.c_str(), meta);
+        s3fscurl.DestroyCurlHandle();
+
+        if(-EPERM == result){
+            // same as get_object_attribute()
+            meta["x-amz-meta-mode"] = str(0);
+            return result;
+        }else if(0 != result){
+            return -EAGAIN;
+        }
+        if(support_compat_dir && is_need_check_obj_detail(meta)){
+            // check a case of that "object" does not have attribute and "object" is possible to be directory.
+            if(!decided_dir){
+                found_dir = (-ENOTEMPTY == directory_empty(strpath.c_str()));
+            }
+            if(found_dir){
+                strpath += "/";
+                isforce  = true;
+            }
+        }
+        return 0;
+    }
+
+    if(!decided_dir || (support_compat_dir && !decided_folder)){
+        return -EAGAIN;
+    }
+    if(support_compat_dir && found_folder){
+        strpath  = path;
+        strpath += "_$folder$";
+    }else if(found_dir){
+        strpath  = path;
+        strpath += "/";
+    }else{
+        return -ENOENT;
+    }
+
+    result = s3fscurl.HeadRequest(strpath.c_str(), meta);
+    s3fscurl.DestroyCurlHandle();
+
+    if(0 != result){
+        if(-ENOENT == result && support_compat_dir && found_dir){
+            // found "no dir object".
+            strpath  = path;
+            strpath += "/";
+            isforce  = true;
+            return 0;
+        }
+        return -EAGAIN;
+    }
+    return 0;
+}
+
 //
 // Get object attributes with stat cache.
 // This function is base for s3fs_getattr().
@@ -387,18 +559,37 @@ static int get_object_attribute(const char* path, struct stat* pstbuf, headers_t
     if(StatCache::getStatCacheData()->GetStat(strpath, pstat, pheader, overcheck, pisforce)){
         return 0;
     }
+    // the stats cache which has the pending meta is out, then put it before checking the object.
+    PendingMeta::get()->Flush(path);
+
     if(StatCache::getStatCacheData()->IsNoObjectCache(strpath)){
         // there is the path in the cache for no object, it is no object.
         return -ENOENT;
     }
+    if(StatCache::getStatCacheData()->IsNoObjectInDirList(strpath)){
+        // the parent directory was listed completely and it does not have the path.
+        return -ENOENT;
+    }
 
     // At first, check path
     strpath     = path;
-    result      = s3fscurl.HeadRequest(strpath.c_str(), (*pheader));
-    s3fscurl.DestroyCurlHandle();
+    result      = -EAGAIN;
+    if(resolve_by_list && overcheck && '/' != *strpath.rbegin() && std::string::npos == strpath.find("_$folder$", 0)){
+        // try to resolve all directory types by one listing
+        result = resolve_object_by_list(path, strpath, (*pheader), (*pisforce));
+    }
+    bool is_resolved = (-EAGAIN != result);
+    if(!is_resolved){
+        strpath = path;
+        result  = s3fscurl.HeadRequest(strpath.c_str(), (*pheader));
+        s3fscurl.DestroyCurlHandle();
+    }
 
     // if not found target path object, do over checking
-    if(-EPERM == result){
+    if(is_resolved){
+        // already resolved by listing
+
+    }else if(-EPERM == result){
         // [NOTE]
         // In case of a permission error, it exists in directory
         // file list but inaccessible. So there is a problem that
@@ -630,6 +821,24 @@ static int check_object_owner(const char* path, struct stat* pstbuf)
     return -EPERM;
 }
 
+//
+// Check accessing the directory by uid and gid with the access permission cache.
+//
+static int check_dir_object_access(const std::string& dir, int mask, const struct fuse_context* pcxt)
+{
+    int result;
+
+    if(StatCache::getStatCacheData()->GetAccess(dir, pcxt->uid, pcxt->gid, mask)){
+        return 0;
+    }
+    if(0 != (result = check_object_access(dir.c_str(), mask, NULL))){
+        return result;
+    }
+    StatCache::getStatCacheData()->AddAccess(dir, pcxt->uid, pcxt->gid, mask);
+
+    return 0;
+}
+
 //
 // Check accessing the parent directories of the object by uid and gid.
 //
@@ -637,6 +846,7 @@ static int check_parent_object_access(const char* path, int mask)
 {
     std::string parent;
     int result;
+    struct fuse_context* pcxt;
 
     S3FS_PRN_DBG("[path=%s]", path);
 
@@ -644,12 +854,15 @@ static int check_parent_object_access(const char* path, int mask)
         // path is mount point.
         return 0;
     }
+    if(NULL == (pcxt = fuse_get_context())){
+        return -EIO;
+    }
     if(X_OK == (mask & X_OK)){
         for(parent = mydirname(path); !parent.empty(); parent = mydirname(parent)){
             if(parent == "."){
                 parent = "/";
             }
-            if(0 != (result = check_object_access(parent.c_str(), X_OK, NULL))){
+            if(0 != (result = check_dir_object_access(parent, X_OK, pcxt))){
                 return result;
             }
             if(parent == "/" || parent == "."){
@@ -663,7 +876,7 @@ static int check_parent_object_access(const char* path, int mask)
         if(parent == "."){
             parent = "/";
         }
-        if(0 != (result = check_object_access(parent.c_str(), mask, NULL))){
+        if(0 != (result = check_dir_object_access(parent, mask, pcxt))){
             return result;
         }
     }
@@ -733,12 +946,56 @@ static int get_local_fent(AutoFdEntity& autoent, FdEntity **entity, const char*
     return 0;
 }
 
+//
+// The copy api does not change the data of the object, but the ETag may be
+// changed(ex. multipart copy). Then the cached ETag of the copy source is
+// updated by the ETag of the copied object at path, so that the cache is
+// not treated as stale.
+//
+static void update_copied_cache_etag(const char* path, const headers_t& meta, const std::string& src_etag)
+{
+    headers_t::const_iterator iter;
+    if(src_etag.empty() || meta.end() == (iter = meta.find("x-amz-copy-source"))){
+        return;
+    }
+
+    // the copy source is "<service path><bucket><mount prefix><path>"
+    std::string srcpath = urlDecode(iter->second);
+    std::string prefix  = service_path + bucket + mount_prefix;
+    if(0 != srcpath.compare(0, prefix.length(), prefix)){
+        return;
+    }
+    srcpath.erase(0, prefix.length());
+
+    // nothing to do if there is no cache of the copy source
+    std::string cache_path;
+    struct stat st;
+    if(!FdManager::HasOpenEntityFd(srcpath.c_str()) && (!FdManager::MakeCachePath(srcpath.c_str(), cache_path, false) || cache_path.empty() || 0 != stat(cache_path.c_str(), &st))){
+        return;
+    }
+
+    // get the ETag of the copied object
+    S3fsCurl  s3fscurl;
+    headers_t newmeta;
+    int       result;
+    if(0 != (result = s3fscurl.HeadRequest(path, newmeta))){
+        S3FS_PRN_WARN("could not get the ETag of copied object(%s) by %d, then the cache of %s may be reloaded.", path, result, srcpath.c_str());
+        return;
+    }
+    std::string new_etag = get_etag(newmeta);
+    if(!new_etag.empty() && new_etag != src_etag){
+        FdManager::get()->UpdateCacheETag(srcpath.c_str(), src_etag, new_etag);
+    }
+}
+
 //
 // create or update s3 meta
 // ow_sse_flg is for over writing sse header by use_sse option.
+// If update_cache_etag is true, the cached ETag of the copy source is updated
+// after copying. The caller which locks the entity must specify false.
 // @return fuse return code
 //
-int put_headers(const char* path, headers_t& meta, bool is_copy, bool use_st_size)
+int put_headers(const char* path, headers_t& meta, bool is_copy, bool use_st_size, bool update_cache_etag)
 {
     int         result;
     S3fsCurl    s3fscurl(true);
@@ -746,6 +1003,9 @@ int put_headers(const char* path, headers_t& meta, bool is_copy, bool use_st_siz
 
     S3FS_PRN_INFO2("[path=%s]", path);
 
+    // the ETag of the copy source before copying
+    std::string src_etag = (is_copy ? get_etag(meta) : std::string(""));
+
     // files larger than 5GB must be modified via the multipart interface
     // *** If there is not target object(a case of move command),
     //     get_object_attribute() returns error with initializing buf.
@@ -766,6 +1026,9 @@ int put_headers(const char* path, headers_t& meta, bool is_copy, bool use_st_siz
             return result;
         }
     }
+    if(is_copy && update_cache_etag){
+        update_copied_cache_etag(path, meta, src_etag);
+    }
     return 0;
 }
 
@@ -776,6 +1039,9 @@ static int s3fs_getattr(const char* _path, struct stat* stbuf)
 
     S3FS_PRN_INFO("[path=%s]", path);
 
+    // put the pending meta updated by the other process.
+    PendingMeta::get()->FlushOtherProcess(path, fuse_get_context()->pid);
+
     // check parent directory attribute.
     if(0 != (result = check_parent_object_access(path, X_OK))){
         return result;
@@ -1015,6 +1281,51 @@ static int s3fs_create(const char* _path, mode_t mode, struct fuse_file_info* fi
     return 0;
 }
 
+static void make_directory_object_meta(headers_t& meta, mode_t mode, time_t atime, time_t mtime, time_t ctime, uid_t uid, gid_t gid)
+{
+    meta.clear();
+    meta["x-amz-meta-uid"]   = str(uid);
+    meta["x-amz-meta-gid"]   = str(gid);
+    meta["x-amz-meta-mode"]  = str(mode);
+    meta["x-amz-meta-atime"] = str(atime);
+    meta["x-amz-meta-mtime"] = str(mtime);
+    meta["x-amz-meta-ctime"] = str(ctime);
+}
+
+//
+// Cache the stats of the directory object which has just been created.
+//
+// [NOTE]
+// Creating a directory tree(ex. mkdir -p) checks the parent and the
+// new directory at each level, and they need some HEAD requests if the
+// stats are not cached. If the created directory is empty, the empty
+// listing is also cached, then the lookups for its children do not
+// need any requests.(only when the listing cache is enabled)
+//
+static void add_directory_object_cache(const char* path, const headers_t& meta, bool is_empty)
+{
+    std::string strpath = path;
+    std::string strdir  = strpath;
+    if('/' != *strdir.rbegin()){
+        strdir += "/";
+    }else{
+        strpath.erase(strpath.length() - 1);
+    }
+    headers_t stmeta         = meta;
+    stmeta["Content-Type"]   = S3fsCurl::LookupMimeType(strdir);
+    stmeta["Content-Length"] = "0";
+
+    // removes the stats and the no object cache of both "dir" and "dir/"
+    StatCache::getStatCacheData()->DelStat(strpath);
+    if(!StatCache::getStatCacheData()->AddStat(strdir, stmeta)){
+        return;
+    }
+    if(is_empty){
+        std::list<std::string> names;
+        StatCache::getStatCacheData()->AddDirList(strdir, names, StatCache::getStatCacheData()->GetDirListGeneration());
+    }
+}
+
 static int create_directory_object(const char* path, mode_t mode, time_t atime, time_t mtime, time_t ctime, uid_t uid, gid_t gid)
 {
     S3FS_PRN_INFO1("[path=%s][mode=%04o][atime=%lld][mtime=%lld][ctime=%lld][uid=%u][gid=%u]", path, mode, static_cast<long long>(atime), static_cast<long long>(ctime), static_cast<long long>(mtime), (unsigned int)uid, (unsigned int)gid);
@@ -1028,17 +1339,86 @@ static int create_directory_object(const char* path, mode_t mode, time_t atime,
     }
 
     headers_t meta;
-    meta["x-amz-meta-uid"]   = str(uid);
-    meta["x-amz-meta-gid"]   = str(gid);
-    meta["x-amz-meta-mode"]  = str(mode);
-    meta["x-amz-meta-atime"] = str(atime);
-    meta["x-amz-meta-mtime"] = str(mtime);
-    meta["x-amz-meta-ctime"] = str(ctime);
+    make_directory_object_meta(meta, mode, atime, mtime, ctime, uid, gid);
 
     S3fsCurl s3fscurl;
     return s3fscurl.PutRequest(tpath.c_str(), meta, -1);    // fd=-1 means for creating zero byte object.
 }
 
+static bool multi_mkdir_callback(S3fsCurl* s3fscurl, void* param)
+{
+    if(!s3fscurl || !param){
+        return false;
+    }
+    if(0 != s3fscurl->MapPutErrorResponse(0)){
+        return false;
+    }
+    std::set<std::string>* pdonelist = static_cast<std::set<std::string>*>(param);
+    pdonelist->insert(s3fscurl->GetPath());
+    return true;
+}
+
+//
+// Create directory objects by parallel requests
+//
+// [NOTE]
+// The directory objects in a tree do not depend on each other on the
+// server, thus all levels of the tree are created at the same time.
+// The key of dirs is the directory path(without "/"), and the value is
+// the meta headers for it. The directories which are failed in parallel
+// requests are created one by one, and the stats of all created
+// directories are cached.
+//
+static int create_directory_objects(const std::map<std::string, headers_t>& dirs)
+{
+    std::set<std::string> donelist;
+    int                   result;
+
+    S3FS_PRN_INFO1("[count=%zu]", dirs.size());
+
+    {
+        S3fsMultiCurl curlmulti(S3fsCurl::GetMaxMultiRequest());
+        curlmulti.SetSuccessCallback(multi_mkdir_callback);
+        curlmulti.SetSuccessCallbackParam(&donelist);
+
+        for(std::map<std::string, headers_t>::const_iterator iter = dirs.begin(); iter != dirs.end(); ++iter){
+            std::string tpath = iter->first + "/";
+            headers_t   meta  = iter->second;
+
+            S3fsCurl* s3fscurl = new S3fsCurl();
+            if(!s3fscurl->PrePutHeadRequest(tpath.c_str(), meta, false)){       // not copy, thus zero byte object
+                S3FS_PRN_WARN("Could not make curl object for creating directory(%s).", tpath.c_str());
+                delete s3fscurl;
+                continue;
+            }
+            if(!curlmulti.SetS3fsCurlObject(s3fscurl)){
+                S3FS_PRN_WARN("Could not make curl object into multi curl(%s).", tpath.c_str());
+                delete s3fscurl;
+                continue;
+            }
+        }
+        if(0 != (result = curlmulti.Request())){
+            S3FS_PRN_WARN("error occurred in multi request for creating directories(errno=%d), but continue...", result);
+        }
+    }
+
+    // check the result, and create remaining directories one by one
+    for(std::map<std::string, headers_t>::const_iterator iter = dirs.begin(); iter != dirs.end(); ++iter){
+        std::string tpath = iter->first + "/";
+        if(donelist.end() == donelist.find(get_realpath(tpath.c_str()))){
+            headers_t meta = iter->second;
+            S3fsCurl  s3fscurl;
+            if(0 != (result = s3fscurl.PutRequest(tpath.c_str(), meta, -1))){
+                S3FS_PRN_ERR("could not create directory object(%s): result=%d", tpath.c_str(), result);
+                StatCache::getStatCacheData()->DelStat(iter->first);
+                return result;
+            }
+        }
+        add_directory_object_cache(iter->first.c_str(), iter->second, false);
+    }
+    return 0;
+}
+
 static int s3fs_mkdir(const char* _path, mode_t mode)
 {
     WTF8_ENCODE(path)
@@ -1062,9 +1442,14 @@ static int s3fs_mkdir(const char* _path, mode_t mode)
         return result;
     }
     time_t now = time(NULL);
-    result = create_directory_object(path, mode, now, now, now, pcxt->uid, pcxt->gid);
-
-    StatCache::getStatCacheData()->DelStat(path);
+    if(0 == (result = create_directory_object(path, mode, now, now, now, pcxt->uid, pcxt->gid))){
+        // cache the new directory for creating its children
+        headers_t meta;
+        make_directory_object_meta(meta, mode, now, now, now, pcxt->uid, pcxt->gid);
+        add_directory_object_cache(path, meta, true);
+    }else{
+        StatCache::getStatCacheData()->DelStat(path);
+    }
     S3FS_MALLOCTRIM(0);
 
     return result;
@@ -1080,16 +1465,63 @@ static int s3fs_unlink(const char* _path)
     if(0 != (result = check_parent_object_access(path, W_OK | X_OK))){
         return result;
     }
+    PendingMeta::get()->Discard(path);
+
     S3fsCurl s3fscurl;
     result = s3fscurl.DeleteRequest(path);
     StatCache::getStatCacheData()->DelStat(path);
     StatCache::getStatCacheData()->DelSymlink(path);
     FdManager::DeleteCacheFile(path);
+    FdManager::GetMemoryCache()->Remove(path);
     S3FS_MALLOCTRIM(0);
 
     return result;
 }
 
+//
+// Remove the old object which was renamed in local, after the object at
+// the new path has been uploaded.
+// If the old object has been changed(created again) since renaming, it
+// is not removed.
+//
+int delete_renamed_object(const char* path, const std::string& etag)
+{
+    int result;
+
+    S3FS_PRN_INFO("[path=%s][etag=%s]", path, etag.c_str());
+
+    if(!etag.empty()){
+        headers_t meta;
+        S3fsCurl  s3fscurl;
+        if(0 != (result = s3fscurl.HeadRequest(path, meta))){
+            // already removed
+            return (-ENOENT == result ? 0 : result);
+        }
+        if(etag != get_etag(meta)){
+            S3FS_PRN_INFO("old object(%s) was changed after renaming, so it is not removed.", path);
+            return 0;
+        }
+    }
+    PendingMeta::get()->Discard(path);
+
+    S3fsCurl s3fscurl;
+    result = s3fscurl.DeleteRequest(path);
+    StatCache::getStatCacheData()->DelStat(path);
+    StatCache::getStatCacheData()->DelSymlink(path);
+
+    // [NOTE]
+    // A new file may be opened at the old path after renaming, then its
+    // cache file must not be removed. This is called while the entity of
+    // the new path is locked, so fd_manager_lock is not waited for and the
+    // cache file is kept if it can not be checked.
+    //
+    if(!FdManager::HasOpenEntityFd(path, true)){
+        FdManager::DeleteCacheFile(path);
+        FdManager::GetMemoryCache()->Remove(path);
+    }
+    return result;
+}
+
 static int directory_empty(const char* path)
 {
     int result;
@@ -1122,11 +1554,37 @@ static int s3fs_rmdir(const char* _path)
     if(directory_empty(path) != 0){
         return -ENOTEMPTY;
     }
+    PendingMeta::get()->Discard(path);
 
     strpath = path;
     if('/' != *strpath.rbegin()){
         strpath += "/";
     }
+    if(!nomultidelete){
+        // [NOTE]
+        // Collect "dir/", "dir" and "dir_$folder$" objects, and delete
+        // them by one DeleteObjects request.
+        //
+        std::list<std::string>     paths;
+        std::map<std::string, int> errors;
+        paths.push_back(strpath);
+
+        std::string dirpath = strpath.substr(0, strpath.length() - 1);
+        StatCache::getStatCacheData()->DelStat(strpath.c_str());
+        if(0 == get_object_attribute(dirpath.c_str(), &stbuf, NULL, false) && S_ISDIR(stbuf.st_mode)){
+            paths.push_back(dirpath);
+        }
+        if(is_special_name_folder_object(dirpath.c_str())){
+            paths.push_back(dirpath + "_$folder$");
+        }
+        result = delete_objects(paths, errors);
+        for(std::list<std::string>::const_iterator iter = paths.begin(); iter != paths.end(); ++iter){
+            StatCache::getStatCacheData()->DelStat(iter->c_str());
+        }
+        S3FS_MALLOCTRIM(0);
+
+        return result;
+    }
     S3fsCurl s3fscurl;
     result = s3fscurl.DeleteRequest(strpath.c_str());
     s3fscurl.DestroyCurlHandle();
@@ -1231,10 +1689,21 @@ static int s3fs_symlink(const char* _from, const char* _to)
     return result;
 }
 
+static void set_rename_object_meta(const char* from, const char* to, headers_t& meta, bool update_ctime)
+{
+    std::string s3_realpath = get_realpath(from);
+
+    if(update_ctime){
+        meta["x-amz-meta-ctime"]     = str(time(NULL));
+    }
+    meta["x-amz-copy-source"]        = urlEncode(service_path + bucket + s3_realpath);
+    meta["Content-Type"]             = S3fsCurl::LookupMimeType(std::string(to));
+    meta["x-amz-metadata-directive"] = "REPLACE";
+}
+
 static int rename_object(const char* from, const char* to, bool update_ctime)
 {
     int         result;
-    std::string s3_realpath;
     headers_t   meta;
     struct stat buf;
 
@@ -1251,14 +1720,7 @@ static int rename_object(const char* from, const char* to, bool update_ctime)
     if(0 != (result = get_object_attribute(from, &buf, &meta))){
         return result;
     }
-    s3_realpath = get_realpath(from);
-
-    if(update_ctime){
-        meta["x-amz-meta-ctime"]     = str(time(NULL));
-    }
-    meta["x-amz-copy-source"]        = urlEncode(service_path + bucket + s3_realpath);
-    meta["Content-Type"]             = S3fsCurl::LookupMimeType(std::string(to));
-    meta["x-amz-metadata-directive"] = "REPLACE";
+    set_rename_object_meta(from, to, meta, update_ctime);
 
     // [NOTE]
     // If it has a cache, open it first and leave it open until rename.
@@ -1365,6 +1827,97 @@ static int rename_object_nocopy(const char* from, const char* to, bool update_ct
     return result;
 }
 
+//
+// Rename the opened and modified file only in local.
+//
+// [NOTE]
+// Some applications save a file by writing a temporary file and renaming
+// it. If the file is flushed before renaming, it is uploaded to the old
+// path and then copied to the new path. To avoid this, the file is only
+// renamed in local and it is uploaded to the new path once at the next
+// flush. If the old object exists on the server, the file is uploaded to
+// the new path at once and then the old object is removed, so that the
+// old path is not seen after renaming.
+// If the file can not be renamed in local, this returns -ENOTSUP and the
+// caller should rename it by the normal way.
+//
+static int rename_opened_object_local(const char* from, const char* to, bool update_ctime)
+{
+    int result;
+
+    S3FS_PRN_INFO1("[from=%s][to=%s]", from , to);
+
+    AutoFdEntity autoent;
+    FdEntity*    ent;
+    if(NULL == (ent = autoent.OpenExistFdEntity(from, O_RDWR)) || !ent->IsModified()){
+        return -ENOTSUP;
+    }
+    bool from_exist = ent->HasRemoteObject();
+    bool to_exist   = (0 == get_object_attribute(to, NULL, NULL));
+
+    // [NOTE]
+    // The old object is removed after the new object is uploaded, and it
+    // is not removed if it is changed until then. So its ETag is kept.
+    //
+    std::string from_etag;
+    if(from_exist){
+        headers_t meta;
+        S3fsCurl  s3fscurl;
+        if(0 == (result = s3fscurl.HeadRequest(from, meta))){
+            from_etag = get_etag(meta);
+        }else if(-ENOENT == result){
+            from_exist = false;
+        }else{
+            S3FS_PRN_INFO("could not get old object(%s) by %d, thus it is renamed by uploading.", from, result);
+            return -ENOTSUP;
+        }
+    }
+
+    // Set all area modified and the header(this does not change the entity if it fails)
+    if(0 != (result = ent->PrepareLocalRename(to, from_exist, from_etag))){
+        S3FS_PRN_INFO("could not rename file(%s) in local(errno=%d), thus it is renamed by uploading.", from, result);
+        return -ENOTSUP;
+    }
+    if(update_ctime){
+        struct timespec ts = {time(NULL), 0};
+        ent->SetCtime(ts);
+    }
+
+    // rename entity and cache file
+    StatCache::getStatCacheData()->DelStat(to);
+    FdManager::get()->Rename(from, to);
+    ent->SetRemoteObject(to_exist);
+
+    // the old object is not seen until it is removed after uploading.
+    StatCache::getStatCacheData()->DelStat(from);
+    StatCache::getStatCacheData()->DelSymlink(from);
+    if(from_exist){
+        StatCache::getStatCacheData()->AddNoObjectCache(std::string(from));
+
+        // upload the new object and remove the old object(in RowFlush)
+        if(0 != (result = ent->Flush(autoent.GetPseudoFd(), true))){
+            S3FS_PRN_ERR("could not upload renamed file(%s) to remove old object(%s), errno=%d", to, from, result);
+            return result;
+        }
+        return 0;
+    }
+
+    // [NOTE]
+    // The new object does not exist on the server until the flush, thus
+    // the stats are cached with no truncate flag as same as creating file.
+    //
+    headers_t meta;
+    off_t     size = 0;
+    ent->GetOrgMeta(meta);
+    if(ent->GetSize(size)){
+        meta["Content-Length"] = str(size);
+    }
+    if(!StatCache::getStatCacheData()->AddStat(to, meta, false, true)){
+        return -EIO;
+    }
+    return 0;
+}
+
 static int rename_large_object(const char* from, const char* to)
 {
     int         result;
@@ -1400,24 +1953,465 @@ static int rename_large_object(const char* from, const char* to)
     return result;
 }
 
-static int clone_directory_object(const char* from, const char* to, bool update_ctime)
+//
+// Parallel rename for the files in the directory
+//
+// [NOTE]
+// The files are renamed by parallel server side copy requests, and the
+// copied files are removed by parallel delete requests. The large files
+// are copied by multipart copy requests, and the parts of them are also
+// requested in parallel under the parallel_count budget. The files which
+// are failed in parallel requests are renamed by rename_object one by one.
+// The cache files of renamed files are not renamed, they are removed.
+//
+static bool multi_rename_copy_callback(S3fsCurl* s3fscurl, void* param)
+{
+    if(!s3fscurl || !param){
+        return false;
+    }
+    // PUT(copy) returns 200 status code with error body.
+    if(0 != s3fscurl->MapPutErrorResponse(0)){
+        return false;
+    }
+    std::set<std::string>* pdonelist = static_cast<std::set<std::string>*>(param);
+    pdonelist->insert(s3fscurl->GetPath());
+    return true;
+}
+
+static bool multi_rename_delete_callback(S3fsCurl* s3fscurl, void* param)
+{
+    if(!s3fscurl || !param){
+        return false;
+    }
+    std::set<std::string>* pdonelist = static_cast<std::set<std::string>*>(param);
+    pdonelist->insert(s3fscurl->GetPath());
+    return true;
+}
+
+//
+// Delete objects by DeleteObjects requests
+//
+// [NOTE]
+// The paths are divided into bundles of MAX_DELETE_OBJECTS_COUNT, and
+// the bundles are requested in parallel. The paths which could not be
+// deleted by them(ex. the request failed, or the storage does not support
+// DeleteObjects) are retried by DeleteRequest one by one. The paths which
+// could not be deleted at last are set to errors with errno.
+// This function does not update any caches.
+//
+static int delete_objects(const std::list<std::string>& paths, std::map<std::string, int>& errors)
+{
+    int result;
+
+    S3FS_PRN_INFO1("[count=%zu]", paths.size());
+
+    if(0 == (result = S3fsCurl::ParallelDeleteObjectsRequest(paths, errors))){
+        return 0;
+    }
+    S3FS_PRN_WARN("DeleteObjects requests returned error(%d), then retry to delete %zu objects one by one.", result, errors.size());
+
+    std::map<std::string, int> remaining;
+    result = 0;
+    for(std::map<std::string, int>::const_iterator iter = errors.begin(); iter != errors.end(); ++iter){
+        S3fsCurl s3fscurl;
+        int      result2 = s3fscurl.DeleteRequest(iter->first.c_str());
+        if(0 != result2 && -ENOENT != result2){
+            S3FS_PRN_ERR("could not delete object(%s) by DeleteRequest(%d).", iter->first.c_str(), result2);
+            remaining[iter->first] = result2;
+            result                 = result2;
+        }
+    }
+    errors.swap(remaining);
+
+    return result;
+}
+
+//
+// Delete all objects under the directory and the directory itself.
+//
+// [NOTE]
+// This lists the objects without delimiter page by page, and deletes
+// each collected bundle by delete_objects(). It does not
+// check the permission of each object under the directory, so it is
+// enabled only by enable_rmtree_xattr option.
+//
+static int delete_directory_tree(const char* path)
 {
-    int result = -1;
+    int         result;
     struct stat stbuf;
 
-    S3FS_PRN_INFO1("[from=%s][to=%s]", from, to);
+    S3FS_PRN_INFO1("[path=%s]", path);
 
-    // get target's attributes
-    if(0 != (result = get_object_attribute(from, &stbuf))){
+    if(0 == strcmp(path, "/")){
+        S3FS_PRN_ERR("Could not delete the tree of mount point.");
+        return -EPERM;
+    }
+    if(nomultidelete){
+        S3FS_PRN_ERR("Could not delete the tree without DeleteObjects request(nomultidelete).");
+        return -ENOTSUP;
+    }
+    if(0 != (result = check_parent_object_access(path, W_OK | X_OK))){
+        return result;
+    }
+    if(0 != (result = check_object_access(path, W_OK | X_OK, &stbuf))){
         return result;
     }
-    result = create_directory_object(to, stbuf.st_mode, stbuf.st_atime, stbuf.st_mtime, (update_ctime ? time(NULL) : stbuf.st_ctime), stbuf.st_uid, stbuf.st_gid);
+    if(!S_ISDIR(stbuf.st_mode)){
+        return -ENOTDIR;
+    }
+    if(FdManager::HasOpenEntityFdInDir(path)){
+        S3FS_PRN_WARN("There are opened files under the directory(%s).", path);
+        return -EBUSY;
+    }
 
-    StatCache::getStatCacheData()->DelStat(to);
+    std::string s3_prefix = get_realpath(path).substr(1) + "/";
+    std::string query_prefix = "&prefix=" + urlEncode(s3_prefix);
+    std::string next_continuation_token;
+    std::string next_marker;
+    size_t      max_bundle = S3fsCurl::MAX_DELETE_OBJECTS_COUNT * static_cast<size_t>(S3fsCurl::GetMaxMultiRequest());
+    size_t      deleted    = 0;
+    bool        truncated  = true;
+
+    std::list<std::string> paths;
+    while(truncated || !paths.empty()){
+        if(truncated){
+            // append parameters to query in alphabetical order
+            std::string each_query;
+            if(!next_continuation_token.empty()){
+                each_query += "continuation-token=" + urlEncode(next_continuation_token) + "&";
+                next_continuation_token = "";
+            }
+            if(S3fsCurl::IsListObjectsV2()){
+                each_query += "list-type=2&";
+            }
+            if(!next_marker.empty()){
+                each_query += "marker=" + urlEncode(next_marker) + "&";
+                next_marker = "";
+            }
+            each_query += "max-keys=" + str(max_keys_list_object);
+            each_query += query_prefix;
+
+            S3fsCurl  s3fscurl;
+            xmlDocPtr doc;
+            if(0 != (result = s3fscurl.ListBucketRequest(path, each_query.c_str()))){
+                S3FS_PRN_ERR("ListBucketRequest returns with error(%d).", result);
+                break;
+            }
+            BodyData* body = s3fscurl.GetBodyData();
+            if(NULL == (doc = xmlReadMemory(body->str(), static_cast<int>(body->size()), "", NULL, 0))){
+                S3FS_PRN_ERR("xmlReadMemory returns with error.");
+                result = -EIO;
+                break;
+            }
+            s3obj_list_t keys;
+            s3obj_list_t cprefixes;
+            if(0 != get_raw_objects_from_xml(doc, keys, cprefixes)){
+                S3FS_PRN_ERR("get_raw_objects_from_xml returns with error.");
+                S3FS_XMLFREEDOC(doc);
+                result = -EIO;
+                break;
+            }
+            if(true == (truncated = is_truncated(doc))){
+                xmlChar* tmpch;
+                if(NULL != (tmpch = get_next_continuation_token(doc))){
+                    next_continuation_token = (char*)tmpch;
+                    xmlFree(tmpch);
+                }else if(NULL != (tmpch = get_next_marker(doc))){
+                    next_marker = (char*)tmpch;
+                    xmlFree(tmpch);
+                }
+                if(next_continuation_token.empty() && next_marker.empty()){
+                    // Without delimiter, the last key can be used for next marker.
+                    if(keys.empty()){
+                        S3FS_PRN_WARN("Could not find next marker, thus break loop.");
+                        truncated = false;
+                    }else{
+                        next_marker = keys.back();
+                    }
+                }
+            }
+            S3FS_XMLFREEDOC(doc);
+            s3fscurl.DestroyCurlHandle();
+
+            for(s3obj_list_t::const_iterator iter = keys.begin(); iter != keys.end(); ++iter){
+                std::string objpath = ("/" + *iter).substr(mount_prefix.length());
+                paths.push_back(objpath);
+            }
+        }
+        if(paths.empty() || (truncated && paths.size() < max_bundle)){
+            continue;
+        }
+
+        std::map<std::string, int> errors;
+        if(0 != (result = delete_objects(paths, errors))){
+            S3FS_PRN_ERR("failed to delete %zu objects under %s(%d).", errors.size(), path, result);
+            break;
+        }
+        deleted += paths.size();
+        paths.clear();
+        S3FS_MALLOCTRIM(0);
+    }
+    PendingMeta::get()->Discard(path);
+
+    // the caches under the directory are invalid even if failed on the way
+    StatCache::getStatCacheData()->DelStatTree(path);
+    FdManager::DeleteCacheTree(path);
+
+    if(0 != result){
+        return result;
+    }
+    S3FS_PRN_INFO("deleted %zu objects under the directory(%s).", deleted, path);
+
+    // [NOTE]
+    // The "dir/" object has been deleted with the objects under it, so
+    // only "dir" and "dir_$folder$" objects(made by old versions or other
+    // tools) are deleted here if they exist.
+    //
+    std::string dirpath = path;
+    if('/' == *dirpath.rbegin()){
+        dirpath.erase(dirpath.length() - 1);
+    }
+    if(0 == get_object_attribute(dirpath.c_str(), &stbuf, NULL, false) && S_ISDIR(stbuf.st_mode)){
+        paths.push_back(dirpath);
+    }
+    if(is_special_name_folder_object(dirpath.c_str())){
+        paths.push_back(dirpath + "_$folder$");
+    }
+    if(!paths.empty()){
+        std::map<std::string, int> errors;
+        result = delete_objects(paths, errors);
+        for(std::list<std::string>::const_iterator iter = paths.begin(); iter != paths.end(); ++iter){
+            StatCache::getStatCacheData()->DelStat(iter->c_str());
+        }
+    }
+    StatCache::getStatCacheData()->DelStat(dirpath + "/");
 
     return result;
 }
 
+//
+// Copy the object on the server side into the destination file, which is
+// triggered by setting the special extended attribute to the destination
+// as "setfattr -n user.s3fs.copyfrom -v /src dst". The value is the path
+// of the source file from the mount point.
+//
+// [NOTE]
+// The copy_file_range operation is not in the FUSE 2.6 API which s3fs
+// uses, so the server side copy is triggered by this xattr. The object is
+// copied by CopyObject, or by UploadPartCopy when it is larger than
+// multipart_threshold. The destination keeps its own meta(mode, owner and
+// xattrs), and only its contents are replaced. This is enabled only by
+// enable_copy_xattr option.
+//
+static int copy_object_by_xattr(const char* to, const char* value, size_t size)
+{
+    int         result;
+    struct stat st;
+    struct stat dst_st;
+    headers_t   meta;
+
+    if(!value || 0 == size || '/' != value[0]){
+        S3FS_PRN_ERR("The value of %s must be the path of the source file from the mount point.", copy_xattr_name);
+        return -EINVAL;
+    }
+    // the value may be terminated by '\0'
+    std::string from = std::string(value, size).c_str();
+
+    S3FS_PRN_INFO1("[from=%s][to=%s]", from.c_str(), to);
+
+    if(nocopyapi){
+        S3FS_PRN_ERR("Could not copy the object without copy api(nocopyapi).");
+        return -ENOTSUP;
+    }
+    if(from == to){
+        return -EINVAL;
+    }
+    if(0 != (result = check_parent_object_access(from.c_str(), X_OK))){
+        return result;
+    }
+    if(0 != (result = check_object_access(from.c_str(), R_OK, &st))){
+        return result;
+    }
+    if(S_ISDIR(st.st_mode)){
+        return -EISDIR;
+    }
+    if(!S_ISREG(st.st_mode)){
+        return -EINVAL;
+    }
+    if(0 != (result = check_object_access(to, W_OK, &dst_st))){
+        return result;
+    }
+    if(!S_ISREG(dst_st.st_mode)){
+        return -EINVAL;
+    }
+
+    // the source must be uploaded, and the destination must not be opened
+    {
+        AutoFdEntity autoent;
+        FdEntity*    ent;
+        if(NULL != (ent = autoent.OpenExistFdEntity(from.c_str())) && ent->IsModified()){
+            S3FS_PRN_WARN("Could not copy the modified file(%s) before it is flushed.", from.c_str());
+            return -EBUSY;
+        }
+    }
+    if(FdManager::HasOpenEntityFd(to)){
+        S3FS_PRN_WARN("Could not copy to the opened file(%s).", to);
+        return -EBUSY;
+    }
+
+    // copy with the meta of the destination
+    PendingMeta::get()->Flush(to);
+    if(0 != (result = get_object_attribute(to, NULL, &meta))){
+        return result;
+    }
+    std::string strnow               = str(time(NULL));
+    meta["Content-Length"]           = str(st.st_size);
+    meta["x-amz-meta-mtime"]         = strnow;
+    meta["x-amz-meta-ctime"]         = strnow;
+    meta["x-amz-copy-source"]        = urlEncode(service_path + bucket + get_realpath(from.c_str()));
+    meta["x-amz-metadata-directive"] = "REPLACE";
+
+    if(0 != (result = put_headers(to, meta, true, /* use_st_size= */ false, /* update_cache_etag= */ false))){
+        S3FS_PRN_ERR("failed to copy object(%s) to (%s) by %d", from.c_str(), to, result);
+        return result;
+    }
+
+    // the contents of the destination are replaced
+    StatCache::getStatCacheData()->DelStat(to);
+    FdManager::DeleteCacheFile(to);
+    FdManager::GetMemoryCache()->Remove(to);
+
+    return 0;
+}
+
+static int multi_rename_files(std::vector<MVNODE*>& nodes)
+{
+    std::set<std::string> donelist;
+    std::vector<MVNODE*>  copied;
+    int                   result;
+
+    S3FS_PRN_INFO1("[count=%zu]", nodes.size());
+
+    // copy objects
+    {
+        S3fsMultiCurl         curlmulti(S3fsCurl::GetMaxMultiRequest());
+        multipart_copy_list_t copylist;
+        curlmulti.SetSuccessCallback(multi_rename_copy_callback);
+        curlmulti.SetSuccessCallbackParam(&donelist);
+
+        for(std::vector<MVNODE*>::iterator iter = nodes.begin(); iter != nodes.end(); ++iter){
+            MVNODE*     mn_cur = *iter;
+            struct stat stbuf;
+            headers_t   meta;
+
+            if(0 != get_object_attribute(mn_cur->old_path, &stbuf, &meta)){
+                continue;   // retry by rename_object
+            }
+            set_rename_object_meta(mn_cur->old_path, mn_cur->new_path, meta, false);     // keep ctime
+
+            if(!nomultipart && stbuf.st_size >= singlepart_copy_limit){
+                // large file is copied by multipart copy requests
+                copylist.push_back(multipart_copy_info(mn_cur->old_path, mn_cur->new_path, meta, stbuf.st_size));
+                continue;
+            }
+
+            S3fsCurl* s3fscurl = new S3fsCurl(true);
+            if(!s3fscurl->PrePutHeadRequest(mn_cur->new_path, meta, true)){
+                S3FS_PRN_WARN("Could not make curl object for copy request(%s).", mn_cur->new_path);
+                delete s3fscurl;
+                continue;
+            }
+            if(!curlmulti.SetS3fsCurlObject(s3fscurl)){
+                S3FS_PRN_WARN("Could not make curl object into multi curl(%s).", mn_cur->new_path);
+                delete s3fscurl;
+                continue;
+            }
+        }
+        if(0 != (result = curlmulti.Request())){
+            S3FS_PRN_WARN("error occurred in multi copy request(errno=%d), but continue...", result);
+        }
+
+        if(!copylist.empty()){
+            if(0 != (result = S3fsCurl::ParallelMultipartCopyRequest(copylist))){
+                S3FS_PRN_WARN("error occurred in multipart copy request(errno=%d), but continue...", result);
+            }
+            for(multipart_copy_list_t::const_iterator citer = copylist.begin(); citer != copylist.end(); ++citer){
+                if(0 == citer->result){
+                    donelist.insert(get_realpath(citer->to.c_str()));
+                }
+            }
+        }
+    }
+
+    // check the result of copying, and rename remaining objects one by one
+    for(std::vector<MVNODE*>::iterator iter = nodes.begin(); iter != nodes.end(); ++iter){
+        MVNODE* mn_cur = *iter;
+        if(donelist.end() != donelist.find(get_realpath(mn_cur->new_path))){
+            copied.push_back(mn_cur);
+        }else{
+            if(0 != (result = rename_object(mn_cur->old_path, mn_cur->new_path, false))){    // keep ctime
+                S3FS_PRN_ERR("rename_object returned an error(%d)", result);
+                return result;
+            }
+        }
+    }
+    donelist.clear();
+
+    // delete copied objects
+    if(!nomultidelete){
+        std::list<std::string>     paths;
+        std::map<std::string, int> errors;
+        for(std::vector<MVNODE*>::iterator iter = copied.begin(); iter != copied.end(); ++iter){
+            paths.push_back((*iter)->old_path);
+        }
+        if(0 != (result = delete_objects(paths, errors))){
+            S3FS_PRN_WARN("error occurred in DeleteObjects request(errno=%d), but continue...", result);
+        }
+        for(std::list<std::string>::const_iterator iter = paths.begin(); iter != paths.end(); ++iter){
+            if(errors.end() == errors.find(*iter)){
+                donelist.insert(get_realpath(iter->c_str()));
+            }
+        }
+    }else{
+        S3fsMultiCurl curlmulti(S3fsCurl::GetMaxMultiRequest());
+        curlmulti.SetSuccessCallback(multi_rename_delete_callback);
+        curlmulti.SetSuccessCallbackParam(&donelist);
+
+        for(std::vector<MVNODE*>::iterator iter = copied.begin(); iter != copied.end(); ++iter){
+            S3fsCurl* s3fscurl = new S3fsCurl();
+            if(!s3fscurl->PreDeleteRequest((*iter)->old_path)){
+                S3FS_PRN_WARN("Could not make curl object for delete request(%s).", (*iter)->old_path);
+                delete s3fscurl;
+                continue;
+            }
+            if(!curlmulti.SetS3fsCurlObject(s3fscurl)){
+                S3FS_PRN_WARN("Could not make curl object into multi curl(%s).", (*iter)->old_path);
+                delete s3fscurl;
+                continue;
+            }
+        }
+        if(0 != (result = curlmulti.Request())){
+            S3FS_PRN_WARN("error occurred in multi delete request(errno=%d), but continue...", result);
+        }
+    }
+
+    // check the result of deleting, and delete remaining objects one by one
+    for(std::vector<MVNODE*>::iterator iter = copied.begin(); iter != copied.end(); ++iter){
+        MVNODE* mn_cur = *iter;
+        if(donelist.end() == donelist.find(get_realpath(mn_cur->old_path))){
+            if(0 != (result = s3fs_unlink(mn_cur->old_path))){
+                S3FS_PRN_ERR("s3fs_unlink returned an error(%d)", result);
+                return result;
+            }
+        }
+        StatCache::getStatCacheData()->DelStat(mn_cur->old_path);
+        StatCache::getStatCacheData()->DelSymlink(mn_cur->old_path);
+        FdManager::DeleteCacheFile(mn_cur->old_path);
+        StatCache::getStatCacheData()->DelStat(mn_cur->new_path);
+    }
+    return 0;
+}
+
 static int rename_directory(const char* from, const char* to)
 {
     S3ObjList head;
@@ -1468,6 +2462,11 @@ static int rename_directory(const char* from, const char* to)
     head.GetNameList(headlist);                       // get name without "/".
     S3ObjList::MakeHierarchizedList(headlist, false); // add hierarchized dir.
 
+    // Send multi head request for stats caching.
+    if(!head.IsEmpty() && 0 != (result = readdir_multi_head(basepath.c_str(), head, NULL, NULL))){
+        S3FS_PRN_WARN("readdir_multi_head returns error(%d), but continue...", result);
+    }
+
     s3obj_list_t::const_iterator liter;
     for(liter = headlist.begin(); headlist.end() != liter; ++liter){
         // make "from" and "to" object name.
@@ -1508,25 +2507,60 @@ static int rename_directory(const char* from, const char* to)
     // rename
     //
     // rename directory objects.
+    //
+    // [NOTE]
+    // All levels of the directory tree have been resolved by one listing,
+    // thus the new directory objects are created by parallel requests.
+    //
+    std::map<std::string, headers_t> newdirs;
     for(mn_cur = mn_head; mn_cur; mn_cur = mn_cur->next){
         if(mn_cur->is_dir && mn_cur->old_path && '\0' != mn_cur->old_path[0]){
             // [NOTE]
             // The ctime is updated only for the top (from) directory.
             // Other than that, it will not be updated.
             //
-            if(0 != (result = clone_directory_object(mn_cur->old_path, mn_cur->new_path, (strfrom == mn_cur->old_path)))){
-                S3FS_PRN_ERR("clone_directory_object returned an error(%d)", result);
+            if(0 != (result = get_object_attribute(mn_cur->old_path, &stbuf))){
+                S3FS_PRN_ERR("failed to get %s object attribute(%d).", mn_cur->old_path, result);
                 free_mvnodes(mn_head);
                 return result;
             }
+            std::string newdir = mn_cur->new_path;
+            if(!newdir.empty() && '/' == *newdir.rbegin()){
+                newdir.erase(newdir.length() - 1);
+            }
+            make_directory_object_meta(newdirs[newdir], stbuf.st_mode, stbuf.st_atime, stbuf.st_mtime, (strfrom == mn_cur->old_path ? time(NULL) : stbuf.st_ctime), stbuf.st_uid, stbuf.st_gid);
         }
     }
+    if(!newdirs.empty() && 0 != (result = create_directory_objects(newdirs))){
+        S3FS_PRN_ERR("create_directory_objects returned an error(%d)", result);
+        free_mvnodes(mn_head);
+        return result;
+    }
 
     // iterate over the list - copy the files with rename_object
     // does a safe copy - copies first and then deletes old
+    //
+    // [NOTE]
+    // The files are renamed by parallel requests(each bundle has
+    // rename_parallel_count files), and the large files in a bundle are
+    // copied by parallel multipart copy requests.
+    //
+    std::vector<MVNODE*> parallel_nodes;
     for(mn_cur = mn_head; mn_cur; mn_cur = mn_cur->next){
         if(!mn_cur->is_dir){
             if(!nocopyapi && !norenameapi){
+                struct stat st;
+                if(0 == get_object_attribute(mn_cur->old_path, &st, NULL) && !FdManager::HasOpenEntityFd(mn_cur->old_path) && 0 == check_parent_object_access(mn_cur->old_path, W_OK | X_OK) && 0 == check_parent_object_access(mn_cur->new_path, W_OK | X_OK)){
+                    parallel_nodes.push_back(mn_cur);
+                    if(rename_parallel_count <= parallel_nodes.size()){
+                        if(0 != (result = multi_rename_files(parallel_nodes))){
+                            free_mvnodes(mn_head);
+                            return result;
+                        }
+                        parallel_nodes.clear();
+                    }
+                    continue;
+                }
                 result = rename_object(mn_cur->old_path, mn_cur->new_path, false);          // keep ctime
             }else{
                 result = rename_object_nocopy(mn_cur->old_path, mn_cur->new_path, false);   // keep ctime
@@ -1538,6 +2572,13 @@ static int rename_directory(const char* from, const char* to)
             }
         }
     }
+    if(!parallel_nodes.empty()){
+        if(0 != (result = multi_rename_files(parallel_nodes))){
+            free_mvnodes(mn_head);
+            return result;
+        }
+        parallel_nodes.clear();
+    }
 
     // Iterate over old the directories, bottoms up and remove
     for(mn_cur = mn_tail; mn_cur; mn_cur = mn_cur->prev){
@@ -1583,6 +2624,16 @@ static int s3fs_rename(const char* _from, const char* _to)
         return result;
     }
 
+    // put the pending meta before copying objects, and discard it for overwritten objects.
+    PendingMeta::get()->Flush(from, true);
+    PendingMeta::get()->Discard(to, true);
+
+    // rename opened and modified file without uploading it to old path
+    if(!S_ISDIR(buf.st_mode) && -ENOTSUP != (result = rename_opened_object_local(from, to, true))){     // update ctime
+        S3FS_MALLOCTRIM(0);
+        return result;
+    }
+
     // flush pending writes if file is open
     {   // scope for AutoFdEntity
         AutoFdEntity autoent;
@@ -1702,11 +2753,16 @@ static int s3fs_chmod(const char* _path, mode_t mode)
             // not found opened file.
             merge_headers(meta, updatemeta, true);
 
-            // upload meta directly.
-            if(0 != (result = put_headers(strpath.c_str(), meta, true))){
-                return result;
+            // coalesce the update with the following updates if possible,
+            // otherwise upload meta directly.
+            if(NULL == ent && PendingMeta::get()->Add(path, strpath, nowcache, meta, fuse_get_context()->pid)){
+                S3FS_PRN_INFO("meta pending until the delay time passes");
+            }else{
+                if(0 != (result = put_headers(strpath.c_str(), meta, true))){
+                    return result;
+                }
+                StatCache::getStatCacheData()->DelStat(nowcache);
             }
-            StatCache::getStatCacheData()->DelStat(nowcache);
         }
     }
     S3FS_MALLOCTRIM(0);
@@ -1879,11 +2935,16 @@ static int s3fs_chown(const char* _path, uid_t uid, gid_t gid)
             // not found opened file.
             merge_headers(meta, updatemeta, true);
 
-            // upload meta directly.
-            if(0 != (result = put_headers(strpath.c_str(), meta, true))){
-                return result;
+            // coalesce the update with the following updates if possible,
+            // otherwise upload meta directly.
+            if(NULL == ent && PendingMeta::get()->Add(path, strpath, nowcache, meta, fuse_get_context()->pid)){
+                S3FS_PRN_INFO("meta pending until the delay time passes");
+            }else{
+                if(0 != (result = put_headers(strpath.c_str(), meta, true))){
+                    return result;
+                }
+                StatCache::getStatCacheData()->DelStat(nowcache);
             }
-            StatCache::getStatCacheData()->DelStat(nowcache);
         }
     }
     S3FS_MALLOCTRIM(0);
@@ -2072,11 +3133,16 @@ static int s3fs_utimens(const char* _path, const struct timespec ts[2])
             // not found opened file.
             merge_headers(meta, updatemeta, true);
 
-            // upload meta directly.
-            if(0 != (result = put_headers(strpath.c_str(), meta, true))){
-                return result;
+            // coalesce the update with the following updates if possible,
+            // otherwise upload meta directly.
+            if(NULL == ent && PendingMeta::get()->Add(path, strpath, nowcache, meta, fuse_get_context()->pid)){
+                S3FS_PRN_INFO("meta pending until the delay time passes");
+            }else{
+                if(0 != (result = put_headers(strpath.c_str(), meta, true))){
+                    return result;
+                }
+                StatCache::getStatCacheData()->DelStat(nowcache);
             }
-            StatCache::getStatCacheData()->DelStat(nowcache);
 
             if(keep_mtime){
                 ent->SetHoldingMtime(ts[1]);     // ts[1].tv_sec is mtime
@@ -2178,6 +3244,7 @@ static int s3fs_truncate(const char* _path, off_t size)
 {
     WTF8_ENCODE(path)
     int          result;
+    struct stat  st;
     headers_t    meta;
     AutoFdEntity autoent;
     FdEntity*    ent = NULL;
@@ -2187,6 +3254,7 @@ static int s3fs_truncate(const char* _path, off_t size)
     if(size < 0){
         size = 0;
     }
+    PendingMeta::get()->Flush(path);
 
     if(0 != (result = check_parent_object_access(path, X_OK))){
         return result;
@@ -2196,15 +3264,32 @@ static int s3fs_truncate(const char* _path, off_t size)
     }
 
     // Get file information
-    if(0 == (result = get_object_attribute(path, NULL, &meta))){
-        // Exists -> Get file(with size)
-        if(NULL == (ent = autoent.Open(path, &meta, size, -1, O_RDWR, false, true, AutoLock::NONE))){
-            S3FS_PRN_ERR("could not open file(%s): errno=%d", path, errno);
-            return -EIO;
-        }
-        if(0 != (result = ent->Load(0, size, AutoLock::NONE))){
-            S3FS_PRN_ERR("could not download file(%s): result=%d", path, result);
-            return result;
+    if(0 == (result = get_object_attribute(path, &st, &meta))){
+        if(!nomultipart && FdEntity::GetNoMixMultipart() && S3fsCurl::GetMultipartSize() <= size && !FdManager::HasOpenEntityFd(path)){
+            // Exists -> Open file(with object size) and truncate it without loading
+            //
+            // [NOTE]
+            // The retained area is copied by UploadPartCopy and only the
+            // tail part is uploaded by mix multipart uploading at flushing.
+            //
+            if(NULL == (ent = autoent.Open(path, &meta, st.st_size, st.st_mtime, O_RDWR, false, true, AutoLock::NONE))){
+                S3FS_PRN_ERR("could not open file(%s): errno=%d", path, errno);
+                return -EIO;
+            }
+            if(0 != (result = ent->Truncate(size))){
+                S3FS_PRN_ERR("could not truncate file(%s): result=%d", path, result);
+                return result;
+            }
+        }else{
+            // Exists -> Get file(with size)
+            if(NULL == (ent = autoent.Open(path, &meta, size, -1, O_RDWR, false, true, AutoLock::NONE))){
+                S3FS_PRN_ERR("could not open file(%s): errno=%d", path, errno);
+                return -EIO;
+            }
+            if(0 != (result = ent->Load(0, size, AutoLock::NONE))){
+                S3FS_PRN_ERR("could not download file(%s): result=%d", path, result);
+                return result;
+            }
         }
 
         ent->UpdateCtime();
@@ -2254,6 +3339,9 @@ static int s3fs_open(const char* _path, struct fuse_file_info* fi)
         return -EACCES;
     }
 
+    // put the pending meta before the stats cache is removed.
+    PendingMeta::get()->Flush(path);
+
     // [NOTE]
     // Delete the Stats cache only if the file is not open.
     // If the file is open, the stats cache will not be deleted as
@@ -2493,6 +3581,82 @@ static int s3fs_release(const char* _path, struct fuse_file_info* fi)
     return 0;
 }
 
+//
+// Prefetching the directory listing and stats
+//
+// [NOTE]
+// If prefetch_dir_stat is specified, s3fs_opendir starts the listing and
+// the HEAD requests for the directory in the background thread, and the
+// information is set to fi->fh. s3fs_readdir waits for the thread and
+// uses the prefetched listing, then the stats are already in the stat
+// cache.
+//
+struct dir_prefetch_info
+{
+    std::string   path;
+    S3ObjList     head;
+    unsigned long generation;
+    int           result;
+    pthread_t     thread;
+    bool          is_joined;
+    bool          is_used;
+
+    explicit dir_prefetch_info(const char* strpath) : path(strpath), generation(0), result(0), is_joined(false), is_used(false) {}
+};
+
+static int list_dir_and_stats(const char* path, const S3ObjList& head, void* buf, fuse_fill_dir_t filler)
+{
+    int result;
+
+    // Send multi head request for stats caching.
+    std::string strpath = path;
+    if(strcmp(path, "/") != 0){
+        strpath += "/";
+    }
+    if(0 != (result = readdir_multi_head(strpath.c_str(), head, buf, filler))){
+        S3FS_PRN_ERR("readdir_multi_head returns error(%d).", result);
+    }
+    return result;
+}
+
+static void* prefetch_dir_worker(void* arg)
+{
+    dir_prefetch_info* pinfo = static_cast<dir_prefetch_info*>(arg);
+    if(!pinfo){
+        return NULL;
+    }
+    S3FS_PRN_INFO3("start prefetching directory[path=%s]", pinfo->path.c_str());
+
+    pinfo->generation = StatCache::getStatCacheData()->GetDirListGeneration();
+    if(0 != (pinfo->result = list_bucket(pinfo->path.c_str(), pinfo->head, "/"))){
+        S3FS_PRN_ERR("list_bucket returns error(%d).", pinfo->result);
+        return NULL;
+    }
+    if(!pinfo->head.IsEmpty()){
+        // only caching stats(result is not used as same as readdir)
+        list_dir_and_stats(pinfo->path.c_str(), pinfo->head, NULL, NULL);
+    }
+    S3FS_PRN_INFO3("finish prefetching directory[path=%s]", pinfo->path.c_str());
+
+    return NULL;
+}
+
+static dir_prefetch_info* get_dir_prefetch_info(struct fuse_file_info* fi)
+{
+    if(!fi || 0 == fi->fh){
+        return NULL;
+    }
+    dir_prefetch_info* pinfo = reinterpret_cast<dir_prefetch_info*>(fi->fh);
+    if(!pinfo->is_joined){
+        int result;
+        if(0 != (result = pthread_join(pinfo->thread, NULL))){
+            S3FS_PRN_ERR("failed pthread_join - rc(%d)", result);
+        }
+        pinfo->is_joined = true;
+    }
+    return pinfo;
+}
+
 static int s3fs_opendir(const char* _path, struct fuse_file_info* fi)
 {
     WTF8_ENCODE(path)
@@ -2501,15 +3665,42 @@ static int s3fs_opendir(const char* _path, struct fuse_file_info* fi)
 
     S3FS_PRN_INFO("[path=%s][flags=0x%x]", path, fi->flags);
 
+    fi->fh = 0;
     if(0 == (result = check_object_access(path, mask, NULL))){
         result = check_parent_object_access(path, X_OK);
     }
+    if(0 == result && prefetch_dir_stat){
+        dir_prefetch_info* pinfo = new dir_prefetch_info(path);
+        int                rc;
+        if(0 != (rc = pthread_create(&pinfo->thread, NULL, prefetch_dir_worker, static_cast<void*>(pinfo)))){
+            // continue without prefetching
+            S3FS_PRN_WARN("failed pthread_create - rc(%d), so continue without prefetching.", rc);
+            delete pinfo;
+        }else{
+            fi->fh = reinterpret_cast<uint64_t>(pinfo);
+        }
+    }
     S3FS_MALLOCTRIM(0);
 
     return result;
 }
 
-static bool multi_head_callback(S3fsCurl* s3fscurl)
+static int s3fs_releasedir(const char* _path, struct fuse_file_info* fi)
+{
+    WTF8_ENCODE(path)
+    S3FS_PRN_INFO("[path=%s]", path);
+
+    dir_prefetch_info* pinfo = get_dir_prefetch_info(fi);
+    if(pinfo){
+        delete pinfo;
+        fi->fh = 0;
+    }
+    S3FS_MALLOCTRIM(0);
+
+    return 0;
+}
+
+static bool multi_head_callback(S3fsCurl* s3fscurl, void* param)
 {
     if(!s3fscurl){
         return false;
@@ -2559,27 +3750,25 @@ static S3fsCurl* multi_head_retry_callback(S3fsCurl* s3fscurl)
 
 static int readdir_multi_head(const char* path, const S3ObjList& head, void* buf, fuse_fill_dir_t filler)
 {
-    S3fsMultiCurl curlmulti(S3fsCurl::GetMaxMultiRequest());
-    s3obj_list_t  headlist;
-    s3obj_list_t  fillerlist;
-    int           result = 0;
-
-    S3FS_PRN_INFO1("[path=%s][list=%zu]", path, headlist.size());
+    S3fsMultiCurl   curlmulti(S3fsCurl::GetMaxMultiRequest());
+    s3obj_ptrlist_t headlist;
+    s3obj_list_t    fillerlist;
+    int             result = 0;
 
     // Make base path list.
-    head.GetNameList(headlist, true, false);  // get name with "/".
+    head.GetNamePtrList(headlist);            // get name with "/", without copying.
+
+    S3FS_PRN_INFO1("[path=%s][list=%zu]", path, headlist.size());
 
     // Initialize S3fsMultiCurl
     curlmulti.SetSuccessCallback(multi_head_callback);
     curlmulti.SetRetryCallback(multi_head_retry_callback);
 
-    s3obj_list_t::iterator iter;
-
     fillerlist.clear();
     // Make single head request(with max).
-    for(iter = headlist.begin(); headlist.end() != iter; iter = headlist.erase(iter)){
-        std::string disppath = path + (*iter);
-        std::string etag     = head.GetETag((*iter).c_str());
+    for(s3obj_ptrlist_t::const_iterator hiter = headlist.begin(); headlist.end() != hiter; ++hiter){
+        std::string disppath = std::string(path) + (*hiter);
+        std::string etag     = head.GetETag(*hiter);
 
         std::string fillpath = disppath;
         if('/' == *disppath.rbegin()){
@@ -2594,7 +3783,7 @@ static int readdir_multi_head(const char* path, const S3ObjList& head, void* buf
         // First check for directory, start checking "not SSE-C".
         // If checking failed, retry to check with "SSE-C" by retry callback func when SSE-C mode.
         S3fsCurl* s3fscurl = new S3fsCurl();
-        if(!s3fscurl->PreHeadRequest(disppath, (*iter), disppath)){  // target path = cache key path.(ex "dir/")
+        if(!s3fscurl->PreHeadRequest(disppath, std::string(*hiter), disppath)){  // target path = cache key path.(ex "dir/")
             S3FS_PRN_WARN("Could not make curl object for head request(%s).", disppath.c_str());
             delete s3fscurl;
             continue;
@@ -2624,7 +3813,11 @@ static int readdir_multi_head(const char* path, const S3ObjList& head, void* buf
     // populate fuse buffer
     // here is best position, because a case is cache size < files in directory
     //
-    for(iter = fillerlist.begin(); fillerlist.end() != iter; ++iter){
+    if(!filler){
+        // only caching stats
+        return result;
+    }
+    for(s3obj_list_t::const_iterator iter = fillerlist.begin(); fillerlist.end() != iter; ++iter){
         struct stat st;
         bool in_cache = StatCache::getStatCacheData()->GetStat((*iter), &st);
         std::string bpath = mybasename((*iter));
@@ -2645,7 +3838,8 @@ static int readdir_multi_head(const char* path, const S3ObjList& head, void* buf
 static int s3fs_readdir(const char* _path, void* buf, fuse_fill_dir_t filler, off_t offset, struct fuse_file_info* fi)
 {
     WTF8_ENCODE(path)
-    S3ObjList head;
+    S3ObjList  localhead;
+    S3ObjList* phead = &localhead;
     int result;
 
     S3FS_PRN_INFO("[path=%s]", path);
@@ -2655,9 +3849,26 @@ static int s3fs_readdir(const char* _path, void* buf, fuse_fill_dir_t filler, of
     }
 
     // get a list of all the objects
-    if((result = list_bucket(path, head, "/")) != 0){
-        S3FS_PRN_ERR("list_bucket returns error(%d).", result);
-        return result;
+    unsigned long      generation;
+    dir_prefetch_info* pinfo = get_dir_prefetch_info(fi);
+    if(pinfo && !pinfo->is_used && 0 == pinfo->result && pinfo->path == path){
+        // use the prefetched listing only once(rewinddir lists again)
+        S3FS_PRN_INFO3("use prefetched directory listing[path=%s]", path);
+        phead         = &pinfo->head;
+        generation    = pinfo->generation;
+        pinfo->is_used = true;
+    }else{
+        generation = StatCache::getStatCacheData()->GetDirListGeneration();
+        if((result = list_bucket(path, localhead, "/")) != 0){
+            S3FS_PRN_ERR("list_bucket returns error(%d).", result);
+            return result;
+        }
+    }
+    S3ObjList& head = *phead;
+    if(StatCache::getStatCacheData()->GetCacheDirList()){
+        s3obj_list_t names;
+        head.GetNameList(names);
+        StatCache::getStatCacheData()->AddDirList(path, names, generation);
     }
 
     // force to add "." and ".." name.
@@ -2668,13 +3879,8 @@ static int s3fs_readdir(const char* _path, void* buf, fuse_fill_dir_t filler, of
     }
 
     // Send multi head request for stats caching.
-    std::string strpath = path;
-    if(strcmp(path, "/") != 0){
-        strpath += "/";
-    }
-    if(0 != (result = readdir_multi_head(strpath.c_str(), head, buf, filler))){
-        S3FS_PRN_ERR("readdir_multi_head returns error(%d).", result);
-    }
+    // (If the stats are prefetched, they are in the stat cache.)
+    result = list_dir_and_stats(path, head, buf, filler);
     S3FS_MALLOCTRIM(0);
 
     return result;
@@ -2793,6 +3999,172 @@ static int list_bucket(const char* path, S3ObjList& head, const char* delimiter,
     return 0;
 }
 
+//
+// Get the object paths for warming the cache.
+// The path which ends with "/" is a prefix, and all objects under it are
+// listed. The other path is an object key.
+//
+static int get_warm_cache_objects(const std::string& path, std::list<std::string>& objects)
+{
+    S3FS_PRN_INFO1("[path=%s]", path.c_str());
+
+    if(path.empty() || '/' != *path.rbegin()){
+        objects.push_back(path);
+        return 0;
+    }
+
+    // No delimiter is specified, the result(head) is all object keys.
+    S3ObjList head;
+    int       result;
+    if(0 != (result = list_bucket(path.c_str(), head, NULL))){
+        S3FS_PRN_ERR("list_bucket returns error(%d).", result);
+        return result;
+    }
+    if(head.IsEmpty()){
+        return 0;
+    }
+
+    // Send multi head request for stats caching.
+    if(0 != (result = readdir_multi_head(path.c_str(), head, NULL, NULL))){
+        S3FS_PRN_WARN("readdir_multi_head returns error(%d), but continue...", result);
+    }
+
+    s3obj_list_t headlist;
+    head.GetNameList(headlist, true, false);          // get name with "/"
+    for(s3obj_list_t::const_iterator iter = headlist.begin(); iter != headlist.end(); ++iter){
+        if(iter->empty() || '/' == *iter->rbegin()){
+            continue;                                 // directory object
+        }
+        objects.push_back(path + (*iter));
+    }
+    return 0;
+}
+
+//
+// Download the objects into the cache directory.
+//
+// [NOTE]
+// The objects are opened by the parallel count at a time, and the unloaded
+// ranges of all of them are downloaded by one multi request. Large objects
+// are split by the multipart size, so the parallel count is the budget for
+// all parts of the objects.
+//
+static int warm_cache_objects(const std::list<std::string>& objects, size_t& cached_count)
+{
+    typedef std::list<std::pair<FdEntity*, int> > warm_ent_list_t;
+
+    int                                    result      = 0;
+    size_t                                 batch_count = (0 < S3fsCurl::GetMaxParallelCount() ? static_cast<size_t>(S3fsCurl::GetMaxParallelCount()) : 1);
+    std::list<std::string>::const_iterator iter        = objects.begin();
+
+    while(iter != objects.end()){
+        warm_ent_list_t   entlist;
+        get_object_list_t getlist;
+        off_t             batch_bytes = 0;
+
+        // open the objects and list their unloaded ranges
+        for(; iter != objects.end() && entlist.size() < batch_count; ++iter){
+            const char* path = iter->c_str();
+            struct stat st;
+            headers_t   meta;
+            int         fd;
+            FdEntity*   ent;
+
+            if(0 != get_object_attribute(path, &st, &meta)){
+                S3FS_PRN_EXIT("Failed to get attributes of %s object.", path);
+                result = -EIO;
+                continue;
+            }
+            if(!S_ISREG(st.st_mode)){
+                continue;
+            }
+            if(!FdManager::IsSafeDiskSpace(NULL, batch_bytes + st.st_size)){
+                FdManager::get()->EvictOverBudget();
+                if(!FdManager::IsSafeDiskSpace(NULL, batch_bytes + st.st_size)){
+                    S3FS_PRN_EXIT("There is no enough disk space for caching %s object.", path);
+                    result = -ENOSPC;
+                    break;
+                }
+            }
+            if(NULL == (ent = FdManager::get()->Open(fd, path, &meta, st.st_size, st.st_mtime, O_RDONLY, false, true, AutoLock::NONE))){
+                S3FS_PRN_EXIT("Failed to open %s object in cache directory.", path);
+                result = -EIO;
+                continue;
+            }
+            ent->GetUnloadedObjects(getlist);
+            entlist.push_back(std::make_pair(ent, fd));
+            batch_bytes += st.st_size;
+        }
+
+        // download
+        if(!getlist.empty() && 0 != S3fsCurl::ParallelGetObjectsRequest(getlist)){
+            S3FS_PRN_DBG("an error occurred during downloading objects.");
+        }
+
+        // set the loaded ranges, and close(save the stats files)
+        for(warm_ent_list_t::iterator eiter = entlist.begin(); eiter != entlist.end(); ++eiter){
+            if(eiter->first->SetLoadedObjects(getlist)){
+                printf("Succeed to cache %s object.\n", eiter->first->GetPath());
+                ++cached_count;
+            }else{
+                S3FS_PRN_EXIT("Failed to cache %s object.", eiter->first->GetPath());
+                result = -EIO;
+            }
+            FdManager::get()->Close(eiter->first, eiter->second);
+        }
+
+        // keep the cache under max_cache_size
+        FdManager::get()->EvictOverBudget();
+
+        if(-ENOSPC == result){
+            break;
+        }
+    }
+    return result;
+}
+
+//
+// Utility mode for warming the cache directory.
+//
+static int s3fs_warm_cache()
+{
+    printf("\n*** s3fs run as utility mode.\n\n");
+
+    // load IAM role name from meta data
+    if(load_iamrole){
+        S3fsCurl s3fscurl;
+        if(!s3fscurl.LoadIAMRoleFromMetaData()){
+            S3FS_PRN_EXIT("could not load IAM role name from meta data.");
+            return EXIT_FAILURE;
+        }
+    }
+
+    // index the cache files for eviction
+    FdManager::BuildCacheFileIndex();
+
+    int    result       = EXIT_SUCCESS;
+    size_t cached_count = 0;
+    for(std::list<std::string>::const_iterator iter = warm_cache_paths.begin(); iter != warm_cache_paths.end(); ++iter){
+        std::string            path = ('/' == (*iter)[0] ? (*iter) : ("/" + (*iter)));
+        std::list<std::string> objects;
+        if(0 != get_warm_cache_objects(path, objects)){
+            S3FS_PRN_EXIT("Could not get the list of objects under %s.", path.c_str());
+            result = EXIT_FAILURE;
+            continue;
+        }
+        int warm_result = warm_cache_objects(objects, cached_count);
+        if(0 != warm_result){
+            result = EXIT_FAILURE;
+            if(-ENOSPC == warm_result){
+                break;
+            }
+        }
+    }
+    printf("\n%zu objects are cached.\n", cached_count);
+
+    return result;
+}
+
 static int remote_mountpath_exists(const char* path)
 {
     struct stat stbuf;
@@ -2973,6 +4345,13 @@ static int s3fs_setxattr(const char* path, const char* name, const char* value,
         S3FS_PRN_ERR("Wrong parameter: value(%p), size(%zu)", value, size);
         return 0;
     }
+    if(rmtree_xattr && name && 0 == strcmp(name, rmtree_xattr_name)){
+        return delete_directory_tree(path);
+    }
+    if(copy_xattr && name && 0 == strcmp(name, copy_xattr_name)){
+        return copy_object_by_xattr(path, value, size);
+    }
+    PendingMeta::get()->Flush(path);
 
 #if defined(__APPLE__)
     if (position != 0) {
@@ -3238,6 +4617,7 @@ static int s3fs_removexattr(const char* path, const char* name)
     if(!path || !name){
         return -EIO;
     }
+    PendingMeta::get()->Flush(path);
 
     int         result;
     std::string strpath;
@@ -3384,6 +4764,8 @@ static void* s3fs_init(struct fuse_conn_info* conn)
     if(is_remove_cache && (!CacheFileStat::DeleteCacheFileStatDirectory() || !FdManager::DeleteCacheDirectory())){
         S3FS_PRN_DBG("Could not initialize cache directory.");
     }
+    // index the cache files for eviction
+    FdManager::BuildCacheFileIndex();
 
     // check loading IAM role name
     if(load_iamrole){
@@ -3431,6 +4813,16 @@ static void* s3fs_init(struct fuse_conn_info* conn)
         S3FS_PRN_ERR("Failed to initialize signal object, but continue...");
     }
 
+    // Pending meta updates
+    if(PendingMeta::IsEnable() && !PendingMeta::get()->StartWorker()){
+        S3FS_PRN_ERR("Failed to start the thread for pending meta updates, but continue...");
+    }
+
+    // Cache evictor for max_cache_size
+    if(!FdManager::StartCacheEvictor()){
+        S3FS_PRN_ERR("Failed to start the thread for cache evictor, but continue...");
+    }
+
     return NULL;
 }
 
@@ -3438,6 +4830,16 @@ static void s3fs_destroy(void*)
 {
     S3FS_PRN_INFO("destroy");
 
+    // Pending meta updates(put all pending meta)
+    if(!PendingMeta::get()->StopWorker()){
+        S3FS_PRN_WARN("Failed to stop the thread for pending meta updates.");
+    }
+
+    // Cache evictor
+    if(!FdManager::StopCacheEvictor()){
+        S3FS_PRN_WARN("Failed to stop the thread for cache evictor.");
+    }
+
     // Signal object
     if(!S3fsSignals::Destroy()){
         S3FS_PRN_WARN("Failed to clean up signal object.");
@@ -4274,6 +5676,10 @@ static int my_fuse_opt_proc(void* data, const char* arg, int key, struct fuse_ar
             is_remove_cache = true;
             return 0;
         }
+        if(0 == strcmp(arg, "shared_cache")){
+            FdManager::SetSharedCache(true);
+            return 0;
+        }
         if(is_prefix(arg, "multireq_max=")){
             int maxreq = static_cast<int>(cvt_strtoofft(strchr(arg, '=') + sizeof(char), /*base=*/ 10));
             S3fsCurl::SetMaxMultiRequest(maxreq);
@@ -4562,6 +5968,45 @@ static int my_fuse_opt_proc(void* data, const char* arg, int key, struct fuse_ar
             StatCache::getStatCacheData()->EnableCacheNoObject();
             return 0;
         }
+        if(0 == strcmp(arg, "enable_rmtree_xattr")){
+            rmtree_xattr = true;
+            return 0;
+        }
+        if(0 == strcmp(arg, "enable_copy_xattr")){
+            copy_xattr = true;
+            return 0;
+        }
+        if(is_prefix(arg, "noobj_cache_memory=")){
+            off_t size = static_cast<off_t>(cvt_strtoofft(strchr(arg, '=') + sizeof(char), /*base=*/ 10));
+            if(size < 0){
+                S3FS_PRN_EXIT("argument should be over 0: noobj_cache_memory");
+                return -1;
+            }
+            if(static_cast<off_t>(static_cast<size_t>(-1) / (1024 * 1024)) < size){
+                S3FS_PRN_EXIT("argument is too large: noobj_cache_memory");
+                return -1;
+            }
+            StatCache::getStatCacheData()->SetNoObjectCacheMemorySize(static_cast<size_t>(size * 1024 * 1024));
+            return 0;
+        }
+        if(is_prefix(arg, "noobj_cache_expire=")){
+            time_t expr_time = static_cast<time_t>(cvt_strtoofft(strchr(arg, '=') + sizeof(char), /*base=*/ 10));
+            StatCache::getStatCacheData()->SetNoObjectExpireTime(expr_time);
+            return 0;
+        }
+        if(0 == strcmp(arg, "enable_dirlist_cache")){
+            StatCache::getStatCacheData()->EnableCacheDirList();
+            return 0;
+        }
+        if(is_prefix(arg, "meta_update_delay=")){
+            time_t delay = static_cast<time_t>(cvt_strtoofft(strchr(arg, '=') + sizeof(char), /*base=*/ 10));
+            if(delay < 0){
+                S3FS_PRN_EXIT("meta_update_delay option must be 0 or positive number.");
+                return -1;
+            }
+            PendingMeta::SetDelay(delay);
+            return 0;
+        }
         if(0 == strcmp(arg, "nodnscache")){
             S3fsCurl::SetDnsCache(false);
             return 0;
@@ -4599,6 +6044,15 @@ static int my_fuse_opt_proc(void* data, const char* arg, int key, struct fuse_ar
             }
             return 0;
         }
+        if(is_prefix(arg, "multipart_copy_parts=")){
+            int parts = static_cast<int>(cvt_strtoofft(strchr(arg, '=') + sizeof(char), /*base=*/ 10));
+            if(0 > parts){
+                S3FS_PRN_EXIT("multipart_copy_parts option must not be negative.");
+                return -1;
+            }
+            S3fsCurl::SetMultipartCopyParts(parts);
+            return 0;
+        }
         if(is_prefix(arg, "max_dirty_data=")){
             off_t size = static_cast<off_t>(cvt_strtoofft(strchr(arg, '=') + sizeof(char), /*base=*/ 10));
             if(size >= 50){
@@ -4619,6 +6073,51 @@ static int my_fuse_opt_proc(void* data, const char* arg, int key, struct fuse_ar
             FdManager::SetEnsureFreeDiskSpace(dfsize);
             return 0;
         }
+        if(is_prefix(arg, "max_cache_size=")){
+            off_t size = cvt_strtoofft(strchr(arg, '=') + sizeof(char), /*base=*/ 10);
+            if(size < 0){
+                S3FS_PRN_EXIT("argument should be over 0: max_cache_size");
+                return -1;
+            }
+            FdManager::SetMaxCacheSize(size * 1024 * 1024);
+            return 0;
+        }
+        if(is_prefix(arg, "cache_block_size=")){
+            off_t size = cvt_strtoofft(strchr(arg, '=') + sizeof(char), /*base=*/ 10);
+            if(size < 0){
+                S3FS_PRN_EXIT("argument should be over 0: cache_block_size");
+                return -1;
+            }
+            FdManager::SetCacheBlockSize(size * 1024 * 1024);
+            return 0;
+        }
+        if(is_prefix(arg, "memory_cache_size=")){
+            off_t size = cvt_strtoofft(strchr(arg, '=') + sizeof(char), /*base=*/ 10);
+            if(size < 0){
+                S3FS_PRN_EXIT("argument should be over 0: memory_cache_size");
+                return -1;
+            }
+            FdManager::SetMemoryCacheSize(size * 1024 * 1024);
+            return 0;
+        }
+        if(is_prefix(arg, "cache_high_watermark=")){
+            int percent = static_cast<int>(cvt_strtoofft(strchr(arg, '=') + sizeof(char), /*base=*/ 10));
+            if(percent <= 0 || 100 < percent){
+                S3FS_PRN_EXIT("argument should be between 1 and 100: cache_high_watermark");
+                return -1;
+            }
+            FdManager::SetCacheHighWatermark(percent);
+            return 0;
+        }
+        if(is_prefix(arg, "cache_low_watermark=")){
+            int percent = static_cast<int>(cvt_strtoofft(strchr(arg, '=') + sizeof(char), /*base=*/ 10));
+            if(percent < 0 || 100 <= percent){
+                S3FS_PRN_EXIT("argument should be between 0 and 99: cache_low_watermark");
+                return -1;
+            }
+            FdManager::SetCacheLowWatermark(percent);
+            return 0;
+        }
         if(is_prefix(arg, "multipart_threshold=")){
             multipart_threshold = static_cast<int64_t>(cvt_strtoofft(strchr(arg, '=') + sizeof(char), /*base=*/ 10)) * 1024 * 1024;
             if(multipart_threshold <= MIN_MULTIPART_SIZE){
@@ -4664,6 +6163,18 @@ static int my_fuse_opt_proc(void* data, const char* arg, int key, struct fuse_ar
             support_compat_dir = false;
             return 0;
         }
+        if(0 == strcmp(arg, "resolve_by_list")){
+            resolve_by_list = true;
+            return 0;
+        }
+        if(0 == strcmp(arg, "nomultidelete")){
+            nomultidelete = true;
+            return 0;
+        }
+        if(0 == strcmp(arg, "prefetch_dir_stat")){
+            prefetch_dir_stat = true;
+            return 0;
+        }
         if(0 == strcmp(arg, "enable_content_md5")){
             S3fsCurl::SetContentMd5(true);
             return 0;
@@ -4894,6 +6405,8 @@ int main(int argc, char* argv[])
         {"debug",                no_argument,       NULL, 'd'},
         {"incomplete-mpu-list",  no_argument,       NULL, 'u'},
         {"incomplete-mpu-abort", optional_argument, NULL, 'a'}, // 'a' is only identifier and is not option.
+        {"warm-cache",           required_argument, NULL, 'w'}, // 'w' is only identifier and is not option.
+        {"warm-cache-list",      required_argument, NULL, 'W'}, // 'W' is only identifier and is not option.
         {NULL, 0, NULL, 0}
     };
 
@@ -4955,6 +6468,33 @@ int main(int argc, char* argv[])
                 }
                 // if optarg is null, incomp_abort_time is 24H(default)
                 break;
+            case 'w':   // --warm-cache
+            case 'W':   // --warm-cache-list
+                if(NO_UTILITY_MODE != utility_mode && CACHE_TYPE_WARM != utility_mode){
+                    S3FS_PRN_EXIT("already utility mode option is specified.");
+                    exit(EXIT_FAILURE);
+                }
+                utility_mode = CACHE_TYPE_WARM;
+
+                if('w' == ch){
+                    warm_cache_paths.push_back(optarg);
+                }else{
+                    // the list file has a path(key or prefix) in each line
+                    std::ifstream listfs(optarg);
+                    if(!listfs.good()){
+                        S3FS_PRN_EXIT("could not open the list file(%s) for --warm-cache-list option.", optarg);
+                        exit(EXIT_FAILURE);
+                    }
+                    std::string line;
+                    while(getline(listfs, line)){
+                        line = trim(line);
+                        if(line.empty() || '#' == line[0]){
+                            continue;
+                        }
+                        warm_cache_paths.push_back(line);
+                    }
+                }
+                break;
             default:
                 exit(EXIT_FAILURE);
         }
@@ -5175,7 +6715,7 @@ int main(int argc, char* argv[])
     }
     */
 
-    if(NO_UTILITY_MODE != utility_mode){
+    if(NO_UTILITY_MODE != utility_mode && CACHE_TYPE_WARM != utility_mode){
         int exitcode = s3fs_utility_processing(incomp_abort_time);
 
         S3fsCurl::DestroyS3fsCurl();
@@ -5189,6 +6729,38 @@ int main(int argc, char* argv[])
         max_dirty_data = -1;
     }
 
+    // check cache size limit
+    if(0 < FdManager::GetMaxCacheSize()){
+        if(!FdManager::IsCacheDir()){
+            S3FS_PRN_EXIT("max_cache_size option requires use_cache option.");
+            S3fsCurl::DestroyS3fsCurl();
+            s3fs_destroy_global_ssl();
+            exit(EXIT_FAILURE);
+        }
+        if(FdManager::GetCacheHighWatermark() <= FdManager::GetCacheLowWatermark()){
+            S3FS_PRN_EXIT("cache_low_watermark(%d) must be less than cache_high_watermark(%d).", FdManager::GetCacheLowWatermark(), FdManager::GetCacheHighWatermark());
+            S3fsCurl::DestroyS3fsCurl();
+            s3fs_destroy_global_ssl();
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // check shared cache directory
+    if(FdManager::IsSharedCache()){
+        if(!FdManager::IsCacheDir()){
+            S3FS_PRN_EXIT("shared_cache option requires use_cache option.");
+            S3fsCurl::DestroyS3fsCurl();
+            s3fs_destroy_global_ssl();
+            exit(EXIT_FAILURE);
+        }
+        if(is_remove_cache){
+            S3FS_PRN_EXIT("del_cache option can not be specified with shared_cache option.");
+            S3fsCurl::DestroyS3fsCurl();
+            s3fs_destroy_global_ssl();
+            exit(EXIT_FAILURE);
+        }
+    }
+
     // check free disk space
     if(!FdManager::IsSafeDiskSpace(NULL, S3fsCurl::GetMultipartSize() * S3fsCurl::GetMaxParallelCount())){
         S3FS_PRN_EXIT("There is no enough disk space for used as cache(or temporary) directory by s3fs.");
@@ -5197,6 +6769,21 @@ int main(int argc, char* argv[])
         exit(EXIT_FAILURE);
     }
 
+    // utility mode for warming the cache directory
+    if(CACHE_TYPE_WARM == utility_mode){
+        if(!FdManager::IsCacheDir()){
+            S3FS_PRN_EXIT("--warm-cache(or --warm-cache-list) option requires use_cache option.");
+            S3fsCurl::DestroyS3fsCurl();
+            s3fs_destroy_global_ssl();
+            exit(EXIT_FAILURE);
+        }
+        int exitcode = s3fs_warm_cache();
+
+        S3fsCurl::DestroyS3fsCurl();
+        s3fs_destroy_global_ssl();
+        exit(exitcode);
+    }
+
     s3fs_oper.getattr     = s3fs_getattr;
     s3fs_oper.readlink    = s3fs_readlink;
     s3fs_oper.mknod       = s3fs_mknod;
@@ -5225,6 +6812,7 @@ int main(int argc, char* argv[])
     s3fs_oper.release     = s3fs_release;
     s3fs_oper.opendir     = s3fs_opendir;
     s3fs_oper.readdir     = s3fs_readdir;
+    s3fs_oper.releasedir  = s3fs_releasedir;
     s3fs_oper.init        = s3fs_init;
     s3fs_oper.destroy     = s3fs_destroy;
     s3fs_oper.access      = s3fs_access;
@@ -31,6 +31,7 @@
 // in common_auth.cpp
 //
 std::string s3fs_get_content_md5(int fd);
+std::string s3fs_get_content_md5(const unsigned char* data, size_t datalen);
 std::string s3fs_sha256_hex_fd(int fd, off_t start, off_t size);
 
 //
@@ -44,6 +45,7 @@ bool s3fs_destroy_crypt_mutex();
 bool s3fs_HMAC(const void* key, size_t keylen, const unsigned char* data, size_t datalen, unsigned char** digest, unsigned int* digestlen);
 bool s3fs_HMAC256(const void* key, size_t keylen, const unsigned char* data, size_t datalen, unsigned char** digest, unsigned int* digestlen);
 size_t get_md5_digest_length();
+unsigned char* s3fs_md5(const unsigned char* data, size_t datalen);
 unsigned char* s3fs_md5_fd(int fd, off_t start, off_t size);
 bool s3fs_sha256(const unsigned char* data, size_t datalen, unsigned char** digest, unsigned int* digestlen);
 size_t get_sha256_digest_length();
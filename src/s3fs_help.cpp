@@ -51,6 +51,10 @@ static const char help_string[] =
     "     s3fs --incomplete-mpu-list (-u) bucket\n"
     "     s3fs --incomplete-mpu-abort[=all | =<date format>] bucket\n"
     "\n"
+    "   utility mode (download objects into cache directory)\n"
+    "     s3fs --warm-cache=<path> [--warm-cache=<path> ...] bucket -o use_cache=<dir>\n"
+    "     s3fs --warm-cache-list=<file> bucket -o use_cache=<dir>\n"
+    "\n"
     "s3fs Options:\n"
     "\n"
     "   Most s3fs options are given in the form where \"opt\" is:\n"
@@ -84,6 +88,17 @@ static const char help_string[] =
     "   del_cache (delete local file cache)\n"
     "      - delete local file cache when s3fs starts and exits.\n"
     "\n"
+    "   shared_cache (default is disable)\n"
+    "      - allows multiple s3fs processes which mount the same bucket\n"
+    "      to share the use_cache directory. The pages loaded by each\n"
+    "      process are merged in the cache stat file under its lock, and\n"
+    "      a range is not downloaded by multiple processes at the same\n"
+    "      time. The cache files opened by the other processes are not\n"
+    "      evicted. The files opened for writing use temporary files, so\n"
+    "      the cache files have only the data of the objects which is\n"
+    "      checked by ETag. This option can not be specified with\n"
+    "      del_cache.\n"
+    "\n"
     "   storage_class (default=\"standard\")\n"
     "      - store object with specified storage class.  Possible values:\n"
     "        standard, standard_ia, onezone_ia, reduced_redundancy,\n"
@@ -212,7 +227,55 @@ static const char help_string[] =
     "      sub directories under itself. It increases ListBucket request \n"
     "      and makes performance bad.\n"
     "      You can specify this option for performance, s3fs memorizes \n"
-    "      in stat cache that the object (file or directory) does not exist.\n"
+    "      that the object (file or directory) does not exist.\n"
+    "      This cache is separated from the stat cache and it has only the\n"
+    "      hash of the path, so it does not push the stat cache out.\n"
+    "\n"
+    "   noobj_cache_memory (default=\"1\")\n"
+    "      - maximum memory size (MB) of the cache for the object which\n"
+    "      does not exist (about 48,000 entries per 1MB). When the cache is\n"
+    "      full, the expired and older entries are removed. Specifying 0\n"
+    "      disables this cache.\n"
+    "\n"
+    "   noobj_cache_expire (default is same as stat_cache_expire)\n"
+    "      - specify expire time (seconds) for entries in the cache for\n"
+    "      the object which does not exist. A negative value means the\n"
+    "      same expire time as the stat cache (stat_cache_expire), which\n"
+    "      is the default.\n"
+    "\n"
+    "   enable_rmtree_xattr (default is disable)\n"
+    "      - enable deleting a directory tree by setting the special\n"
+    "      extended attribute \"user.s3fs.rmtree\" to the directory, as\n"
+    "      \"setfattr -n user.s3fs.rmtree -v 1 dir\". s3fs lists all objects\n"
+    "      under the directory and deletes them by parallel DeleteObjects\n"
+    "      requests, without checking the permission of each object.\n"
+    "      This can not be used with nomultidelete option.\n"
+    "\n"
+    "   enable_copy_xattr (default is disable)\n"
+    "      - enable copying a file on the server side by setting the special\n"
+    "      extended attribute \"user.s3fs.copyfrom\" to the destination file,\n"
+    "      as \"setfattr -n user.s3fs.copyfrom -v /src dst\". The value is\n"
+    "      the path of the source file from the mount point. The object is\n"
+    "      copied by CopyObject or UploadPartCopy without downloading it,\n"
+    "      and the destination keeps its own mode, owner and xattrs.\n"
+    "      This can not be used with nocopyapi option.\n"
+    "\n"
+    "   enable_dirlist_cache (default is disable)\n"
+    "      - enable cache of the directory listing.\n"
+    "      When s3fs lists a directory completely, s3fs memorizes all names\n"
+    "      in the directory. Then s3fs determines that the object which is\n"
+    "      not in the listing does not exist without any request, until the\n"
+    "      listing is expired by stat_cache_expire or the directory is\n"
+    "      changed by s3fs. The objects created by other clients in the\n"
+    "      listed directory are not found until the listing is expired.\n"
+    "\n"
+    "   meta_update_delay (default=\"0\" seconds)\n"
+    "      - delay putting the meta headers updated by chmod, chown and\n"
+    "      utimens for the objects which are not opened. The updates in\n"
+    "      this time are put by one request. The pending headers are put\n"
+    "      when the file is opened, truncated or renamed, and when the\n"
+    "      other process gets the attributes. Other clients can not see\n"
+    "      the updates until they are put. Specifying 0 disables this.\n"
     "\n"
     "   no_check_certificate\n"
     "      - server certificate won't be checked against the available \n"
@@ -244,11 +307,20 @@ static const char help_string[] =
     "      The minimum value is 5 MB and the maximum value is 5 GB.\n"
     "\n"
     "   multipart_copy_size (default=\"512\")\n"
-    "      - part size, in MB, for each multipart copy request, used for\n"
-    "      renames and mixupload.\n"
+    "      - maximum part size, in MB, for each multipart copy request,\n"
+    "      used for renames and mixupload.\n"
     "      The minimum value is 5 MB and the maximum value is 5 GB.\n"
-    "      Must be at least 512 MB to copy the maximum 5 TB object size\n"
-    "      but lower values may improve performance.\n"
+    "      The part size is raised over this value if needed to copy\n"
+    "      the object within 10000 parts.\n"
+    "\n"
+    "   multipart_copy_parts (default is same as parallel_count)\n"
+    "      - target number of parts for each multipart copy request.\n"
+    "      The part size is chosen to split the object into this number\n"
+    "      of parts, but it is between 5 MB and multipart_copy_size.\n"
+    "      When renaming a directory, the parts of multiple large objects\n"
+    "      are copied in parallel, and the total number of concurrent\n"
+    "      requests is limited by parallel_count.\n"
+    "      0 value means same as parallel_count.\n"
     "\n"
     "   max_dirty_data (default=\"5120\")\n"
     "      - flush dirty data to S3 after a certain number of MB written.\n"
@@ -263,6 +335,42 @@ static const char help_string[] =
     "        space is smaller than this value, s3fs do not use diskspace\n"
     "        as possible in exchange for the performance.\n"
     "\n"
+    "   max_cache_size (default=\"0\")\n"
+    "      - sets the maximum size, in MB, of the cache files under the\n"
+    "      use_cache directory. 0 means no limit. A background thread\n"
+    "      evicts the least recently used cache files which are not\n"
+    "      opened, when the cache size is over cache_high_watermark.\n"
+    "      The sizes of the opened cache files are counted as they grow.\n"
+    "      If it is not enough, the cold blocks of the opened cache files\n"
+    "      are also evicted with cache_block_size option.\n"
+    "\n"
+    "   cache_block_size (default=\"0\")\n"
+    "      - sets the block size, in MB, for evicting the cache files.\n"
+    "      When the cache files are cleaned up, s3fs evicts only the\n"
+    "      least recently used blocks of the cache file which is larger\n"
+    "      than this size, by punching holes in it and marking them not\n"
+    "      loaded in its stats file. So the hot ranges of large objects\n"
+    "      are kept in the cache. If the disk space is not enough after\n"
+    "      cleaning up, the cold blocks of the opened cache files which\n"
+    "      are not modified are also evicted, instead of failing with\n"
+    "      ENOSPC. 0 means that the whole cache file is deleted. This\n"
+    "      needs the file system which supports punching holes(ext4,\n"
+    "      xfs, btrfs, etc.).\n"
+    "\n"
+    "   memory_cache_size (default=\"0\")\n"
+    "      - sets the maximum size, in MB, of the in-memory block cache\n"
+    "      which is shared by all opened files. The hot ranges of the\n"
+    "      objects are read from memory without disk I/O, and they are\n"
+    "      kept after the file is closed, so this also works without\n"
+    "      use_cache. The blocks are checked by the ETag of the object.\n"
+    "      0 means that the memory cache is not used.\n"
+    "\n"
+    "   cache_high_watermark (default=\"90\")\n"
+    "      - percent of max_cache_size to start evicting cache files.\n"
+    "\n"
+    "   cache_low_watermark (default=\"80\")\n"
+    "      - percent of max_cache_size to stop evicting cache files.\n"
+    "\n"
     "   multipart_threshold (default=\"25\")\n"
     "      - threshold, in MB, to use multipart upload instead of\n"
     "        single-part.  Must be at least 5 MB.\n"
@@ -380,6 +488,14 @@ static const char help_string[] =
     "        only rename command (ex. mv). If this option is specified with\n"
     "        nocopyapi, then s3fs ignores it.\n"
     "\n"
+    "   nomultidelete (for other incomplete compatibility object storage)\n"
+    "        For a distributed object storage which is compatibility S3\n"
+    "        API without POST (DeleteObjects api).\n"
+    "        s3fs deletes multiple objects(ex. the objects of renamed\n"
+    "        directory, directory objects in rmdir) by DeleteObjects\n"
+    "        request which has up to 1000 objects. If you set this option,\n"
+    "        s3fs deletes each object by DELETE request.\n"
+    "\n"
     "   use_path_request_style (use legacy API calling style)\n"
     "        Enable compatibility with S3-like APIs which do not support\n"
     "        the virtual-host request style, by using the older path request\n"
@@ -430,6 +546,24 @@ static const char help_string[] =
     "        Please use this option when the directory in the bucket is\n"
     "        only \"dir/\" object.\n"
     "\n"
+    "   resolve_by_list (resolve the object type by one listing)\n"
+    "        When the object is not in the stat cache, s3fs checks \"dir\",\n"
+    "        \"dir/\", \"dir_$folder$\" and the directory without object in\n"
+    "        order, and it needs up to three HEAD requests and one ListBucket\n"
+    "        request. If this option is specified, s3fs resolves all these\n"
+    "        types by one ListBucket request and sends only one HEAD request\n"
+    "        to the found object. This reduces the requests for lookups of\n"
+    "        the objects which do not exist and the directories.\n"
+    "        If the listing is truncated by many similar names, s3fs checks\n"
+    "        the object by HEAD requests as same as without this option.\n"
+    "\n"
+    "   prefetch_dir_stat (default is disable)\n"
+    "        If this option is specified, s3fs starts listing the directory\n"
+    "        and getting the stats of its objects in the background when the\n"
+    "        directory is opened, and the following readdir uses the result.\n"
+    "        This is useful for the tools which open the directory and do\n"
+    "        other work before reading it.\n"
+    "\n"
     "   use_wtf8 - support arbitrary file system encoding.\n"
     "        S3 requires all object names to be valid UTF-8. But some\n"
     "        clients, notably Windows NFS clients, use their own encoding.\n"
@@ -521,6 +655,18 @@ static const char help_string[] =
     "        be specified as year, month, day, hour, minute, second, and it is\n"
     "        expressed as \"Y\", \"M\", \"D\", \"h\", \"m\", \"s\" respectively.\n"
     "        For example, \"1Y6M10D12h30m30s\".\n"
+    " --warm-cache=<path>\n"
+    "        Download the object to the cache directory(use_cache) with its\n"
+    "        stats file, so that the mounted s3fs can read it from the cache\n"
+    "        at first. If the path ends with \"/\", it is a prefix and all\n"
+    "        objects under it are downloaded. This option can be specified\n"
+    "        more than once. The objects are downloaded in parallel by the\n"
+    "        parallel_count and multipart_size options, and the ranges which\n"
+    "        have already been cached are not downloaded again.\n"
+    " --warm-cache-list=<file>\n"
+    "        Same as --warm-cache, but the paths are read from the file which\n"
+    "        has a path in each line. Empty lines and lines starting with\n"
+    "        \"#\" are ignored.\n"
     "\n"
     "Miscellaneous Options:\n"
     "\n"
@@ -445,9 +445,130 @@ int append_objects_from_xml(const char* path, xmlDocPtr doc, S3ObjList& head)
     return 0;
 }
 
+//
+// Get raw(not normalized) object keys and common prefixes in list bucket result.
+// This function does not cut any prefix from the names, the names are as
+// same as the keys in the bucket.
+//
+static int get_raw_names_from_xml(xmlDocPtr doc, xmlXPathContextPtr ctx, const char* ex_names, s3obj_list_t& list)
+{
+    xmlXPathObjectPtr names_xp;
+
+    if(NULL == (names_xp = xmlXPathEvalExpression((xmlChar*)ex_names, ctx))){
+        S3FS_PRN_ERR("xmlXPathEvalExpression returns null.");
+        return -1;
+    }
+    if(xmlXPathNodeSetIsEmpty(names_xp->nodesetval)){
+        S3FS_XMLXPATHFREEOBJECT(names_xp);
+        return 0;
+    }
+    xmlNodeSetPtr name_nodes = names_xp->nodesetval;
+    for(int i = 0; i < name_nodes->nodeNr; i++){
+        xmlChar* pname = xmlNodeListGetString(doc, name_nodes->nodeTab[i]->xmlChildrenNode, 1);
+        if(!pname){
+            S3FS_PRN_WARN("name is something wrong. but continue.");
+            continue;
+        }
+        list.push_back(std::string((char*)pname));
+        xmlFree(pname);
+    }
+    S3FS_XMLXPATHFREEOBJECT(names_xp);
+
+    return 0;
+}
+
+int get_raw_objects_from_xml(xmlDocPtr doc, s3obj_list_t& keys, s3obj_list_t& cprefixes)
+{
+    std::string xmlnsurl;
+    std::string ex_keys     = "//";
+    std::string ex_cprefixes= "//";
+
+    if(!doc){
+        return -1;
+    }
+    xmlXPathContextPtr ctx = xmlXPathNewContext(doc);
+
+    if(!noxmlns && GetXmlNsUrl(doc, xmlnsurl)){
+        xmlXPathRegisterNs(ctx, (xmlChar*)"s3", (xmlChar*)xmlnsurl.c_str());
+        ex_keys     += "s3:Contents/s3:Key";
+        ex_cprefixes+= "s3:CommonPrefixes/s3:Prefix";
+    }else{
+        ex_keys     += "Contents/Key";
+        ex_cprefixes+= "CommonPrefixes/Prefix";
+    }
+
+    if(-1 == get_raw_names_from_xml(doc, ctx, ex_keys.c_str(), keys) ||
+       -1 == get_raw_names_from_xml(doc, ctx, ex_cprefixes.c_str(), cprefixes) )
+    {
+        S3FS_PRN_ERR("get_raw_names_from_xml returns with error.");
+        S3FS_XMLXPATHFREECONTEXT(ctx);
+        return -1;
+    }
+    S3FS_XMLXPATHFREECONTEXT(ctx);
+
+    return 0;
+}
+
 //-------------------------------------------------------------------
 // Utility functions
 //-------------------------------------------------------------------
+//
+// Get the error codes for keys from the response of DeleteObjects.
+//
+// example response body:
+//     <?xml version="1.0" encoding="UTF-8"?>
+//     <DeleteResult xmlns="http://s3.amazonaws.com/doc/2006-03-01/">
+//       <Error>
+//         <Key>dir/file</Key>
+//         <Code>AccessDenied</Code>
+//         <Message>Access Denied</Message>
+//       </Error>
+//     </DeleteResult>
+//
+// If the response is "Error" element(not "DeleteResult"), this returns false.
+//
+bool get_delete_objects_errors_from_xml(const char* data, size_t len, std::map<std::string, std::string>& errors)
+{
+    errors.clear();
+    if(!data || 0 == len){
+        // quiet mode without any error may return empty body.
+        return true;
+    }
+
+    xmlDocPtr doc;
+    if(NULL == (doc = xmlReadMemory(data, static_cast<int>(len), "", NULL, 0))){
+        return false;
+    }
+    if(NULL == doc->children || 0 != strcmp(reinterpret_cast<const char*>(doc->children->name), "DeleteResult")){
+        S3FS_XMLFREEDOC(doc);
+        return false;
+    }
+    for(xmlNodePtr cur_node = doc->children->children; NULL != cur_node; cur_node = cur_node->next){
+        if(XML_ELEMENT_NODE != cur_node->type || 0 != strcmp(reinterpret_cast<const char*>(cur_node->name), "Error")){
+            continue;
+        }
+        std::string key;
+        std::string code;
+        for(xmlNodePtr sub_node = cur_node->children; NULL != sub_node; sub_node = sub_node->next){
+            if(XML_ELEMENT_NODE != sub_node->type || !sub_node->children || XML_TEXT_NODE != sub_node->children->type){
+                continue;
+            }
+            std::string elementName = reinterpret_cast<const char*>(sub_node->name);
+            if(elementName == "Key"){
+                key = reinterpret_cast<const char*>(sub_node->children->content);
+            }else if(elementName == "Code"){
+                code = reinterpret_cast<const char*>(sub_node->children->content);
+            }
+        }
+        if(!key.empty()){
+            errors[key] = code;
+        }
+    }
+    S3FS_XMLFREEDOC(doc);
+
+    return true;
+}
+
 bool simple_parse_xml(const char* data, size_t len, const char* key, std::string& value)
 {
     bool result = false;
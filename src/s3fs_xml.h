@@ -26,6 +26,7 @@
 #include <libxml/tree.h>
 
 #include <string>
+#include <map>
 
 #include "s3objlist.h"
 #include "mpu_util.h"
@@ -36,10 +37,13 @@
 bool is_truncated(xmlDocPtr doc);
 int append_objects_from_xml_ex(const char* path, xmlDocPtr doc, xmlXPathContextPtr ctx, const char* ex_contents, const char* ex_key, const char* ex_etag, int isCPrefix, S3ObjList& head);
 int append_objects_from_xml(const char* path, xmlDocPtr doc, S3ObjList& head);
+int get_raw_objects_from_xml(xmlDocPtr doc, s3obj_list_t& keys, s3obj_list_t& cprefixes);
 xmlChar* get_next_continuation_token(xmlDocPtr doc);
 xmlChar* get_next_marker(xmlDocPtr doc);
 bool get_incomp_mpu_list(xmlDocPtr doc, incomp_mpu_list_t& list);
 
+bool get_delete_objects_errors_from_xml(const char* data, size_t len, std::map<std::string, std::string>& errors);
+
 bool simple_parse_xml(const char* data, size_t len, const char* key, std::string& value);
 
 #endif // S3FS_S3FS_XML_H_
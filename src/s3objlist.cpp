@@ -20,11 +20,58 @@
 
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
+
+#include <algorithm>
 
 #include "common.h"
 #include "s3fs.h"
 #include "s3objlist.h"
 
+//-------------------------------------------------------------------
+// Class S3ObjArena
+//-------------------------------------------------------------------
+const size_t S3ObjArena::BLOCK_SIZE;
+
+const char* S3ObjArena::Add(const char* str, size_t len)
+{
+    char* ptr;
+    if(BLOCK_SIZE < len + 1){
+        // large string is allocated in its own block(not last block)
+        ptr = new char[len + 1];
+        blocks.insert(blocks.begin(), ptr);
+    }else{
+        if(BLOCK_SIZE < block_used + len + 1){
+            blocks.push_back(new char[BLOCK_SIZE]);
+            block_used = 0;
+        }
+        ptr         = blocks.back() + block_used;
+        block_used += len + 1;
+    }
+    memcpy(ptr, str, len);
+    ptr[len] = '\0';
+    return ptr;
+}
+
+void S3ObjArena::Clear()
+{
+    for(std::vector<char*>::iterator iter = blocks.begin(); iter != blocks.end(); ++iter){
+        delete[] *iter;
+    }
+    blocks.clear();
+    block_used = BLOCK_SIZE;
+}
+
+//-------------------------------------------------------------------
+// Utility for S3ObjList
+//-------------------------------------------------------------------
+struct s3obj_entry_cmp{
+    bool operator()(const s3obj_entry& src1, const s3obj_entry& src2) const
+    {
+        return (strcmp(src1.name, src2.name) < 0);
+    }
+};
+
 //-------------------------------------------------------------------
 // Class S3ObjList
 //-------------------------------------------------------------------
@@ -41,7 +88,6 @@ bool S3ObjList::insert(const char* name, const char* etag, bool is_dir)
         return false;
     }
 
-    s3obj_t::iterator iter;
     std::string newname;
     std::string orgname = name;
 
@@ -63,44 +109,26 @@ bool S3ObjList::insert(const char* name, const char* etag, bool is_dir)
         }
     }
 
-    // Check derived name object.
-    if(is_dir){
-        std::string chkname = newname.substr(0, newname.length() - 1);
-        if(objects.end() != (iter = objects.find(chkname))){
-            // found "dir" object --> remove it.
-            objects.erase(iter);
-        }
-    }else{
-        std::string chkname = newname + "/";
-        if(objects.end() != (iter = objects.find(chkname))){
-            // found "dir/" object --> not add new object.
-            // and add normalization
-            return insert_normalized(orgname.c_str(), chkname.c_str(), true);
-        }
-    }
-
     // Add object
-    if(objects.end() != (iter = objects.find(newname))){
-        // Found same object --> update information.
-        (*iter).second.normalname.erase();
-        (*iter).second.orgname = orgname;
-        (*iter).second.is_dir  = is_dir;
-        if(etag){
-            (*iter).second.etag = std::string(etag);  // over write
-        }
-    }else{
-        // add new object
-        s3obj_entry newobject;
-        newobject.orgname = orgname;
-        newobject.is_dir  = is_dir;
-        if(etag){
-            newobject.etag = etag;
-        }
-        objects[newname] = newobject;
+    //
+    // [NOTE]
+    // The same name object and the derived name object("dir" and "dir/")
+    // are merged when sorting.
+    //
+    s3obj_entry newobject;
+    newobject.orgname    = arena.Add(orgname);
+    newobject.name       = (newname == orgname ? newobject.orgname : arena.Add(newname));
+    newobject.normalname = NULL;
+    newobject.etag       = (etag ? arena.Add(etag, strlen(etag)) : NULL);
+    newobject.is_dir     = is_dir;
+    objects.push_back(newobject);
+
+    if(!lastname || 0 > strcmp(lastname, newobject.orgname)){
+        lastname = newobject.orgname;
     }
 
     // add normalization
-    return insert_normalized(orgname.c_str(), newname.c_str(), is_dir);
+    return insert_normalized(newobject.orgname, newobject.name, is_dir);
 }
 
 bool S3ObjList::insert_normalized(const char* name, const char* normalized, bool is_dir)
@@ -112,34 +140,85 @@ bool S3ObjList::insert_normalized(const char* name, const char* normalized, bool
         return true;
     }
 
-    s3obj_t::iterator iter;
-    if(objects.end() != (iter = objects.find(name))){
-        // found name --> over write
-        iter->second.orgname.erase();
-        iter->second.etag.erase();
-        iter->second.normalname = normalized;
-        iter->second.is_dir     = is_dir;
-    }else{
-        // not found --> add new object
-        s3obj_entry newobject;
-        newobject.normalname = normalized;
-        newobject.is_dir     = is_dir;
-        objects[name]        = newobject;
-    }
+    s3obj_entry newobject;
+    newobject.name       = name;
+    newobject.normalname = normalized;
+    newobject.orgname    = NULL;
+    newobject.etag       = NULL;
+    newobject.is_dir     = is_dir;
+    objects.push_back(newobject);
+
     return true;
 }
 
-const s3obj_entry* S3ObjList::GetS3Obj(const char* name) const
+//
+// Sort and merge the objects which are appended after last sorting.
+//
+// [NOTE]
+// When there are same name objects, the later one is used. But if the
+// later one does not have ETag, the ETag of earlier one is kept.
+// When there are both "dir" and "dir/" objects, "dir" is changed to the
+// normalized entry for "dir/".
+//
+void S3ObjList::Sort() const
 {
-    s3obj_t::const_iterator iter;
+    if(sorted_count == objects.size()){
+        return;
+    }
+    s3obj_t::iterator middle = objects.begin() + sorted_count;
+    std::stable_sort(middle, objects.end(), s3obj_entry_cmp());
+    std::inplace_merge(objects.begin(), middle, objects.end(), s3obj_entry_cmp());
 
+    // merge same name objects
+    s3obj_t::iterator out = objects.begin();
+    for(s3obj_t::iterator iter = objects.begin(); iter != objects.end(); ){
+        s3obj_entry merged = *iter;
+        for(++iter; iter != objects.end() && 0 == strcmp(iter->name, merged.name); ++iter){
+            const char* etag = merged.etag;
+            bool is_both_obj = (!merged.normalname && !iter->normalname);
+            merged           = *iter;
+            if(is_both_obj && !merged.etag){
+                merged.etag = etag;
+            }
+        }
+        *out++ = merged;
+    }
+    objects.erase(out, objects.end());
+
+    // check derived name object
+    for(s3obj_t::iterator iter = objects.begin(); iter != objects.end(); ++iter){
+        if(iter->normalname || iter->is_dir){
+            continue;
+        }
+        std::string chkname = std::string(iter->name) + "/";
+        s3obj_entry chkobj;
+        chkobj.name = chkname.c_str();
+        s3obj_t::iterator diriter = std::lower_bound(iter, objects.end(), chkobj, s3obj_entry_cmp());
+        if(diriter != objects.end() && !diriter->normalname && 0 == strcmp(diriter->name, chkobj.name)){
+            // found "dir/" object --> "dir" is normalized to it.
+            iter->normalname = diriter->name;
+            iter->orgname    = NULL;
+            iter->etag       = NULL;
+            iter->is_dir     = true;
+        }
+    }
+    sorted_count = objects.size();
+}
+
+const s3obj_entry* S3ObjList::GetS3Obj(const char* name) const
+{
     if(!name || '\0' == name[0]){
         return NULL;
     }
-    if(objects.end() == (iter = objects.find(name))){
+    Sort();
+
+    s3obj_entry chkobj;
+    chkobj.name = name;
+    s3obj_t::const_iterator iter = std::lower_bound(objects.begin(), objects.end(), chkobj, s3obj_entry_cmp());
+    if(objects.end() == iter || 0 != strcmp(iter->name, name)){
         return NULL;
     }
-    return &((*iter).second);
+    return &(*iter);
 }
 
 std::string S3ObjList::GetOrgName(const char* name) const
@@ -149,10 +228,10 @@ std::string S3ObjList::GetOrgName(const char* name) const
     if(!name || '\0' == name[0]){
         return std::string("");
     }
-    if(NULL == (ps3obj = GetS3Obj(name))){
+    if(NULL == (ps3obj = GetS3Obj(name)) || !ps3obj->orgname){
         return std::string("");
     }
-    return ps3obj->orgname;
+    return std::string(ps3obj->orgname);
 }
 
 std::string S3ObjList::GetNormalizedName(const char* name) const
@@ -165,10 +244,10 @@ std::string S3ObjList::GetNormalizedName(const char* name) const
     if(NULL == (ps3obj = GetS3Obj(name))){
         return std::string("");
     }
-    if(ps3obj->normalname.empty()){
+    if(!ps3obj->normalname){
         return std::string(name);
     }
-    return ps3obj->normalname;
+    return std::string(ps3obj->normalname);
 }
 
 std::string S3ObjList::GetETag(const char* name) const
@@ -178,10 +257,10 @@ std::string S3ObjList::GetETag(const char* name) const
     if(!name || '\0' == name[0]){
         return std::string("");
     }
-    if(NULL == (ps3obj = GetS3Obj(name))){
+    if(NULL == (ps3obj = GetS3Obj(name)) || !ps3obj->etag){
         return std::string("");
     }
-    return ps3obj->etag;
+    return std::string(ps3obj->etag);
 }
 
 bool S3ObjList::IsDir(const char* name) const
@@ -194,35 +273,31 @@ bool S3ObjList::IsDir(const char* name) const
     return ps3obj->is_dir;
 }
 
+//
+// [NOTE]
+// The last name is kept when inserting, because this is called for
+// each listing page and scanning all objects is too slow for very
+// large listings.
+//
 bool S3ObjList::GetLastName(std::string& lastname) const
 {
-    bool result = false;
-    lastname = "";
-    for(s3obj_t::const_iterator iter = objects.begin(); iter != objects.end(); ++iter){
-        if((*iter).second.orgname.length()){
-            if(0 > strcmp(lastname.c_str(), (*iter).second.orgname.c_str())){
-                lastname = (*iter).second.orgname;
-                result = true;
-            }
-        }else{
-            if(0 > strcmp(lastname.c_str(), (*iter).second.normalname.c_str())){
-                lastname = (*iter).second.normalname;
-                result = true;
-            }
-        }
+    if(!this->lastname){
+        lastname = "";
+        return false;
     }
-    return result;
+    lastname = this->lastname;
+    return true;
 }
 
 bool S3ObjList::GetNameList(s3obj_list_t& list, bool OnlyNormalized, bool CutSlash) const
 {
-    s3obj_t::const_iterator iter;
+    Sort();
 
-    for(iter = objects.begin(); objects.end() != iter; ++iter){
-        if(OnlyNormalized && !iter->second.normalname.empty()){
+    for(s3obj_t::const_iterator iter = objects.begin(); objects.end() != iter; ++iter){
+        if(OnlyNormalized && iter->normalname){
             continue;
         }
-        std::string name = (*iter).first;
+        std::string name = iter->name;
         if(CutSlash && 1 < name.length() && '/' == *name.rbegin()){
             // only "/" std::string is skipped this.
             name.erase(name.length() - 1);
@@ -232,6 +307,24 @@ bool S3ObjList::GetNameList(s3obj_list_t& list, bool OnlyNormalized, bool CutSla
     return true;
 }
 
+//
+// Get pointers to the normalized names(directory name has "/") without
+// copying strings. The pointers are valid while this object exists and
+// no object is inserted.
+//
+bool S3ObjList::GetNamePtrList(s3obj_ptrlist_t& list) const
+{
+    Sort();
+
+    list.reserve(list.size() + objects.size());
+    for(s3obj_t::const_iterator iter = objects.begin(); objects.end() != iter; ++iter){
+        if(!iter->normalname){
+            list.push_back(iter->name);
+        }
+    }
+    return true;
+}
+
 typedef std::map<std::string, bool> s3obj_h_t;
 
 bool S3ObjList::MakeHierarchizedList(s3obj_list_t& list, bool haveSlash)
@@ -21,38 +21,80 @@
 #ifndef S3FS_S3OBJLIST_H_
 #define S3FS_S3OBJLIST_H_
 
+#include <vector>
+
 //-------------------------------------------------------------------
 // Structure / Typedef
 //-------------------------------------------------------------------
+//
+// All strings are allocated in the string arena of S3ObjList.
+//
 struct s3obj_entry{
-    std::string normalname; // normalized name: if empty, object is normalized name.
-    std::string orgname;    // original name: if empty, object is original name.
-    std::string etag;
+    const char* name;       // normalized name or original name(for normalized entry)
+    const char* normalname; // normalized name: if NULL, object is normalized name.
+    const char* orgname;    // original name: if NULL, object is original name.
+    const char* etag;
     bool        is_dir;
-
-    s3obj_entry() : is_dir(false) {}
 };
 
-typedef std::map<std::string, struct s3obj_entry> s3obj_t;
+typedef std::vector<s3obj_entry> s3obj_t;
 typedef std::list<std::string> s3obj_list_t;
+typedef std::vector<const char*> s3obj_ptrlist_t;
+
+//-------------------------------------------------------------------
+// Class S3ObjArena
+//-------------------------------------------------------------------
+// Simple string arena for S3ObjList.
+// Strings are allocated in large blocks and are freed all together,
+// this avoids a lot of small allocations for very large listings.
+//
+class S3ObjArena
+{
+    private:
+        static const size_t BLOCK_SIZE = 64 * 1024;
+
+        std::vector<char*> blocks;
+        size_t             block_used;      // used size in the last block
+
+    private:
+        S3ObjArena(const S3ObjArena&);
+        S3ObjArena& operator=(const S3ObjArena&);
+
+    public:
+        S3ObjArena() : block_used(BLOCK_SIZE) {}
+        ~S3ObjArena() { Clear(); }
+
+        const char* Add(const char* str, size_t len);
+        const char* Add(const std::string& str) { return Add(str.c_str(), str.length()); }
+        void Clear();
+};
 
 //-------------------------------------------------------------------
 // Class S3ObjList
 //-------------------------------------------------------------------
+// [NOTE]
+// The objects are appended to the vector, and they are sorted and
+// merged lazily when the list is referenced. So inserting is O(1) and
+// referencing by name is O(log n).
+//
 class S3ObjList
 {
     private:
-        s3obj_t objects;
+        S3ObjArena      arena;
+        mutable s3obj_t objects;
+        mutable size_t  sorted_count;       // the count of sorted objects in the head of vector
+        const char*     lastname;           // the last(greatest) original name
 
     private:
+        S3ObjList(const S3ObjList&);
+        S3ObjList& operator=(const S3ObjList&);
+
         bool insert_normalized(const char* name, const char* normalized, bool is_dir);
+        void Sort() const;
         const s3obj_entry* GetS3Obj(const char* name) const;
 
-        s3obj_t::const_iterator begin() const { return objects.begin(); }
-        s3obj_t::const_iterator end() const { return objects.end(); }
-
     public:
-        S3ObjList() {}
+        S3ObjList() : sorted_count(0), lastname(NULL) {}
         ~S3ObjList() {}
 
         bool IsEmpty() const { return objects.empty(); }
@@ -62,6 +104,7 @@ class S3ObjList
         std::string GetETag(const char* name) const;
         bool IsDir(const char* name) const;
         bool GetNameList(s3obj_list_t& list, bool OnlyNormalized = true, bool CutSlash = true) const;
+        bool GetNamePtrList(s3obj_ptrlist_t& list) const;
         bool GetLastName(std::string& lastname) const;
 
         static bool MakeHierarchizedList(s3obj_list_t& list, bool haveSlash);
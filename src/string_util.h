@@ -89,6 +89,7 @@ bool convert_unixtime_from_option_arg(const char* argv, time_t& unixtime);
 std::string urlEncode(const std::string &s);
 std::string urlEncode2(const std::string &s);
 std::string urlDecode(const std::string& s);
+std::string xmlEncode(const std::string& s);
 
 bool takeout_str_dquart(std::string& str);
 bool get_keyword_value(const std::string& target, const char* keyword, std::string& value);
@@ -0,0 +1,266 @@
+/*
+ * s3fs - FUSE-based file system backed by Amazon S3
+ *
+ * Copyright(C) 2007 Randy Rizun <rrizun@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <set>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+
+#include "common.h"
+#include "s3fs.h"
+#include "fdcache_index.h"
+#include "test_util.h"
+
+//-------------------------------------------------------------------
+// Global variables for test_fdcache_index
+//-------------------------------------------------------------------
+bool foreground                   = false;
+std::string instance_name;
+
+void test_lru_order()
+{
+    CacheFileIndex index;
+    std::string    path;
+    off_t          size = 0;
+
+    ASSERT_FALSE(index.GetLeastRecentlyUsed(path, size));
+
+    index.Set("/file1", 100, 30);
+    index.Set("/file2", 200, 10);
+    index.Set("/dir/file3", 300, 20);
+    ASSERT_EQUALS(static_cast<size_t>(3), index.Count());
+    ASSERT_EQUALS(static_cast<off_t>(600), index.TotalSize());
+
+    ASSERT_TRUE(index.GetLeastRecentlyUsed(path, size));
+    ASSERT_EQUALS(std::string("/file2"), path);
+    ASSERT_EQUALS(static_cast<off_t>(200), size);
+
+    // accessed file moves to the end
+    ASSERT_TRUE(index.Touch("/file2", 40));
+    ASSERT_FALSE(index.Touch("/nothing", 40));
+    ASSERT_TRUE(index.GetLeastRecentlyUsed(path, size));
+    ASSERT_EQUALS(std::string("/dir/file3"), path);
+
+    // excluded file is skipped
+    std::set<std::string> excludes;
+    excludes.insert("/dir/file3");
+    ASSERT_TRUE(index.GetLeastRecentlyUsed(path, size, &excludes));
+    ASSERT_EQUALS(std::string("/file1"), path);
+
+    // updating size keeps total size
+    index.Set("/file1", 50, 50);
+    ASSERT_EQUALS(static_cast<size_t>(3), index.Count());
+    ASSERT_EQUALS(static_cast<off_t>(550), index.TotalSize());
+
+    // updating only size keeps order
+    ASSERT_TRUE(index.SetSize("/dir/file3", 100));
+    ASSERT_FALSE(index.SetSize("/nothing", 100));
+    ASSERT_EQUALS(static_cast<off_t>(350), index.TotalSize());
+    ASSERT_TRUE(index.GetLeastRecentlyUsed(path, size));
+    ASSERT_EQUALS(std::string("/dir/file3"), path);
+    ASSERT_EQUALS(static_cast<off_t>(100), size);
+}
+
+void test_remove_rename()
+{
+    CacheFileIndex index;
+    std::string    path;
+    off_t          size = 0;
+
+    index.Set("/dir/file1", 100, 10);
+    index.Set("/dir/sub/file2", 200, 20);
+    index.Set("/dir2/file3", 300, 30);
+    index.Set("/file4", 400, 40);
+
+    ASSERT_TRUE(index.Rename("/file4", "/file5"));
+    ASSERT_FALSE(index.Rename("/file4", "/file6"));
+    ASSERT_FALSE(index.Remove("/file4"));
+    ASSERT_EQUALS(static_cast<off_t>(1000), index.TotalSize());
+
+    // "/dir2" is not under "/dir"
+    ASSERT_EQUALS(static_cast<size_t>(2), index.RemoveTree("/dir"));
+    ASSERT_EQUALS(static_cast<size_t>(2), index.Count());
+    ASSERT_EQUALS(static_cast<off_t>(700), index.TotalSize());
+
+    ASSERT_TRUE(index.GetLeastRecentlyUsed(path, size));
+    ASSERT_EQUALS(std::string("/dir2/file3"), path);
+    ASSERT_TRUE(index.Remove("/dir2/file3"));
+    ASSERT_TRUE(index.GetLeastRecentlyUsed(path, size));
+    ASSERT_EQUALS(std::string("/file5"), path);
+
+    index.Clear();
+    ASSERT_EQUALS(static_cast<size_t>(0), index.Count());
+    ASSERT_EQUALS(static_cast<off_t>(0), index.TotalSize());
+}
+
+void test_content()
+{
+    CacheFileIndex index;
+    std::string    path;
+
+    ASSERT_FALSE(index.SetContent("/file1", "etag1:100"));
+    index.Set("/file1", 100, 10);
+    index.Set("/file2", 200, 20);
+    ASSERT_TRUE(index.SetContent("/file1", "etag1:100"));
+    ASSERT_FALSE(index.FindContent("etag2:200", path));
+    ASSERT_TRUE(index.FindContent("etag1:100", path));
+    ASSERT_EQUALS(std::string("/file1"), path);
+
+    // content follows the renamed file
+    ASSERT_TRUE(index.Rename("/file1", "/file3"));
+    ASSERT_TRUE(index.FindContent("etag1:100", path));
+    ASSERT_EQUALS(std::string("/file3"), path);
+
+    // updating the cache file clears content
+    index.Set("/file3", 100, 30);
+    ASSERT_FALSE(index.FindContent("etag1:100", path));
+
+    ASSERT_TRUE(index.SetContent("/file2", "etag2:200"));
+    ASSERT_TRUE(index.SetContent("/file3", "etag2:200"));
+    ASSERT_TRUE(index.Remove("/file2"));
+    ASSERT_TRUE(index.FindContent("etag2:200", path));
+    ASSERT_EQUALS(std::string("/file3"), path);
+    ASSERT_TRUE(index.SetContent("/file3", ""));
+    ASSERT_FALSE(index.FindContent("etag2:200", path));
+}
+
+void test_merge_directory()
+{
+    CacheFileIndex index;
+    std::string    path;
+    off_t          size = 0;
+
+    index.Set("/file1", 100, 10);
+    index.Set("/file2", 200, 20);
+    index.Set("/dir/file3", 300, 30);
+    index.Set("/dir/sub/file4", 400, 40);
+    index.Set("/dir2/file5", 500, 50);
+    index.Set("/dir-x/file6", 600, 60);
+    index.Set("/dir/file8", 800, 80, 8);
+    ASSERT_TRUE(index.SetContent("/dir/file3", "etag3:300"));
+    ASSERT_TRUE(index.SetContent("/dir/file8", "etag8:800"));
+
+    // "/dir" is changed: file3 is resized, file7 is added and "sub" is removed.
+    // The cache files under "/dir2" and "/dir-x" are not changed.
+    cache_index_map_t     files;
+    std::set<std::string> subdirs;
+    files["file3"] = cache_index_entry(350, 100);
+    files["file7"] = cache_index_entry(700, 5);
+    files["file7"].content = "etag7:700";
+    files["file8"] = cache_index_entry(800, 90, 8);
+    ASSERT_EQUALS(static_cast<size_t>(3), index.MergeDirectory("/dir", files, subdirs));
+    ASSERT_EQUALS(static_cast<size_t>(7), index.Count());
+    ASSERT_EQUALS(static_cast<off_t>(100 + 200 + 350 + 500 + 600 + 700 + 800), index.TotalSize());
+
+    // the resized cache file loses the content key, and the unchanged one keeps it
+    ASSERT_FALSE(index.FindContent("etag3:300", path));
+    ASSERT_TRUE(index.FindContent("etag8:800", path));
+    ASSERT_EQUALS(std::string("/dir/file8"), path);
+
+    // the modified cache file loses the content key
+    files["file8"] = cache_index_entry(800, 90, 9);
+    ASSERT_EQUALS(static_cast<size_t>(1), index.MergeDirectory("/dir", files, subdirs));
+    ASSERT_FALSE(index.FindContent("etag8:800", path));
+    ASSERT_TRUE(index.Remove("/dir/file8"));
+    files.erase("file8");
+
+    // the existing cache file keeps the last access time
+    ASSERT_TRUE(index.GetLeastRecentlyUsed(path, size));
+    ASSERT_EQUALS(std::string("/dir/file7"), path);
+
+    // the new cache file is added with its content key
+    ASSERT_TRUE(index.FindContent("etag7:700", path));
+    ASSERT_EQUALS(std::string("/dir/file7"), path);
+    ASSERT_TRUE(index.Remove("/dir/file7"));
+    ASSERT_FALSE(index.FindContent("etag7:700", path));
+    ASSERT_TRUE(index.Remove("/file1"));
+    ASSERT_TRUE(index.Remove("/file2"));
+    ASSERT_TRUE(index.GetLeastRecentlyUsed(path, size));
+    ASSERT_EQUALS(std::string("/dir/file3"), path);
+    ASSERT_EQUALS(static_cast<off_t>(350), size);
+
+    // the top directory: "dir2" is removed, the existing subdirectories are skipped
+    files.clear();
+    subdirs.clear();
+    subdirs.insert("dir");
+    subdirs.insert("dir-x");
+    ASSERT_EQUALS(static_cast<size_t>(1), index.MergeDirectory("", files, subdirs));
+    ASSERT_EQUALS(static_cast<size_t>(2), index.Count());
+    ASSERT_FALSE(index.Remove("/dir2/file5"));
+
+    // nothing is changed
+    subdirs.insert("dir2");
+    ASSERT_EQUALS(static_cast<size_t>(0), index.MergeDirectory("/", files, subdirs));
+    ASSERT_EQUALS(static_cast<off_t>(350 + 600), index.TotalSize());
+}
+
+void test_lock_unused_file()
+{
+    CacheFileIndex index;
+    char           cache_path[] = "/tmp/test_fdcache_index.XXXXXX";
+    int            fd;
+
+    ASSERT_TRUE(-1 != (fd = mkstemp(cache_path)));
+    index.Set("/file1", 100, 10);
+
+    // the cache file opened by the other(shared lock) is not locked
+    ASSERT_EQUALS(0, flock(fd, LOCK_SH));
+    ASSERT_EQUALS(-1, index.LockUnusedFile("/file1", cache_path));
+    ASSERT_EQUALS(0, flock(fd, LOCK_UN));
+
+    int lockfd;
+    ASSERT_TRUE(-1 != (lockfd = index.LockUnusedFile("/file1", cache_path)));
+    ASSERT_EQUALS(-1, flock(fd, LOCK_SH | LOCK_NB));
+    close(lockfd);
+    ASSERT_EQUALS(0, flock(fd, LOCK_SH | LOCK_NB));
+    close(fd);
+
+    // the cache file which does not exist is removed from the index
+    ASSERT_EQUALS(static_cast<size_t>(1), index.Count());
+    unlink(cache_path);
+    ASSERT_EQUALS(-1, index.LockUnusedFile("/file1", cache_path));
+    ASSERT_EQUALS(static_cast<size_t>(0), index.Count());
+}
+
+int main(int argc, char *argv[])
+{
+    S3fsLog singletonLog;
+
+    test_lru_order();
+    test_remove_rename();
+    test_content();
+    test_merge_directory();
+    test_lock_unused_file();
+
+    return 0;
+}
+
+/*
+* Local variables:
+* tab-width: 4
+* c-basic-offset: 4
+* End:
+* vim600: expandtab sw=4 ts=4 fdm=marker
+* vim<600: expandtab sw=4 ts=4
+*/
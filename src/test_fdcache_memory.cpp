@@ -0,0 +1,135 @@
+/*
+ * s3fs - FUSE-based file system backed by Amazon S3
+ *
+ * Copyright(C) 2007 Randy Rizun <rrizun@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "common.h"
+#include "s3fs.h"
+#include "fdcache_memory.h"
+#include "test_util.h"
+
+//-------------------------------------------------------------------
+// Global variables for test_fdcache_memory
+//-------------------------------------------------------------------
+bool foreground                   = false;
+std::string instance_name;
+
+void test_read_write()
+{
+    MemoryBlockCache cache;
+    off_t            bsize = MemoryBlockCache::GetBlockSize();
+    std::string      block0(static_cast<size_t>(bsize), 'a');
+    std::string      block1(100, 'b');
+    char             buf[256];
+
+    // disabled
+    ASSERT_FALSE(cache.IsEnabled());
+    ASSERT_FALSE(cache.Write("/file1", "etag1", 0, block0.c_str(), block0.size()));
+
+    cache.SetMaxSize(bsize * 4);
+    ASSERT_TRUE(cache.IsEnabled());
+    ASSERT_FALSE(cache.Read("/file1", "etag1", 0, 10, buf));
+
+    // block must start at the block boundary
+    ASSERT_FALSE(cache.Write("/file1", "etag1", 10, block1.c_str(), block1.size()));
+
+    ASSERT_TRUE(cache.Write("/file1", "etag1", 0, block0.c_str(), block0.size()));
+    ASSERT_TRUE(cache.Has("/file1", "etag1", 0));
+    ASSERT_FALSE(cache.Has("/file1", "etag1", bsize));
+    ASSERT_TRUE(cache.Read("/file1", "etag1", 10, 10, buf));
+    ASSERT_EQUALS(0, memcmp(buf, block0.c_str(), 10));
+
+    // range over the blocks needs all blocks
+    ASSERT_FALSE(cache.Read("/file1", "etag1", bsize - 10, 20, buf));
+    ASSERT_TRUE(cache.Write("/file1", "etag1", bsize, block1.c_str(), block1.size()));
+    ASSERT_TRUE(cache.Read("/file1", "etag1", bsize - 10, 20, buf));
+    ASSERT_EQUALS(0, memcmp(buf, block0.c_str(), 10));
+    ASSERT_EQUALS(0, memcmp(&buf[10], block1.c_str(), 10));
+
+    // over the end of the last block
+    ASSERT_FALSE(cache.Read("/file1", "etag1", bsize + 90, 20, buf));
+
+    // other ETag
+    ASSERT_FALSE(cache.Read("/file1", "etag2", 0, 10, buf));
+    ASSERT_TRUE(cache.Write("/file1", "etag2", 0, block1.c_str(), block1.size()));
+    ASSERT_FALSE(cache.Has("/file1", "etag1", 0));
+    ASSERT_EQUALS(static_cast<size_t>(1), cache.Count());
+    ASSERT_EQUALS(static_cast<off_t>(100), cache.TotalSize());
+}
+
+void test_evict()
+{
+    MemoryBlockCache cache;
+    off_t            bsize = MemoryBlockCache::GetBlockSize();
+    std::string      block(static_cast<size_t>(bsize), 'a');
+    char             buf[16];
+
+    cache.SetMaxSize(bsize * 2);
+    ASSERT_TRUE(cache.Write("/file1", "etag1", 0, block.c_str(), block.size()));
+    ASSERT_TRUE(cache.Write("/file2", "etag2", 0, block.c_str(), block.size()));
+
+    // accessed block moves to the end
+    ASSERT_TRUE(cache.Read("/file1", "etag1", 0, sizeof(buf), buf));
+    ASSERT_TRUE(cache.Write("/file3", "etag3", 0, block.c_str(), block.size()));
+    ASSERT_TRUE(cache.Has("/file1", "etag1", 0));
+    ASSERT_FALSE(cache.Has("/file2", "etag2", 0));
+    ASSERT_EQUALS(static_cast<size_t>(2), cache.Count());
+    ASSERT_EQUALS(bsize * 2, cache.TotalSize());
+
+    // renamed blocks are evicted by new path
+    ASSERT_TRUE(cache.Rename("/file1", "/file4"));
+    ASSERT_FALSE(cache.Rename("/file1", "/file5"));
+    ASSERT_TRUE(cache.Has("/file4", "etag1", 0));
+    ASSERT_TRUE(cache.Write("/file5", "etag5", 0, block.c_str(), block.size()));
+    ASSERT_TRUE(cache.Write("/file6", "etag6", 0, block.c_str(), block.size()));
+    ASSERT_FALSE(cache.Has("/file4", "etag1", 0));
+    ASSERT_FALSE(cache.Has("/file3", "etag3", 0));
+
+    ASSERT_TRUE(cache.Remove("/file5"));
+    ASSERT_FALSE(cache.Remove("/file5"));
+    ASSERT_EQUALS(bsize, cache.TotalSize());
+
+    // shrinking the size evicts blocks
+    cache.SetMaxSize(bsize / 2);
+    ASSERT_EQUALS(static_cast<size_t>(0), cache.Count());
+    ASSERT_EQUALS(static_cast<off_t>(0), cache.TotalSize());
+}
+
+int main(int argc, char *argv[])
+{
+    S3fsLog singletonLog;
+
+    test_read_write();
+    test_evict();
+
+    return 0;
+}
+
+/*
+* Local variables:
+* tab-width: 4
+* c-basic-offset: 4
+* End:
+* vim600: expandtab sw=4 ts=4 fdm=marker
+* vim<600: expandtab sw=4 ts=4
+*/
@@ -0,0 +1,311 @@
+/*
+ * s3fs - FUSE-based file system backed by Amazon S3
+ *
+ * Copyright(C) 2007 Randy Rizun <rrizun@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <list>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "common.h"
+#include "s3fs.h"
+#include "fdcache_page.h"
+#include "test_util.h"
+
+//-------------------------------------------------------------------
+// Global variables for test_fdcache_page
+//-------------------------------------------------------------------
+bool foreground                   = false;
+std::string instance_name;
+
+static const ino_t TEST_INODE = 12345;
+
+//-------------------------------------------------------------------
+// Stub of CacheFileStat
+//-------------------------------------------------------------------
+// [NOTE]
+// The tests use the file descriptor of the temporary file directly,
+// so the cache stat file in the cache directory is not opened.
+//
+bool CacheFileStat::Open()
+{
+    return false;
+}
+
+//-------------------------------------------------------------------
+// Utility functions
+//-------------------------------------------------------------------
+static FILE* make_stat_file(const char* pdata)
+{
+    FILE* pfile;
+    if(NULL == (pfile = tmpfile())){
+        std::cerr << "failed to make temporary file by errno(" << errno << ")" << std::endl;
+        std::exit(1);
+    }
+    if(pdata && 0 < strlen(pdata) && static_cast<ssize_t>(strlen(pdata)) != pwrite(fileno(pfile), pdata, strlen(pdata), 0)){
+        std::cerr << "failed to write temporary file by errno(" << errno << ")" << std::endl;
+        std::exit(1);
+    }
+    return pfile;
+}
+
+static std::string read_stat_file(FILE* pfile)
+{
+    struct stat st;
+    if(0 != fstat(fileno(pfile), &st)){
+        std::cerr << "failed to stat temporary file by errno(" << errno << ")" << std::endl;
+        std::exit(1);
+    }
+    std::string data(static_cast<size_t>(st.st_size), '\0');
+    if(0 < st.st_size && st.st_size != pread(fileno(pfile), &data[0], data.length(), 0)){
+        std::cerr << "failed to read temporary file by errno(" << errno << ")" << std::endl;
+        std::exit(1);
+    }
+    return data;
+}
+
+static bool is_binary_stat_file(FILE* pfile)
+{
+    return (0 == read_stat_file(pfile).compare(0, 4, "S3CS"));
+}
+
+//-------------------------------------------------------------------
+// Tests
+//-------------------------------------------------------------------
+void test_binary_load()
+{
+    FILE*       pfile = make_stat_file(NULL);
+    PageList    pagelist(100, false, false);
+    std::string etag("\"0123456789abcdef\"");
+
+    ASSERT_TRUE(pagelist.SetPageLoadedStatus(0, 40, PageList::PAGE_LOADED));
+    ASSERT_TRUE(pagelist.SetPageLoadedStatus(60, 20, PageList::PAGE_LOAD_MODIFIED));
+    ASSERT_TRUE(pagelist.Serialize(fileno(pfile), true, TEST_INODE, &etag));
+    ASSERT_TRUE(is_binary_stat_file(pfile));
+
+    PageList    loaded;
+    std::string loaded_etag;
+    ASSERT_TRUE(loaded.Serialize(fileno(pfile), false, TEST_INODE, &loaded_etag));
+    ASSERT_EQUALS(etag, loaded_etag);
+    ASSERT_EQUALS(static_cast<off_t>(100), loaded.Size());
+    ASSERT_TRUE(loaded.IsPageLoaded(0, 40));
+    ASSERT_FALSE(loaded.IsPageLoaded(40, 20));
+    ASSERT_TRUE(loaded.IsPageLoaded(60, 20));
+    ASSERT_EQUALS(static_cast<off_t>(40), loaded.GetTotalUnloadedPageSize(0, loaded.Size()));
+    ASSERT_TRUE(loaded.IsModified());
+    ASSERT_EQUALS(static_cast<off_t>(20), loaded.BytesModified());
+
+    // the cache file is replaced
+    PageList other;
+    ASSERT_FALSE(other.Serialize(fileno(pfile), false, TEST_INODE + 1));
+
+    fclose(pfile);
+}
+
+void test_delta_record_append()
+{
+    FILE*       pfile = make_stat_file(NULL);
+    PageList    pagelist(1000, false, false);
+    std::string etag("etag1");
+
+    pagelist.SetBlockAccessTime(0, 300, 100, 30);
+    pagelist.SetBlockAccessTime(100, 100, 100, 10);
+    pagelist.SetBlockAccessTime(200, 100, 100, 20);
+    ASSERT_TRUE(pagelist.SetPageLoadedStatus(0, 300, PageList::PAGE_LOADED));
+    ASSERT_TRUE(pagelist.Serialize(fileno(pfile), true, TEST_INODE, &etag));
+    std::string base = read_stat_file(pfile);
+
+    // changed pages, size and access times are appended after base records
+    ASSERT_TRUE(pagelist.SetPageLoadedStatus(500, 100, PageList::PAGE_LOADED));
+    ASSERT_TRUE(pagelist.Resize(2000, false, false));
+    pagelist.SetBlockAccessTime(100, 100, 100, 40);
+    ASSERT_TRUE(pagelist.Serialize(fileno(pfile), true, TEST_INODE, &etag));
+    std::string appended = read_stat_file(pfile);
+    ASSERT_TRUE(base.length() < appended.length());
+    ASSERT_EQUALS(base, appended.substr(0, base.length()));
+
+    PageList    loaded;
+    std::string loaded_etag;
+    ASSERT_TRUE(loaded.Serialize(fileno(pfile), false, TEST_INODE, &loaded_etag));
+    ASSERT_EQUALS(etag, loaded_etag);
+    ASSERT_EQUALS(static_cast<off_t>(2000), loaded.Size());
+    ASSERT_TRUE(loaded.IsPageLoaded(0, 300));
+    ASSERT_FALSE(loaded.IsPageLoaded(300, 200));
+    ASSERT_TRUE(loaded.IsPageLoaded(500, 100));
+    ASSERT_EQUALS(static_cast<off_t>(1600), loaded.GetTotalUnloadedPageSize(0, loaded.Size()));
+
+    std::list<off_t> blocks;
+    ASSERT_EQUALS(static_cast<size_t>(4), loaded.GetColdBlocks(100, blocks));
+    ASSERT_EQUALS(static_cast<off_t>(500), blocks.front());
+    blocks.pop_front();
+    ASSERT_EQUALS(static_cast<off_t>(200), blocks.front());
+    blocks.pop_front();
+    ASSERT_EQUALS(static_cast<off_t>(0), blocks.front());
+    blocks.pop_front();
+    ASSERT_EQUALS(static_cast<off_t>(100), blocks.front());
+
+    // the loaded list appends delta records too, and the ETag in header is updated
+    std::string etag2("etag2");
+    ASSERT_TRUE(loaded.SetPageLoadedStatus(1000, 1000, PageList::PAGE_LOADED));
+    ASSERT_TRUE(loaded.Serialize(fileno(pfile), true, TEST_INODE, &etag2));
+    std::string appended2 = read_stat_file(pfile);
+    ASSERT_TRUE(appended.length() < appended2.length());
+    ASSERT_EQUALS(appended.substr(base.length()), appended2.substr(base.length(), appended.length() - base.length()));
+
+    PageList    loaded2;
+    ASSERT_TRUE(loaded2.Serialize(fileno(pfile), false, TEST_INODE, &loaded_etag));
+    ASSERT_EQUALS(etag2, loaded_etag);
+    ASSERT_TRUE(loaded2.IsPageLoaded(1000, 1000));
+    ASSERT_EQUALS(static_cast<off_t>(600), loaded2.GetTotalUnloadedPageSize(0, loaded2.Size()));
+
+    // the file which is changed by the other is written completely
+    std::string etag3("etag3");
+    ASSERT_EQUALS(0, ftruncate(fileno(pfile), 0));
+    ASSERT_TRUE(loaded2.Serialize(fileno(pfile), true, TEST_INODE, &etag3));
+    PageList loaded3;
+    ASSERT_TRUE(loaded3.Serialize(fileno(pfile), false, TEST_INODE, &loaded_etag));
+    ASSERT_EQUALS(etag3, loaded_etag);
+    ASSERT_EQUALS(static_cast<off_t>(600), loaded3.GetTotalUnloadedPageSize(0, loaded3.Size()));
+
+    fclose(pfile);
+}
+
+void test_compaction()
+{
+    FILE*    pfile = make_stat_file(NULL);
+    PageList pagelist(1000, false, false);
+
+    ASSERT_TRUE(pagelist.Serialize(fileno(pfile), true, TEST_INODE));
+
+    // many delta records are compacted into base records
+    size_t last_length = read_stat_file(pfile).length();
+    bool   is_compacted = false;
+    for(off_t offset = 0; offset < 1000; offset += 5){
+        ASSERT_TRUE(pagelist.SetPageLoadedStatus(offset, 5, (0 == (offset / 5) % 2 ? PageList::PAGE_LOADED : PageList::PAGE_LOAD_MODIFIED)));
+        ASSERT_TRUE(pagelist.Serialize(fileno(pfile), true, TEST_INODE));
+
+        size_t length = read_stat_file(pfile).length();
+        if(length < last_length){
+            is_compacted = true;
+        }
+        last_length = length;
+
+        PageList loaded;
+        ASSERT_TRUE(loaded.Serialize(fileno(pfile), false, TEST_INODE));
+        ASSERT_TRUE(loaded.IsPageLoaded(0, offset + 5));
+        ASSERT_EQUALS(1000 - (offset + 5), loaded.GetTotalUnloadedPageSize(0, loaded.Size()));
+        ASSERT_EQUALS(pagelist.BytesModified(), loaded.BytesModified());
+    }
+    ASSERT_TRUE(is_compacted);
+
+    fclose(pfile);
+}
+
+void test_text_migration()
+{
+    FILE*       pfile = make_stat_file("12345:100\n0:40:1:0\n40:20:0:0\n60:40:1:1\n");
+    PageList    pagelist;
+    std::string etag("etag");
+
+    // old text format is loaded without ETag
+    ASSERT_FALSE(pagelist.Serialize(fileno(pfile), false, TEST_INODE + 1, &etag));
+    ASSERT_TRUE(pagelist.Serialize(fileno(pfile), false, TEST_INODE, &etag));
+    ASSERT_EQUALS(std::string(""), etag);
+    ASSERT_EQUALS(static_cast<off_t>(100), pagelist.Size());
+    ASSERT_TRUE(pagelist.IsPageLoaded(0, 40));
+    ASSERT_FALSE(pagelist.IsPageLoaded(40, 20));
+    ASSERT_TRUE(pagelist.IsPageLoaded(60, 40));
+    ASSERT_EQUALS(static_cast<off_t>(40), pagelist.BytesModified());
+
+    // it is replaced by binary format at the next save
+    etag = "etag1";
+    ASSERT_TRUE(pagelist.Serialize(fileno(pfile), true, TEST_INODE, &etag));
+    ASSERT_TRUE(is_binary_stat_file(pfile));
+
+    PageList    loaded;
+    std::string loaded_etag;
+    ASSERT_TRUE(loaded.Serialize(fileno(pfile), false, TEST_INODE, &loaded_etag));
+    ASSERT_EQUALS(etag, loaded_etag);
+    ASSERT_EQUALS(static_cast<off_t>(100), loaded.Size());
+    ASSERT_TRUE(loaded.IsPageLoaded(0, 40));
+    ASSERT_FALSE(loaded.IsPageLoaded(40, 20));
+    ASSERT_TRUE(loaded.IsPageLoaded(60, 40));
+    ASSERT_EQUALS(static_cast<off_t>(40), loaded.BytesModified());
+
+    fclose(pfile);
+}
+
+void test_merge_loaded_pages()
+{
+    FILE*       pfile = make_stat_file(NULL);
+    std::string etag("etag1");
+
+    // the other process loaded [0, 300) and modified [400, 500)
+    PageList other(1000, false, false);
+    ASSERT_TRUE(other.SetPageLoadedStatus(0, 300, PageList::PAGE_LOADED));
+    ASSERT_TRUE(other.SetPageLoadedStatus(400, 100, PageList::PAGE_LOAD_MODIFIED));
+    ASSERT_TRUE(other.Serialize(fileno(pfile), true, TEST_INODE, &etag));
+
+    // this process modified [100, 200) without loading
+    PageList pagelist(1000, false, false);
+    ASSERT_TRUE(pagelist.SetPageLoadedStatus(100, 100, PageList::PAGE_MODIFIED));
+
+    // not merged for the other object or the other cache file
+    ASSERT_FALSE(pagelist.MergeLoadedPages(fileno(pfile), TEST_INODE, "etag2"));
+    ASSERT_FALSE(pagelist.MergeLoadedPages(fileno(pfile), TEST_INODE, ""));
+    ASSERT_FALSE(pagelist.MergeLoadedPages(fileno(pfile), TEST_INODE + 1, etag));
+    ASSERT_EQUALS(static_cast<off_t>(900), pagelist.GetTotalUnloadedPageSize(0, pagelist.Size()));
+
+    // only loaded pages are merged, and the modified pages are not changed
+    ASSERT_TRUE(pagelist.MergeLoadedPages(fileno(pfile), TEST_INODE, etag));
+    ASSERT_TRUE(pagelist.IsPageLoaded(0, 100));
+    ASSERT_TRUE(pagelist.IsPageLoaded(200, 100));
+    ASSERT_FALSE(pagelist.IsPageLoaded(300, 100));
+    ASSERT_FALSE(pagelist.IsPageLoaded(400, 100));
+    ASSERT_EQUALS(static_cast<off_t>(100), pagelist.BytesModified());
+    ASSERT_EQUALS(static_cast<off_t>(700), pagelist.GetTotalUnloadedPageSize(0, pagelist.Size()));
+
+    fclose(pfile);
+}
+
+int main(int argc, char *argv[])
+{
+    S3fsLog singletonLog;
+
+    test_binary_load();
+    test_delta_record_append();
+    test_compaction();
+    test_text_migration();
+    test_merge_loaded_pages();
+
+    return 0;
+}
+
+/*
+* Local variables:
+* tab-width: 4
+* c-basic-offset: 4
+* End:
+* vim600: expandtab sw=4 ts=4 fdm=marker
+* vim<600: expandtab sw=4 ts=4
+*/
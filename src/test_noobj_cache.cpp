@@ -0,0 +1,207 @@
+/*
+ * s3fs - FUSE-based file system backed by Amazon S3
+ *
+ * Copyright(C) 2007 Randy Rizun <rrizun@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <stdint.h>
+
+#include "common.h"
+#include "s3fs.h"
+#include "cache.h"
+#include "test_util.h"
+
+// memory size for the table of 16 slots
+static const size_t TEST_MEMORY_SIZE = 256;
+static const size_t TEST_SLOTS       = 16;
+
+//
+// Same hash as NoObjectCache::MakeHash, for making keys which have the
+// same home slot in the table.
+//
+static size_t home_slot(const std::string& key)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for(std::string::const_iterator iter = key.begin(); iter != key.end(); ++iter){
+        hash ^= static_cast<unsigned char>(*iter);
+        hash *= 1099511628211ULL;
+    }
+    return static_cast<size_t>(hash) & (TEST_SLOTS - 1);
+}
+
+//
+// Make count keys whose home slot is slot.
+//
+static std::vector<std::string> make_keys(size_t slot, size_t count, const char* prefix)
+{
+    std::vector<std::string> keys;
+    for(int cnt = 0; keys.size() < count; ++cnt){
+        std::string key = std::string(prefix) + str(cnt);
+        if(slot == home_slot(key)){
+            keys.push_back(key);
+        }
+    }
+    return keys;
+}
+
+void test_collision()
+{
+    NoObjectCache cache;
+    cache.SetMemorySize(TEST_MEMORY_SIZE);
+
+    // three keys in the same chain, and the key of the next slot which is
+    // pushed behind them
+    std::vector<std::string> keys = make_keys(3, 3, "/file");
+    std::vector<std::string> next = make_keys(4, 1, "/next");
+    keys.push_back(next[0]);
+
+    for(std::vector<std::string>::const_iterator iter = keys.begin(); iter != keys.end(); ++iter){
+        ASSERT_FALSE(cache.Get(*iter, -1));
+        ASSERT_TRUE(cache.Add(*iter, -1));
+    }
+    ASSERT_EQUALS(keys.size(), cache.Size());
+    for(std::vector<std::string>::const_iterator iter = keys.begin(); iter != keys.end(); ++iter){
+        ASSERT_TRUE(cache.Get(*iter, -1));
+    }
+    ASSERT_FALSE(cache.Get(make_keys(3, 4, "/file")[3], -1));
+
+    // adding again does not increase
+    ASSERT_TRUE(cache.Add(keys[1], -1));
+    ASSERT_EQUALS(keys.size(), cache.Size());
+}
+
+void test_erase_in_chain()
+{
+    std::vector<std::string> keys = make_keys(3, 3, "/file");
+    std::vector<std::string> next = make_keys(4, 1, "/next");
+    keys.push_back(next[0]);
+
+    // erase each key, and the later keys in the chain are still found
+    for(size_t pos = 0; pos < keys.size(); ++pos){
+        NoObjectCache cache;
+        cache.SetMemorySize(TEST_MEMORY_SIZE);
+        for(std::vector<std::string>::const_iterator iter = keys.begin(); iter != keys.end(); ++iter){
+            ASSERT_TRUE(cache.Add(*iter, -1));
+        }
+
+        cache.Del(keys[pos]);
+        ASSERT_EQUALS(keys.size() - 1, cache.Size());
+        for(size_t cnt = 0; cnt < keys.size(); ++cnt){
+            ASSERT_EQUALS(cnt != pos, cache.Get(keys[cnt], -1));
+        }
+
+        // the slot can be used again
+        ASSERT_TRUE(cache.Add(keys[pos], -1));
+        for(std::vector<std::string>::const_iterator iter = keys.begin(); iter != keys.end(); ++iter){
+            ASSERT_TRUE(cache.Get(*iter, -1));
+        }
+    }
+
+    // "path" and "path/" are removed together
+    NoObjectCache cache;
+    cache.SetMemorySize(TEST_MEMORY_SIZE);
+    ASSERT_TRUE(cache.Add("/dir", -1));
+    ASSERT_TRUE(cache.Add("/dir/", -1));
+    cache.Del("/dir");
+    ASSERT_EQUALS(static_cast<size_t>(0), cache.Size());
+}
+
+void test_expire_and_shrink()
+{
+    NoObjectCache cache;
+    cache.SetMemorySize(TEST_MEMORY_SIZE);
+
+    // the old keys and the new keys(11 keys under 3/4 of 16 slots)
+    std::vector<std::string> olds = make_keys(5, 4, "/old");
+    std::vector<std::string> news;
+    for(int cnt = 0; cnt < 7; ++cnt){
+        news.push_back("/new" + str(cnt));
+    }
+    for(std::vector<std::string>::const_iterator iter = olds.begin(); iter != olds.end(); ++iter){
+        ASSERT_TRUE(cache.Add(*iter, -1));
+    }
+    sleep(2);
+    for(std::vector<std::string>::const_iterator iter = news.begin(); iter != news.end(); ++iter){
+        ASSERT_TRUE(cache.Add(*iter, -1));
+    }
+    ASSERT_EQUALS(static_cast<size_t>(11), cache.Size());
+
+    // the expired key is removed when getting it, and negative expire
+    // means no expiration.
+    ASSERT_TRUE(cache.Get(olds[0], -1));
+    ASSERT_FALSE(cache.Get(olds[0], 1));
+    ASSERT_EQUALS(static_cast<size_t>(10), cache.Size());
+    ASSERT_TRUE(cache.Get(olds[1], -1));
+
+    // the table is shrunk before over 3/4: the expired keys are removed
+    // and the live keys are kept.
+    ASSERT_TRUE(cache.Add(olds[0], -1));
+    ASSERT_TRUE(cache.Add("/trigger", 1));
+    ASSERT_EQUALS(news.size() + 2, cache.Size());
+    for(size_t cnt = 1; cnt < olds.size(); ++cnt){
+        ASSERT_FALSE(cache.Get(olds[cnt], -1));
+    }
+    ASSERT_TRUE(cache.Get(olds[0], -1));
+    for(std::vector<std::string>::const_iterator iter = news.begin(); iter != news.end(); ++iter){
+        ASSERT_TRUE(cache.Get(*iter, 1));
+    }
+    ASSERT_TRUE(cache.Get("/trigger", 1));
+}
+
+void test_memory_size()
+{
+    NoObjectCache cache;
+
+    // too small memory size disables the cache
+    cache.SetMemorySize(16);
+    ASSERT_TRUE(cache.Add("/file", -1));
+    ASSERT_EQUALS(static_cast<size_t>(0), cache.Size());
+    ASSERT_FALSE(cache.Get("/file", -1));
+
+    // changing the memory size clears the table
+    cache.SetMemorySize(TEST_MEMORY_SIZE);
+    ASSERT_TRUE(cache.Add("/file", -1));
+    ASSERT_TRUE(cache.Get("/file", -1));
+    ASSERT_EQUALS(TEST_MEMORY_SIZE, cache.SetMemorySize(NoObjectCache::DEFAULT_MEMORY_SIZE));
+    ASSERT_FALSE(cache.Get("/file", -1));
+}
+
+int main(int argc, char *argv[])
+{
+    S3fsLog singletonLog;
+
+    test_collision();
+    test_erase_in_chain();
+    test_expire_and_shrink();
+    test_memory_size();
+
+    return 0;
+}
+
+/*
+* Local variables:
+* tab-width: 4
+* c-basic-offset: 4
+* End:
+* vim600: expandtab sw=4 ts=4 fdm=marker
+* vim<600: expandtab sw=4 ts=4
+*/
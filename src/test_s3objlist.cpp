@@ -0,0 +1,153 @@
+/*
+ * s3fs - FUSE-based file system backed by Amazon S3
+ *
+ * Copyright(C) 2014 Andrew Gaul <andrew@gaul.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <list>
+
+#include "common.h"
+#include "s3fs.h"
+#include "s3objlist.h"
+#include "test_util.h"
+
+//-------------------------------------------------------------------
+// Global variables for test_s3objlist
+//-------------------------------------------------------------------
+bool foreground                   = false;
+std::string instance_name;
+
+void test_insert_normalize()
+{
+    S3ObjList head;
+
+    ASSERT_TRUE(head.IsEmpty());
+    ASSERT_FALSE(head.insert(""));
+    ASSERT_TRUE(head.insert("file1", "etag1"));
+    ASSERT_TRUE(head.insert("dir1/"));
+    ASSERT_TRUE(head.insert("dir2_$folder$"));
+    ASSERT_TRUE(head.insert("dir3", NULL, true));
+    ASSERT_FALSE(head.IsEmpty());
+
+    ASSERT_FALSE(head.IsDir("file1"));
+    ASSERT_TRUE(head.IsDir("dir1/"));
+    ASSERT_TRUE(head.IsDir("dir2/"));
+    ASSERT_TRUE(head.IsDir("dir3/"));
+
+    ASSERT_EQUALS(std::string("etag1"), head.GetETag("file1"));
+    ASSERT_EQUALS(std::string(""), head.GetETag("dir1/"));
+    ASSERT_EQUALS(std::string("dir2_$folder$"), head.GetOrgName("dir2/"));
+    ASSERT_EQUALS(std::string("dir2/"), head.GetNormalizedName("dir2_$folder$"));
+    ASSERT_EQUALS(std::string("dir3/"), head.GetNormalizedName("dir3"));
+    ASSERT_EQUALS(std::string(""), head.GetNormalizedName("nothing"));
+
+    s3obj_list_t list;
+    head.GetNameList(list);
+    ASSERT_EQUALS(static_cast<size_t>(4), list.size());
+    ASSERT_EQUALS(std::string("dir1"), list.front());
+    ASSERT_EQUALS(std::string("file1"), list.back());
+
+    s3obj_ptrlist_t ptrlist;
+    head.GetNamePtrList(ptrlist);
+    ASSERT_EQUALS(static_cast<size_t>(4), ptrlist.size());
+    ASSERT_EQUALS(std::string("dir1/"), std::string(ptrlist[0]));
+    ASSERT_EQUALS(std::string("dir3/"), std::string(ptrlist[2]));
+}
+
+void test_merge_objects()
+{
+    S3ObjList head;
+
+    // same name object is overwritten, but etag is kept
+    ASSERT_TRUE(head.insert("file1", "etag1"));
+    ASSERT_TRUE(head.insert("file1"));
+    ASSERT_EQUALS(std::string("etag1"), head.GetETag("file1"));
+    ASSERT_TRUE(head.insert("file1", "etag2"));
+    ASSERT_EQUALS(std::string("etag2"), head.GetETag("file1"));
+
+    // "dir" and "dir/" are merged in either order
+    ASSERT_TRUE(head.insert("dir1"));
+    ASSERT_TRUE(head.insert("dir1/"));
+    ASSERT_TRUE(head.insert("dir2/"));
+    ASSERT_TRUE(head.insert("dir2"));
+    ASSERT_TRUE(head.IsDir("dir1/"));
+    ASSERT_TRUE(head.IsDir("dir2/"));
+    ASSERT_EQUALS(std::string("dir1/"), head.GetNormalizedName("dir1"));
+    ASSERT_EQUALS(std::string("dir2/"), head.GetNormalizedName("dir2"));
+
+    s3obj_list_t list;
+    head.GetNameList(list);
+    ASSERT_EQUALS(static_cast<size_t>(3), list.size());
+
+    list.clear();
+    head.GetNameList(list, false, false);
+    ASSERT_EQUALS(static_cast<size_t>(5), list.size());
+}
+
+void test_last_name()
+{
+    S3ObjList head;
+    std::string lastname;
+
+    ASSERT_FALSE(head.GetLastName(lastname));
+    ASSERT_TRUE(head.insert("b_$folder$"));
+    ASSERT_TRUE(head.insert("c"));
+    ASSERT_TRUE(head.insert("a"));
+    ASSERT_TRUE(head.GetLastName(lastname));
+    ASSERT_EQUALS(std::string("c"), lastname);
+
+    // large name which is over arena block size
+    std::string largename(100 * 1024, 'z');
+    ASSERT_TRUE(head.insert(largename.c_str(), "etag"));
+    ASSERT_TRUE(head.GetLastName(lastname));
+    ASSERT_EQUALS(largename, lastname);
+    ASSERT_EQUALS(std::string("etag"), head.GetETag(largename.c_str()));
+}
+
+void test_hierarchized_list()
+{
+    s3obj_list_t list;
+    list.push_back("a/b/c");
+    list.push_back("d");
+
+    ASSERT_TRUE(S3ObjList::MakeHierarchizedList(list, false));
+    ASSERT_EQUALS(static_cast<size_t>(4), list.size());
+}
+
+int main(int argc, char *argv[])
+{
+    S3fsLog singletonLog;
+
+    test_insert_normalize();
+    test_merge_objects();
+    test_last_name();
+    test_hierarchized_list();
+
+    return 0;
+}
+
+/*
+* Local variables:
+* tab-width: 4
+* c-basic-offset: 4
+* End:
+* vim600: expandtab sw=4 ts=4 fdm=marker
+* vim<600: expandtab sw=4 ts=4
+*/
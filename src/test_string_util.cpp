@@ -138,6 +138,13 @@ void test_wtf8_encoding()
     ASSERT_EQUALS(s3fs_wtf8_decode(s3fs_wtf8_encode(mixed)), mixed);
 }
 
+void test_xml_encode()
+{
+    ASSERT_EQUALS(std::string("dir/file.txt"), xmlEncode("dir/file.txt"));
+    ASSERT_EQUALS(std::string("a&amp;b&lt;c&gt;d&quot;e&apos;f"), xmlEncode("a&b<c>d\"e'f"));
+    ASSERT_EQUALS(std::string(""), xmlEncode(""));
+}
+
 int main(int argc, char *argv[])
 {
     S3fsLog singletonLog;
@@ -146,6 +153,7 @@ int main(int argc, char *argv[])
     test_base64();
     test_strtoofft();
     test_wtf8_encoding();
+    test_xml_encode();
 
     return 0;
 }
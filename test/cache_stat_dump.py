@@ -0,0 +1,116 @@
+#!/usr/bin/env python3
+#
+# s3fs - FUSE-based file system backed by Amazon S3
+#
+# Copyright 2007-2008 Randy Rizun <rrizun@gmail.com>
+#
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2
+# of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+#
+
+#
+# Dump the cache stat file in the text format:
+#   <inode>:<size>
+#   <offset>:<bytes>:<loaded>:<modified>
+#   ...
+# The binary format(see src/fdcache_page.cpp) is converted by applying
+# its base records and delta records, and the text format is printed as is.
+#
+
+import struct
+import sys
+
+CACHE_STAT_MAGIC = b'S3CS'
+CACHE_STAT_HEADER = struct.Struct('=4sIQqII64s')
+CACHE_STAT_RECORD = struct.Struct('=qqII')
+
+CACHE_STAT_RECORD_PAGE = 0
+CACHE_STAT_RECORD_RESIZE = 1
+CACHE_STAT_RECORD_BLOCK = 2
+
+CACHE_STAT_FLAG_LOADED = 0x1
+CACHE_STAT_FLAG_MODIFIED = 0x2
+
+def set_status(pages, offset, size, loaded, modified):
+    result = []
+    for (poffset, pbytes, ploaded, pmodified) in pages:
+        pend = poffset + pbytes
+        if pend <= offset or offset + size <= poffset:
+            result.append((poffset, pbytes, ploaded, pmodified))
+            continue
+        if poffset < offset:
+            result.append((poffset, offset - poffset, ploaded, pmodified))
+        if offset + size < pend:
+            result.append((offset + size, pend - offset - size, ploaded, pmodified))
+    result.append((offset, size, loaded, modified))
+    return sorted(result)
+
+def resize(pages, size):
+    total = pages[-1][0] + pages[-1][1] if pages else 0
+    if total < size:
+        return pages + [(total, size - total, False, False)]
+    result = []
+    for (poffset, pbytes, ploaded, pmodified) in pages:
+        if size <= poffset:
+            break
+        result.append((poffset, min(pbytes, size - poffset), ploaded, pmodified))
+    return result
+
+def compress(pages):
+    result = []
+    for page in pages:
+        if 0 == page[1]:
+            continue
+        if result and result[-1][2:] == page[2:]:
+            result[-1] = (result[-1][0], result[-1][1] + page[1], page[2], page[3])
+        else:
+            result.append(page)
+    return result
+
+def main():
+    if len(sys.argv) != 2:
+        sys.exit("Usage: %s CACHE_STAT_FILE" % sys.argv[0])
+
+    with open(sys.argv[1], 'rb') as f:
+        data = f.read()
+
+    if not data.startswith(CACHE_STAT_MAGIC):
+        sys.stdout.write(data.decode())
+        return
+
+    (_, _, inode, size, _, _, _) = CACHE_STAT_HEADER.unpack_from(data, 0)
+    pages = []
+    for pos in range(CACHE_STAT_HEADER.size, len(data), CACHE_STAT_RECORD.size):
+        (offset, nbytes, rtype, flags) = CACHE_STAT_RECORD.unpack_from(data, pos)
+        if CACHE_STAT_RECORD_PAGE == rtype:
+            pages = set_status(pages, offset, nbytes, 0 != (flags & CACHE_STAT_FLAG_LOADED), 0 != (flags & CACHE_STAT_FLAG_MODIFIED))
+        elif CACHE_STAT_RECORD_RESIZE == rtype:
+            size = nbytes
+            pages = resize(pages, size)
+
+    print("%d:%d" % (inode, size))
+    for (offset, nbytes, loaded, modified) in compress(pages):
+        print("%d:%d:%d:%d" % (offset, nbytes, 1 if loaded else 0, 1 if modified else 0))
+
+if __name__ == '__main__':
+    main()
+
+#
+# Local variables:
+# tab-width: 4
+# c-basic-offset: 4
+# End:
+# vim600: expandtab sw=4 ts=4 fdm=marker
+# vim<600: expandtab sw=4 ts=4
+#
@@ -152,6 +152,37 @@ function test_mv_to_exist_file {
     rm_test_file "${BIG_FILE}-mv"
 }
 
+function test_mv_opened_file {
+    describe "Testing mv opened and modified file function ..."
+
+    # the old object exists on the server
+    echo "${TEST_TEXT}" > ${TEST_TEXT_FILE}
+
+    # modify the opened file and rename it
+    exec 3<> ${TEST_TEXT_FILE}
+    echo "${TEST_TEXT}" >&3
+    mv ${TEST_TEXT_FILE} ${ALT_TEST_TEXT_FILE}
+
+    # the old path must not be seen even before closing
+    if [ -e ${TEST_TEXT_FILE} ] || ls | grep -q "^${TEST_TEXT_FILE}\$"; then
+       echo "Old file ${TEST_TEXT_FILE} is still seen after renaming"
+       exec 3>&-
+       return 1
+    fi
+    OBJECT_NAME="$(basename $PWD)/${TEST_TEXT_FILE}"
+    if aws_cli s3api head-object --bucket "${TEST_BUCKET_1}" --key "${OBJECT_NAME}" > /dev/null 2>&1; then
+       echo "Old object ${OBJECT_NAME} is not removed after renaming"
+       exec 3>&-
+       return 1
+    fi
+    exec 3>&-
+
+    cmp ${ALT_TEST_TEXT_FILE} <(echo "${TEST_TEXT}")
+
+    # clean up
+    rm_test_file $ALT_TEST_TEXT_FILE
+}
+
 function test_mv_empty_directory {
     describe "Testing mv directory function ..."
     if [ -e $TEST_DIR ]; then
@@ -1059,6 +1090,50 @@ function test_rm_rf_dir {
    fi
 }
 
+function test_rmtree_xattr {
+   describe "Test that setting rmtree xattr will remove directory tree ..."
+   # Create a nested tree, and an object which is made without directory objects
+   mkdir -p dir_rmtree/dir1/dir2
+   touch dir_rmtree/file1
+   touch dir_rmtree/dir1/file2
+   echo "${TEST_TEXT}" > dir_rmtree/dir1/dir2/file3
+   OBJECT_NAME="$(basename $PWD)/dir_rmtree/dir3/file4"
+   echo "${TEST_TEXT}" | aws_cli s3 cp - "s3://${TEST_BUCKET_1}/${OBJECT_NAME}"
+
+   # Remove the tree by the special xattr
+   set_xattr user.s3fs.rmtree 1 dir_rmtree
+
+   if [ -e dir_rmtree ]; then
+       echo "setting rmtree xattr did not remove $PWD/dir_rmtree"
+       return 1
+   fi
+   if aws_cli s3 ls "s3://${TEST_BUCKET_1}/$(basename $PWD)/dir_rmtree" | grep -q .; then
+       echo "setting rmtree xattr left objects under $PWD/dir_rmtree"
+       return 1
+   fi
+}
+
+function test_copy_xattr {
+   describe "Test that setting copyfrom xattr will copy file on the server ..."
+   dd if=/dev/urandom of=/tmp/simple_file bs=1024 count=1
+   cp /tmp/simple_file copy_xattr_src
+   touch copy_xattr_dst
+   chmod 600 copy_xattr_dst
+
+   set_xattr user.s3fs.copyfrom "/$(basename $PWD)/copy_xattr_src" copy_xattr_dst
+
+   cmp copy_xattr_src copy_xattr_dst
+   # the destination keeps its own mode
+   if ! get_permissions copy_xattr_dst | grep -q 600$; then
+       echo "copyfrom xattr changed the mode of copy_xattr_dst"
+       return 1
+   fi
+
+   rm -f /tmp/simple_file
+   rm_test_file copy_xattr_src
+   rm_test_file copy_xattr_dst
+}
+
 function test_copy_file {
    describe "Test simple copy ..."
 
@@ -1246,10 +1321,11 @@ function test_cache_file_stat() {
     fi
 
     #
-    # get lines from cache stat file
+    # get lines from cache stat file(binary format is dumped in text format)
     #
-    CACHE_FILE_STAT_LINE_1=$(${SED_BIN} -n 1p ${CACHE_DIR}/.${TEST_BUCKET_1}.stat/${CACHE_TESTRUN_DIR}/${BIG_FILE})
-    CACHE_FILE_STAT_LINE_2=$(${SED_BIN} -n 2p ${CACHE_DIR}/.${TEST_BUCKET_1}.stat/${CACHE_TESTRUN_DIR}/${BIG_FILE})
+    CACHE_FILE_STAT_DUMP=$(../../cache_stat_dump.py ${CACHE_DIR}/.${TEST_BUCKET_1}.stat/${CACHE_TESTRUN_DIR}/${BIG_FILE})
+    CACHE_FILE_STAT_LINE_1=$(echo "${CACHE_FILE_STAT_DUMP}" | ${SED_BIN} -n 1p)
+    CACHE_FILE_STAT_LINE_2=$(echo "${CACHE_FILE_STAT_DUMP}" | ${SED_BIN} -n 2p)
     if [ -z ${CACHE_FILE_STAT_LINE_1} ] || [ -z ${CACHE_FILE_STAT_LINE_2} ]; then
         echo "could not get first or second line from cache file stat: ${CACHE_DIR}/.${TEST_BUCKET_1}.stat/${CACHE_TESTRUN_DIR}/${BIG_FILE}"
         return 1;
@@ -1289,10 +1365,11 @@ function test_cache_file_stat() {
     fi
 
     #
-    # get lines from cache stat file
+    # get lines from cache stat file(binary format is dumped in text format)
     #
-    CACHE_FILE_STAT_LINE_1=$(${SED_BIN} -n 1p ${CACHE_DIR}/.${TEST_BUCKET_1}.stat/${CACHE_TESTRUN_DIR}/${BIG_FILE})
-    CACHE_FILE_STAT_LINE_E=$(tail -1 ${CACHE_DIR}/.${TEST_BUCKET_1}.stat/${CACHE_TESTRUN_DIR}/${BIG_FILE} 2>/dev/null)
+    CACHE_FILE_STAT_DUMP=$(../../cache_stat_dump.py ${CACHE_DIR}/.${TEST_BUCKET_1}.stat/${CACHE_TESTRUN_DIR}/${BIG_FILE} 2>/dev/null)
+    CACHE_FILE_STAT_LINE_1=$(echo "${CACHE_FILE_STAT_DUMP}" | ${SED_BIN} -n 1p)
+    CACHE_FILE_STAT_LINE_E=$(echo "${CACHE_FILE_STAT_DUMP}" | tail -1)
     if [ -z ${CACHE_FILE_STAT_LINE_1} ] || [ -z ${CACHE_FILE_STAT_LINE_E} ]; then
         echo "could not get first or end line from cache file stat: ${CACHE_DIR}/.${TEST_BUCKET_1}.stat/${CACHE_TESTRUN_DIR}/${BIG_FILE}"
         return 1;
@@ -1473,6 +1550,7 @@ function add_all_tests {
     add_tests test_truncate_empty_file
     add_tests test_mv_file
     add_tests test_mv_to_exist_file
+    add_tests test_mv_opened_file
     add_tests test_mv_empty_directory
     add_tests test_mv_nonempty_directory
     add_tests test_redirects
@@ -1502,6 +1580,12 @@ function add_all_tests {
     add_tests test_update_time
     add_tests test_update_directory_time
     add_tests test_rm_rf_dir
+    if ps u $S3FS_PID | grep -q enable_rmtree_xattr; then
+        add_tests test_rmtree_xattr
+    fi
+    if ps u $S3FS_PID | grep -q enable_copy_xattr; then
+        add_tests test_copy_xattr
+    fi
     add_tests test_copy_file
     add_tests test_write_after_seek_ahead
     add_tests test_overwrite_existing_file_range
@@ -59,6 +59,7 @@ if [ -n "${ALL_TESTS}" ]; then
         "use_cache=${CACHE_DIR} -o ensure_diskfree=${ENSURE_DISKFREE_SIZE}"
         enable_content_md5
         enable_noobj_cache
+        "enable_rmtree_xattr -o enable_copy_xattr"
         max_stat_cache_size=100
         nocopyapi
         nomultipart